@@ -151,6 +151,8 @@ Texture2D tex             : register(t20);
 Texture2D tex2            : register(t21);
 Texture2D tex_font_atlas  : register(t22);
 Texture2DArray tex_sss    : register(t23);
+// terrain
+Texture2D tex_terrain_height : register(t27);
 
 // bindless arrays
 Texture2D material_textures[]                            : register(t24, space1);
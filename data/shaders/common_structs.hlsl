@@ -69,6 +69,7 @@ struct Surface
     bool vertex_animate_wind()    { return flags & uint(1U << 9); }
     bool vertex_animate_water()   { return flags & uint(1U << 10); }
     bool is_tessellated()         { return flags & uint(1U << 11); }
+    bool is_terrain()             { return flags & uint(1U << 12); }
     bool is_water()               { return ior == 1.33f; }
     bool is_glass()               { return ior == 1.52f; }
     bool is_sky()                 { return alpha == 0.0f; }
@@ -212,6 +212,61 @@ struct vertex_processing
         }
     };
 
+    struct terrain
+    {
+        static float load_height(float2 texel, float2 size)
+        {
+            texel     = clamp(texel, 0.0f, size - 1.0f);
+            int2 p0   = int2(floor(texel));
+            int2 p1   = min(p0 + 1, int2(size) - 1);
+            float2 f  = texel - float2(p0);
+
+            float h00 = tex_terrain_height.Load(int3(p0.x, p0.y, 0)).r;
+            float h10 = tex_terrain_height.Load(int3(p1.x, p0.y, 0)).r;
+            float h01 = tex_terrain_height.Load(int3(p0.x, p1.y, 0)).r;
+            float h11 = tex_terrain_height.Load(int3(p1.x, p1.y, 0)).r;
+
+            return lerp(lerp(h00, h10, f.x), lerp(h01, h11, f.x), f.y);
+        }
+
+        // the patch is a flat grid, every instance is a quadtree node which carries its origin and cell size
+        static void displace(inout Vertex_PosUvNorTan input, matrix transform)
+        {
+            static const float patch_quads = 32.0f; // must match patch_quads in Terrain.cpp
+            static const float lod_range   = 5.0f;  // must match lod_range in Terrain.cpp
+
+            uint width, height;
+            tex_terrain_height.GetDimensions(width, height);
+            float2 size      = float2(width, height);
+            float2 half_size = size * 0.5f;
+
+            float cell    = input.instance_transform._m00;
+            float2 origin = float2(input.instance_transform._m30, input.instance_transform._m32);
+            float2 grid   = input.position.xz;
+
+            // morph odd vertices onto their even neighbours as the node approaches the end of its range,
+            // so that they match the parent level's grid by the time the parent takes over
+            float2 position_local = origin + grid * cell;
+            float3 position_world = mul(float4(position_local.x, load_height(position_local + half_size, size), position_local.y, 1.0f), transform).xyz;
+            float range           = lod_range * patch_quads * cell;
+            float morph           = saturate((length(position_world - buffer_frame.camera_position) - 0.85f * range) / (0.15f * range));
+            grid                 -= frac(grid * 0.5f) * 2.0f * morph;
+
+            // displace
+            position_local = origin + grid * cell;
+            float2 texel   = clamp(position_local + half_size, 0.0f, size - 1.0f);
+            position_local = texel - half_size;
+            input.position = float4(position_local.x, load_height(texel, size), position_local.y, 1.0f);
+
+            // normal and tangent from central differences, the same way the cpu computes them
+            float slope_x = (load_height(texel + float2(1.0f, 0.0f), size) - load_height(texel - float2(1.0f, 0.0f), size)) * 0.5f;
+            float slope_z = (load_height(texel + float2(0.0f, 1.0f), size) - load_height(texel - float2(0.0f, 1.0f), size)) * 0.5f;
+            input.normal  = normalize(float3(-slope_x, 1.0f, -slope_z));
+            input.tangent = normalize(float3(1.0f, slope_x, 0.0f));
+            input.uv      = texel / (size - 1.0f);
+        }
+    };
+
     static float3 ambient_animation(Surface surface, float3 position, float3 animation_pivot, uint instance_id, float3 wind, float time)
     {
         if (surface.vertex_animate_wind())
@@ -234,12 +289,20 @@ gbuffer_vertex transform_to_world_space(Vertex_PosUvNorTan input, uint instance_
 {
     gbuffer_vertex vertex;
 
+    // terrain patches are displaced in the terrain's space, their instance transform is consumed by the displacement
+    Surface surface_terrain; surface_terrain.flags = GetMaterial().flags;
+    bool is_terrain = surface_terrain.is_terrain();
+    if (is_terrain)
+    {
+        vertex_processing::terrain::displace(input, transform);
+    }
+
     // compute uv
     MaterialParameters material = GetMaterial();
     vertex.uv                   = float2(input.uv.x * material.tiling.x + material.offset.x, input.uv.y * material.tiling.y + material.offset.y);
 
     // compute the final world transform
-    bool is_instanced         = instance_id != 0; // not ideal as you can have instancing with instance_id = 0, however it's very performant branching due to predictability
+    bool is_instanced         = instance_id != 0 && !is_terrain; // not ideal as you can have instancing with instance_id = 0, however it's very performant branching due to predictability
     matrix transform_instance = is_instanced ? input.instance_transform : matrix_identity;
     transform                 = mul(transform, transform_instance);
     // clip the last row as it has encoded data in the first two elements
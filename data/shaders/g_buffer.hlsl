@@ -98,10 +98,11 @@ gbuffer main_ps(gbuffer_vertex vertex)
     {
         // get tangent space normal and apply the user defined intensity, then transform it to world space
         float3 normal_sample  = sampling::smart(vertex.position, vertex.normal, vertex.uv, material_texture_index_normal, surface.is_water(), surface.texture_slope_based(), surface.vertex_animate_wind()).xyz;
-        float3 tangent_normal = normalize(unpack(normal_sample));
+        float3 tangent_normal = 0.0f;
     
-        // reconstruct z-component as this can be a BC5 two channel normal map
-        tangent_normal.z = fast_sqrt(max(0.0, 1.0 - tangent_normal.x * tangent_normal.x - tangent_normal.y * tangent_normal.y));
+        // reconstruct z-component from the unnormalized xy, as this can be a BC5 two channel normal map (blue reads as zero)
+        tangent_normal.xy = unpack(normal_sample.xy);
+        tangent_normal.z  = fast_sqrt(max(0.0, 1.0 - tangent_normal.x * tangent_normal.x - tangent_normal.y * tangent_normal.y));
     
         float normal_intensity     = max(0.012f, GetMaterial().normal);
         tangent_normal.xy         *= saturate(normal_intensity);
@@ -183,7 +183,10 @@ void ShaderEditor::ShowControls()
 
             // compile synchronously to make the new frame obvious
             bool async = false;
-            m_shader->Compile(m_shader->GetShaderStage(), m_shader->GetFilePath(), async);
+            m_shader->Compile(m_shader->GetShaderStage(), m_shader->GetFilePath(), async, m_shader->GetVertexType());
+
+            // the edit might have been in a shared include, recompile any other shader that depends on it
+            Renderer::ReloadShaders();
         }
     }
 
@@ -32,6 +32,7 @@ namespace spartan
         static bool IsGpuTimingEnabled()             { return m_gpu_timing_enabled; }
         static bool IsRenderdocEnabled()             { return m_renderdoc_enabled; }
         static bool IsShaderOptimizationEnabled()    { return m_shader_optimization_enabled; }
+        static bool IsShaderCacheEnabled()           { return m_shader_cache_enabled; }
         static bool IsLoggingToFileEnabled()         { return m_logging_to_file_enabled; }
         static bool IsBreadcrumbsEnabled()           { return m_breadcrumbs_enabled; }
 
@@ -44,5 +45,6 @@ namespace spartan
         inline static bool m_gpu_marking_enabled             = true;  // enables GPU resource marking with negligible performance cost
         inline static bool m_gpu_timing_enabled              = true;  // enables GPU performance timing with negligible performance cost
         inline static bool m_shader_optimization_enabled     = true;  // controls shader optimization, disabling has significant performance impact
+        inline static bool m_shader_cache_enabled            = true;  // reuses compiled shaders from disk across runs, disable when working on the shader compiler itself
     };
 }
@@ -120,11 +120,13 @@ namespace spartan
         Window::Tick();
         Input::Tick();
         Audio::Tick();
-        Physics::Tick();
         World::Tick();
+        Physics::Tick();
+        ResourceCache::Tick();
         Renderer::Tick();
 
         // post-tick
+        Physics::PostTick();
         Timer::PostTick();
         Profiler::PostTick();
     }
@@ -681,4 +681,22 @@ namespace spartan
             return true;
         }
     }
+
+    bool FileSystem::MoveFileFromTo(const string& source, const string& destination)
+    {
+        if (source == destination)
+            return true;
+
+        // a rename within the same volume is atomic, readers either see the old file or the new one
+        try
+        {
+            filesystem::rename(source, destination);
+            return true;
+        }
+        catch (filesystem::filesystem_error& e)
+        {
+            SP_LOG_ERROR("%s", e.what());
+            return false;
+        }
+    }
 }
@@ -90,6 +90,7 @@ namespace spartan
         static bool Delete(const std::string& path);
         static bool CreateDirectory(const std::string& path);
         static bool CopyFileFromTo(const std::string& source, const std::string& destination);
+        static bool MoveFileFromTo(const std::string& source, const std::string& destination);
     };
 
     static const char* EXTENSION_WORLD    = ".world";
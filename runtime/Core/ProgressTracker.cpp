@@ -107,6 +107,14 @@ namespace spartan
 
     void ProgressTracker::SetGlobalLoadingState(const bool is_loading)
     {
-        anonymous_jobs = is_loading ? (anonymous_jobs + 1) : (anonymous_jobs - 1);
+        // textures and models load on several threads at once, so this has to be a single atomic operation
+        if (is_loading)
+        {
+            anonymous_jobs++;
+        }
+        else
+        {
+            anonymous_jobs--;
+        }
     }
 }
@@ -43,8 +43,13 @@ namespace spartan
         // Threads
         static vector<thread> threads;
 
-        // Tasks
-        static deque<Task> tasks;
+        // Tasks, the ones spawned by a parallel loop are tagged with it, so that the thread waiting on the loop can run them
+        struct QueuedTask
+        {
+            Task task;
+            const void* group = nullptr;
+        };
+        static deque<QueuedTask> tasks;
 
         // Misc
         static bool is_stopping;
@@ -65,7 +70,7 @@ namespace spartan
                 return;
 
             // Get next task in the queue.
-            Task task = tasks.front();
+            Task task = move(tasks.front().task);
 
             // Remove it from the queue.
             tasks.pop_front();
@@ -120,6 +125,35 @@ namespace spartan
         threads.clear();
     }
 
+    static void add_task(Task&& task, const void* group)
+    {
+        unique_lock<mutex> lock(mutex_tasks);
+        tasks.push_back({ move(task), group });
+        lock.unlock();
+
+        condition_var.notify_one();
+    }
+
+    // runs the queued tasks of a group on the calling thread, returns once none are left in the queue
+    static void run_queued_tasks(const void* group)
+    {
+        while (true)
+        {
+            Task task;
+            {
+                lock_guard<mutex> lock(mutex_tasks);
+                auto it = find_if(tasks.begin(), tasks.end(), [group](const QueuedTask& queued) { return queued.group == group; });
+                if (it == tasks.end())
+                    return;
+
+                task = move(it->task);
+                tasks.erase(it);
+            }
+
+            task();
+        }
+    }
+
     future<void> ThreadPool::AddTask(Task&& task)
     {
         // create a packaged task that will give us a future
@@ -128,20 +162,11 @@ namespace spartan
         // get the future before we move the packaged_task into the lambda
         future<void> future = packaged_task->get_future();
         
-        // lock tasks mutex
-        unique_lock<mutex> lock(mutex_tasks);
-        
         // save the task - wrap the packaged_task in a lambda that will execute it
-        tasks.emplace_back([packaged_task]()
+        add_task([packaged_task]()
         {
             (*packaged_task)();
-        });
-        
-        // unlock the mutex
-        lock.unlock();
-        
-        // wake up a thread
-        condition_var.notify_one();
+        }, nullptr);
         
         // return the future that can be used to wait for task completion
         return future;
@@ -151,7 +176,14 @@ namespace spartan
     {
         SP_ASSERT_MSG(work_total > 1, "A parallel loop can't have a range of 1 or smaller");
 
-        uint32_t available_threads = GetIdleThreadCount();
+        // no idle threads (e.g. called from a busy worker), do the work here instead of dividing by zero
+        uint32_t available_threads = min(GetIdleThreadCount(), work_total);
+        if (available_threads == 0)
+        {
+            function(0, work_total);
+            return;
+        }
+
         uint32_t work_per_thread   = work_total / available_threads;
         uint32_t work_remainder    = work_total % available_threads;
         uint32_t work_index        = 0;
@@ -164,29 +196,58 @@ namespace spartan
         {
             uint32_t work_to_do = work_per_thread;
 
-            // if the work doesn't divide evenly across threads, add the remainder work to the first thread.
+            // if the work doesn't divide evenly across threads, spread the remainder, one unit per task
             if (work_remainder != 0)
             {
-                work_to_do     += work_remainder;
-                work_remainder = 0;
+                work_to_do++;
+                work_remainder--;
             }
 
-            AddTask([&function, &work_done, &cv, work_index, work_to_do]()
+            add_task([&function, &work_done, &cv, &cv_m, work_index, work_to_do]()
             {
                 function(work_index, work_index + work_to_do);
-                work_done += work_to_do;
 
-                cv.notify_one(); // notify that a thread has finished its work
-            });
+                // notify under the lock so that the waiting thread can't miss it (and destroy cv) in between
+                lock_guard<mutex> lock(cv_m);
+                work_done += work_to_do;
+                cv.notify_one();
+            }, &work_done);
 
             work_index += work_to_do;
         }
 
+        // the idle count above ignores queued tasks, so in a nested loop every worker can end up waiting on tasks
+        // that no thread is free to pick up, the waiting thread avoids that by running what's left of its own tasks
+        run_queued_tasks(&work_done);
+
         // wait for threads to finish work
         unique_lock<mutex> lk(cv_m);
         cv.wait(lk, [&]() { return work_done == work_total; });
     }
 
+    void ThreadPool::ParallelForEach(const function<void(uint32_t work_index)>& function, const uint32_t work_total)
+    {
+        if (work_total <= 1)
+        {
+            if (work_total == 1)
+            {
+                function(0);
+            }
+
+            return;
+        }
+
+        // each task keeps taking the next item until there are none left, so a few large items don't leave threads idle
+        atomic<uint32_t> work_index_next = 0;
+        ParallelLoop([&function, &work_index_next, work_total](uint32_t, uint32_t)
+        {
+            for (uint32_t work_index = work_index_next++; work_index < work_total; work_index = work_index_next++)
+            {
+                function(work_index);
+            }
+        }, work_total);
+    }
+
     void ThreadPool::Flush(bool remove_queued /*= false*/)
     {
         // Clear any queued tasks
@@ -42,6 +42,9 @@ namespace spartan
         // spread execution of a given function across all available threads
         static void ParallelLoop(std::function<void(uint32_t work_index_start, uint32_t work_index_end)>&& function, const uint32_t work_total);
 
+        // like ParallelLoop() but threads take one item at a time, for items whose cost varies a lot (e.g. the meshes of a model)
+        static void ParallelForEach(const std::function<void(uint32_t work_index)>& function, const uint32_t work_total);
+
         // wait for all threads to finish work
         static void Flush(bool remove_queued = false);
 
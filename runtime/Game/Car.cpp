@@ -533,6 +533,69 @@ namespace spartan
         }
     }
 
+    namespace wheel_rays
+    {
+        // description:
+        // bullet's vehicle asks for the wheel rays one at a time, in wheel order, once every wheel's transform is up to date
+        // so the first request of a step casts all of them in one batch, and the rest are answered from it
+        class Raycaster : public btVehicleRaycaster
+        {
+        public:
+            Raycaster(const btRigidBody* chassis) : m_chassis(chassis) { }
+
+            void* castRay(const btVector3& from, const btVector3& to, btVehicleRaycasterResult& result) override
+            {
+                const uint32_t wheel_count = min(static_cast<uint32_t>(vehicle->getNumWheels()), static_cast<uint32_t>(m_queries.size()));
+                if (m_wheel_next == 0)
+                {
+                    for (uint32_t i = 0; i < wheel_count; i++)
+                    {
+                        const btWheelInfo& wheel = vehicle->getWheelInfo(i);
+                        const btVector3 ray      = wheel.m_raycastInfo.m_wheelDirectionWS * (wheel.getSuspensionRestLength() + wheel.m_wheelsRadius);
+
+                        m_queries[i].start  = bt_to_vector(wheel.m_raycastInfo.m_hardPointWS);
+                        m_queries[i].end    = bt_to_vector(wheel.m_raycastInfo.m_hardPointWS + ray);
+                        m_queries[i].ignore = m_chassis;
+                    }
+
+                    Physics::Query(m_queries.data(), m_hits.data(), wheel_count);
+                }
+
+                // a ray that isn't the expected wheel's (a different wheel count, a different caller) is cast on its own
+                PhysicsHit* hit = &m_hits[m_wheel_next];
+                PhysicsHit hit_single;
+                if (m_queries[m_wheel_next].start != bt_to_vector(from) || m_queries[m_wheel_next].end != bt_to_vector(to))
+                {
+                    PhysicsQuery query;
+                    query.start  = bt_to_vector(from);
+                    query.end    = bt_to_vector(to);
+                    query.ignore = m_chassis;
+
+                    Physics::Query(&query, &hit_single, 1);
+                    hit = &hit_single;
+                }
+                m_wheel_next = (m_wheel_next + 1) % max(wheel_count, 1u);
+
+                if (!hit->body || !hit->body->hasContactResponse())
+                    return nullptr;
+
+                result.m_hitPointInWorld  = vector_to_bt(hit->position);
+                result.m_hitNormalInWorld = vector_to_bt(hit->normal).normalized();
+                result.m_distFraction     = hit->fraction;
+
+                return hit->body;
+            }
+
+            btRaycastVehicle* vehicle = nullptr; // set once the vehicle exists, it needs the raycaster to be created
+
+        private:
+            const btRigidBody* m_chassis = nullptr;
+            uint32_t m_wheel_next        = 0;
+            array<PhysicsQuery, 4> m_queries;
+            array<PhysicsHit, 4> m_hits;
+        };
+    }
+
     void Car::Create(btRigidBody* chassis, Entity* entity)
     {
         m_parameters.body = chassis;
@@ -554,8 +617,9 @@ namespace spartan
             vehicle_tuning.m_maxSuspensionTravelCm = tuning::suspension_travel_max * 1000.0f;
             vehicle_tuning.m_frictionSlip          = tuning::tire_friction;
 
-            btVehicleRaycaster* vehicle_ray_caster = new btDefaultVehicleRaycaster(static_cast<btDynamicsWorld*>(Physics::GetWorld()));
+            wheel_rays::Raycaster* vehicle_ray_caster = new wheel_rays::Raycaster(m_parameters.body);
             m_parameters.vehicle = new btRaycastVehicle(vehicle_tuning, m_parameters.body, vehicle_ray_caster);
+            vehicle_ray_caster->vehicle = m_parameters.vehicle;
 
             // this is crucial to get right
             m_parameters.vehicle->setCoordinateSystem(0, 1, 2); // X is right, Y is up, Z is forward
@@ -0,0 +1,180 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//= INCLUDES ========
+#include "pch.h"
+#include "DiskCache.h"
+//===================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    DiskCache::DiskCache(const char* extension, const uint64_t budget_mb)
+    {
+        m_extension    = extension;
+        m_budget_bytes = budget_mb * 1024 * 1024;
+    }
+
+    void DiskCache::Initialize(const string& directory)
+    {
+        m_directory = directory + "\\";
+        if (!FileSystem::Exists(m_directory))
+        {
+            FileSystem::CreateDirectory(m_directory);
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        Evict(m_budget_bytes, true);
+    }
+
+    string DiskCache::GetFilePath(const uint64_t key) const
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        return m_directory + name + m_extension;
+    }
+
+    bool DiskCache::Exists(const uint64_t key)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        return FileSystem::IsFile(GetFilePath(key));
+    }
+
+    string DiskCache::GetFilePathTemp(const uint64_t key)
+    {
+        return GetFilePath(key) + ".tmp" + to_string(m_temp_id++);
+    }
+
+    bool DiskCache::Commit(const uint64_t key, const string& file_path_temp)
+    {
+        const string file_path = GetFilePath(key);
+
+        lock_guard<mutex> lock(m_mutex);
+
+        if (!FileSystem::MoveFileFromTo(file_path_temp, file_path))
+        {
+            FileSystem::Delete(file_path_temp);
+            return false;
+        }
+
+        error_code error;
+        uint64_t file_size = filesystem::file_size(file_path, error);
+        m_size_bytes      += error ? 0 : file_size;
+        if (m_size_bytes > m_budget_bytes)
+        {
+            // trim to 75% so that eviction doesn't run on every commit once the budget is reached
+            Evict(m_budget_bytes * 3 / 4, false);
+        }
+
+        return true;
+    }
+
+    void DiskCache::Touch(const uint64_t key)
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        error_code error;
+        filesystem::last_write_time(GetFilePath(key), filesystem::file_time_type::clock::now(), error);
+    }
+
+    void DiskCache::Remove(const uint64_t key)
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        const string file_path = GetFilePath(key);
+        error_code error;
+        uint64_t file_size = filesystem::file_size(file_path, error);
+        if (!error && filesystem::remove(file_path, error))
+        {
+            m_size_bytes -= min<uint64_t>(m_size_bytes, file_size);
+        }
+    }
+
+    void DiskCache::SetBudgetMb(const uint64_t budget_mb)
+    {
+        m_budget_bytes = budget_mb * 1024 * 1024;
+
+        lock_guard<mutex> lock(m_mutex);
+        if (m_size_bytes > m_budget_bytes)
+        {
+            Evict(m_budget_bytes, false);
+        }
+    }
+
+    void DiskCache::Evict(const uint64_t bytes_to_keep, const bool remove_leftovers)
+    {
+        // gather entries, oldest (least recently used) first
+        // all calls take an error_code, a file which can't be inspected or removed (e.g. it's open elsewhere) is
+        // skipped and simply stays counted, so the size never drifts from what is actually on disk
+        vector<tuple<filesystem::file_time_type, uint64_t, filesystem::path>> entries;
+        uint64_t total = 0;
+        error_code error;
+        for (filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error))
+        {
+            error_code entry_error;
+            if (!it->is_regular_file(entry_error))
+                continue;
+
+            // temporary files are either being written right now or are leftovers from a crash in the middle of a write
+            if (it->path().extension() != m_extension)
+            {
+                if (remove_leftovers)
+                {
+                    filesystem::remove(it->path(), entry_error);
+                }
+
+                continue;
+            }
+
+            uint64_t file_size              = it->file_size(entry_error);
+            filesystem::file_time_type time = it->last_write_time(entry_error);
+            if (entry_error)
+                continue;
+
+            total += file_size;
+            entries.emplace_back(time, file_size, it->path());
+        }
+
+        if (error)
+        {
+            SP_LOG_WARNING("Failed to enumerate %s: %s", m_directory.c_str(), error.message().c_str());
+        }
+
+        sort(entries.begin(), entries.end());
+
+        for (const auto& [time, file_size, path] : entries)
+        {
+            if (total <= bytes_to_keep)
+                break;
+
+            error_code remove_error;
+            if (filesystem::remove(path, remove_error))
+            {
+                total -= file_size;
+            }
+        }
+
+        m_size_bytes = total;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+//= INCLUDES =====
+#include <string>
+#include <atomic>
+#include <mutex>
+//================
+
+namespace spartan
+{
+    // a directory of files keyed by a 64-bit hash, entries are written to a temporary file and renamed into place,
+    // the least recently used entries are evicted when the size exceeds the budget (shared by the shader and derived data caches)
+    class DiskCache
+    {
+    public:
+        DiskCache(const char* extension, const uint64_t budget_mb);
+
+        // creates the directory and removes leftovers from writes that never committed
+        void Initialize(const std::string& directory);
+        bool IsInitialized() const { return !m_directory.empty(); }
+
+        // the path of an entry, it exists only if the entry has been committed
+        std::string GetFilePath(const uint64_t key) const;
+        bool Exists(const uint64_t key);
+
+        // every call returns a unique path, so concurrent writers of the same entry never share a file
+        std::string GetFilePathTemp(const uint64_t key);
+        bool Commit(const uint64_t key, const std::string& file_path_temp);
+
+        // marks an entry as recently used, eviction goes by the write time
+        void Touch(const uint64_t key);
+        void Remove(const uint64_t key);
+
+        // budget
+        void SetBudgetMb(const uint64_t budget_mb);
+        uint64_t GetBudgetMb() const { return m_budget_bytes / (1024 * 1024); }
+        uint64_t GetSizeMb() const   { return m_size_bytes / (1024 * 1024); }
+
+    private:
+        void Evict(const uint64_t bytes_to_keep, const bool remove_leftovers);
+
+        std::string m_directory;
+        std::string m_extension;
+        std::atomic<uint64_t> m_budget_bytes = 0;
+        std::atomic<uint64_t> m_size_bytes   = 0;
+        std::atomic<uint64_t> m_temp_id      = 0;
+        std::mutex m_mutex;
+    };
+}
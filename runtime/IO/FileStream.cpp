@@ -23,6 +23,17 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pch.h"
 #include "FileStream.h"
 #include "../RHI/RHI_Vertex.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 //============================
 
 //= NAMESPACES =====
@@ -31,13 +42,94 @@ using namespace std;
 
 namespace spartan
 {
+    namespace
+    {
+        // big enough to turn a save into a handful of writes, small enough to not matter memory wise
+        const uint64_t write_buffer_size = 4 * 1024 * 1024;
+
+        bool map_file(const string& path, const byte** data, uint64_t* size, void** file_handle, void** mapping_handle)
+        {
+        #ifdef _WIN32
+            // share delete so that a cache can rename over or evict a file while it's mapped, like it can on posix
+            HANDLE file = CreateFileW(FileSystem::StringToWstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER file_size = {};
+            GetFileSizeEx(file, &file_size);
+            *size        = static_cast<uint64_t>(file_size.QuadPart);
+            *file_handle = file;
+
+            // empty files can't be mapped, they are still valid streams with nothing to read
+            if (*size == 0)
+                return true;
+
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping)
+            {
+                CloseHandle(file);
+                *file_handle = nullptr;
+                return false;
+            }
+
+            *data = static_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (!*data)
+            {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                *file_handle = nullptr;
+                return false;
+            }
+
+            *mapping_handle = mapping;
+        #else
+            int file = open(path.c_str(), O_RDONLY);
+            if (file == -1)
+                return false;
+
+            struct stat file_stat = {};
+            fstat(file, &file_stat);
+            *size = static_cast<uint64_t>(file_stat.st_size);
+
+            if (*size != 0)
+            {
+                void* mapping = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, file, 0);
+                if (mapping != MAP_FAILED)
+                {
+                    madvise(mapping, *size, MADV_SEQUENTIAL);
+                    *data = static_cast<const byte*>(mapping);
+                }
+            }
+
+            // the mapping keeps the file alive, so the descriptor is not needed any more
+            close(file);
+        #endif
+
+            return *size == 0 || *data != nullptr;
+        }
+
+        void unmap_file(const byte* data, const uint64_t size, void* file_handle, void* mapping_handle)
+        {
+        #ifdef _WIN32
+            if (data)           UnmapViewOfFile(data);
+            if (mapping_handle) CloseHandle(static_cast<HANDLE>(mapping_handle));
+            if (file_handle)    CloseHandle(static_cast<HANDLE>(file_handle));
+        #else
+            if (data)
+            {
+                munmap(const_cast<byte*>(data), size);
+            }
+        #endif
+        }
+    }
+
     FileStream::FileStream(const string& path, uint32_t flags)
     {
         m_is_open = false;
         m_flags   = flags;
+        m_path    = path;
 
         ios_base::openmode ios_flags = ios::binary;
-        if(flags & FileStream_Read)   ios_flags |= ios::in;
         if(flags & FileStream_Write)  ios_flags |= ios::out;
         if(flags & FileStream_Append) ios_flags |= ios::app;
 
@@ -49,11 +141,12 @@ namespace spartan
                 SP_LOG_ERROR("Failed to open \"%s\" for writing", path.c_str());
                 return;
             }
+
+            m_write_buffer.resize(write_buffer_size);
         }
         else if (m_flags & FileStream_Read)
         {
-            in.open(path, ios_flags);
-            if(in.fail())
+            if (!map_file(path, &m_data, &m_size, &m_file_handle, &m_mapping_handle))
             {
                 SP_LOG_ERROR("Failed to open \"%s\" for reading", path.c_str());
                 return;
@@ -70,24 +163,82 @@ namespace spartan
 
     void FileStream::Close()
     {
+        if (!m_is_open)
+            return;
+
         if (m_flags & FileStream_Write)
         {
+            FlushWriteBuffer();
             out.flush();
             out.close();
         }
         else if (m_flags & FileStream_Read)
         {
-            in.clear();
-            in.close();
+            unmap_file(m_data, m_size, m_file_handle, m_mapping_handle);
+            m_data           = nullptr;
+            m_size           = 0;
+            m_cursor         = 0;
+            m_file_handle    = nullptr;
+            m_mapping_handle = nullptr;
+        }
+
+        m_is_open = false;
+    }
+
+    void FileStream::WriteBytes(const void* data, const uint64_t size)
+    {
+        if (size == 0)
+            return;
+
+        // large payloads (vertices, mips) go straight to the file
+        if (size >= m_write_buffer.size())
+        {
+            FlushWriteBuffer();
+            out.write(reinterpret_cast<const char*>(data), static_cast<streamsize>(size));
+            return;
+        }
+
+        if (m_write_buffer_used + size > m_write_buffer.size())
+        {
+            FlushWriteBuffer();
         }
+
+        memcpy(m_write_buffer.data() + m_write_buffer_used, data, size);
+        m_write_buffer_used += size;
+    }
+
+    void FileStream::FlushWriteBuffer()
+    {
+        if (m_write_buffer_used == 0)
+            return;
+
+        out.write(reinterpret_cast<const char*>(m_write_buffer.data()), static_cast<streamsize>(m_write_buffer_used));
+        m_write_buffer_used = 0;
+    }
+
+    void FileStream::ReadBytes(void* data, const uint64_t size)
+    {
+        if (size > m_size - m_cursor)
+        {
+            if (!m_read_overflow)
+            {
+                SP_LOG_ERROR("Attempted to read past the end of \"%s\"", m_path.c_str());
+                m_read_overflow = true;
+            }
+
+            m_cursor = m_size;
+            return;
+        }
+
+        memcpy(data, m_data + m_cursor, size);
+        m_cursor += size;
     }
 
     void FileStream::Write(const string& value)
     {
         const auto length = static_cast<uint32_t>(value.length());
         Write(length);
-
-        out.write(const_cast<char*>(value.c_str()), length);
+        WriteBytes(value.data(), length);
     }
 
     void FileStream::Write(const vector<string>& value)
@@ -105,33 +256,39 @@ namespace spartan
     {
         const auto length = static_cast<uint32_t>(value.size());
         Write(length);
-        out.write(reinterpret_cast<const char*>(&value[0]), sizeof(RHI_Vertex_PosTexNorTan) * length);
+        WriteBytes(value.data(), sizeof(RHI_Vertex_PosTexNorTan) * length);
     }
 
     void FileStream::Write(const vector<uint32_t>& value)
     {
         const auto length = static_cast<uint32_t>(value.size());
         Write(length);
-        out.write(reinterpret_cast<const char*>(&value[0]), sizeof(uint32_t) * length);
+        WriteBytes(value.data(), sizeof(uint32_t) * length);
     }
 
     void FileStream::Write(const vector<unsigned char>& value)
     {
         const auto size = static_cast<uint32_t>(value.size());
         Write(size);
-        out.write(reinterpret_cast<const char*>(&value[0]), sizeof(unsigned char) * size);
+        WriteBytes(value.data(), sizeof(unsigned char) * size);
     }
 
     void FileStream::Write(const vector<byte>& value)
     {
         const auto size = static_cast<uint32_t>(value.size());
         Write(size);
-        out.write(reinterpret_cast<const char*>(&value[0]), sizeof(std::byte) * size);
+        WriteBytes(value.data(), sizeof(std::byte) * size);
     }
 
     void FileStream::Write(const atomic<bool>& value)
     {
-        out.write(reinterpret_cast<const char*>(&value), sizeof(bool));
+        const bool value_bool = value.load();
+        WriteBytes(&value_bool, sizeof(bool));
+    }
+
+    void FileStream::Write(const void* data, const uint64_t size)
+    {
+        WriteBytes(data, size);
     }
 
     void FileStream::Skip(uint64_t n)
@@ -139,11 +296,40 @@ namespace spartan
         // Set the seek cursor to offset n from the current position
         if (m_flags & FileStream_Write)
         {
+            FlushWriteBuffer();
             out.seekp(n, ios::cur);
         }
         else if (m_flags & FileStream_Read)
         {
-            in.ignore(n, ios::cur);
+            m_cursor = min(m_cursor + n, m_size);
+        }
+    }
+
+    void FileStream::Seek(const uint64_t position)
+    {
+        // positional reads, so that a file which has a table of offsets can be read out of order
+        SP_ASSERT_MSG(m_flags & FileStream_Read, "Seeking is only supported when reading");
+        m_cursor = min(position, m_size);
+    }
+
+    void FileStream::Align(const uint64_t alignment)
+    {
+        // pads (or skips) up to the next multiple of the alignment, so that ReadSpan() can return typed memory
+        SP_ASSERT(alignment != 0);
+
+        if (m_flags & FileStream_Write)
+        {
+            FlushWriteBuffer();
+            const uint64_t position = static_cast<uint64_t>(out.tellp());
+            const uint64_t padding  = (alignment - (position % alignment)) % alignment;
+            static const array<byte, 64> zeros = {};
+            SP_ASSERT(padding <= zeros.size());
+            WriteBytes(zeros.data(), padding);
+        }
+        else if (m_flags & FileStream_Read)
+        {
+            const uint64_t padding = (alignment - (m_cursor % alignment)) % alignment;
+            m_cursor               = min(m_cursor + padding, m_size);
         }
     }
 
@@ -152,8 +338,8 @@ namespace spartan
         uint32_t length = 0;
         Read(&length);
 
-        value->resize(length);
-        in.read(const_cast<char*>(value->c_str()), length);
+        span<const byte> bytes = ReadSpan(length);
+        value->assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
     }
 
     void FileStream::Read(vector<string>* vec)
@@ -182,11 +368,10 @@ namespace spartan
         vec->clear();
 
         const auto length = ReadAs<uint32_t>();
+        span<const byte> bytes = ReadSpan(sizeof(RHI_Vertex_PosTexNorTan) * length);
 
-        vec->reserve(length);
-        vec->resize(length);
-
-        in.read(reinterpret_cast<char*>(vec->data()), sizeof(RHI_Vertex_PosTexNorTan) * length);
+        vec->resize(bytes.size() / sizeof(RHI_Vertex_PosTexNorTan));
+        memcpy(vec->data(), bytes.data(), bytes.size());
     }
 
     void FileStream::Read(vector<uint32_t>* vec)
@@ -197,11 +382,10 @@ namespace spartan
         vec->clear();
 
         const auto length = ReadAs<uint32_t>();
+        span<const byte> bytes = ReadSpan(sizeof(uint32_t) * length);
 
-        vec->reserve(length);
-        vec->resize(length);
-
-        in.read(reinterpret_cast<char*>(vec->data()), sizeof(uint32_t) * length);
+        vec->resize(bytes.size() / sizeof(uint32_t));
+        memcpy(vec->data(), bytes.data(), bytes.size());
     }
 
     void FileStream::Read(vector<unsigned char>* vec)
@@ -212,11 +396,10 @@ namespace spartan
         vec->clear();
 
         const auto length = ReadAs<uint32_t>();
+        span<const byte> bytes = ReadSpan(sizeof(unsigned char) * length);
 
-        vec->reserve(length);
-        vec->resize(length);
-
-        in.read(reinterpret_cast<char*>(vec->data()), sizeof(unsigned char) * length);
+        vec->resize(bytes.size());
+        memcpy(vec->data(), bytes.data(), bytes.size());
     }
 
     void FileStream::Read(vector<std::byte>* vec)
@@ -227,15 +410,40 @@ namespace spartan
         vec->clear();
 
         const auto length = ReadAs<uint32_t>();
+        span<const byte> bytes = ReadSpan(sizeof(std::byte) * length);
 
-        vec->reserve(length);
-        vec->resize(length);
-
-        in.read(reinterpret_cast<char*>(vec->data()), sizeof(std::byte) * length);
+        vec->assign(bytes.begin(), bytes.end());
     }
 
     void FileStream::Read(std::atomic<bool>* value)
     {
-        in.read(reinterpret_cast<char*>(value), sizeof(bool));
+        bool value_bool = false;
+        ReadBytes(&value_bool, sizeof(bool));
+        value->store(value_bool);
+    }
+
+    void FileStream::Read(void* data, const uint64_t size)
+    {
+        ReadBytes(data, size);
+    }
+
+    span<const byte> FileStream::ReadSpan(const uint64_t size)
+    {
+        if (size > m_size - m_cursor)
+        {
+            if (!m_read_overflow)
+            {
+                SP_LOG_ERROR("Attempted to read past the end of \"%s\"", m_path.c_str());
+                m_read_overflow = true;
+            }
+
+            m_cursor = m_size;
+            return {};
+        }
+
+        span<const byte> bytes(m_data + m_cursor, size);
+        m_cursor += size;
+
+        return bytes;
     }
 }
@@ -24,6 +24,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES ===================
 #include <vector>
 #include <fstream>
+#include <span>
 #include "../Math/Vector2.h"
 #include "../Math/Vector3.h"
 #include "../Math/Vector4.h"
@@ -50,6 +51,11 @@ namespace spartan
         auto IsOpen() const { return m_is_open; }
         void Close();
 
+        // reading only
+        uint64_t GetSize()     const { return m_size; }
+        uint64_t GetPosition() const { return m_cursor; }
+        void Seek(const uint64_t position);
+
         //= WRITING ==================================================
         template <class T, class = typename std::enable_if<
             std::is_same<T, bool>::value                ||
@@ -76,7 +82,7 @@ namespace spartan
         >::type>
         void Write(T value)
         {
-            out.write(reinterpret_cast<char*>(&value), sizeof(value));
+            WriteBytes(&value, sizeof(value));
         }
 
         void Write(const std::string& value);
@@ -86,7 +92,9 @@ namespace spartan
         void Write(const std::vector<unsigned char>& value);
         void Write(const std::vector<std::byte>& value);
         void Write(const std::atomic<bool>& value);
+        void Write(const void* data, const uint64_t size);
         void Skip(uint64_t n);
+        void Align(const uint64_t alignment);
         //===========================================================
         
         //= READING ===========================================
@@ -116,7 +124,7 @@ namespace spartan
         >::type>
         void Read(T* value)
         {
-            in.read(reinterpret_cast<char*>(value), sizeof(T));
+            ReadBytes(value, sizeof(T));
         }
         void Read(std::string* value);
         void Read(std::vector<std::string>* vec);
@@ -125,6 +133,36 @@ namespace spartan
         void Read(std::vector<unsigned char>* vec);
         void Read(std::vector<std::byte>* vec);
         void Read(std::atomic<bool>* value);
+        void Read(void* data, const uint64_t size);
+
+        // zero-copy reads, the memory points into the file mapping and is valid until the stream is closed
+        std::span<const std::byte> ReadSpan(const uint64_t size);
+        template <class T>
+        bool ReadSpan(std::span<const T>* data) // reads a length prefixed array, as written by Write(const std::vector<T>&)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+            *data = {};
+            const uint64_t position = m_cursor;
+            const uint32_t length   = ReadAs<uint32_t>();
+
+            // the writer has to Align() for the data to be usable in place, if it didn't nothing
+            // is consumed, so the caller can fall back to a copying Read() of the same array
+            if (reinterpret_cast<uintptr_t>(m_data + m_cursor) % alignof(T) != 0)
+            {
+                m_cursor = position;
+                return false;
+            }
+
+            // an empty array is a successful read, only a read past the end fails
+            const uint64_t size = static_cast<uint64_t>(length) * sizeof(T);
+            std::span<const std::byte> bytes = ReadSpan(size);
+            if (bytes.size() != size)
+                return false;
+
+            *data = std::span<const T>(reinterpret_cast<const T*>(bytes.data()), length);
+            return true;
+        }
 
         // Reading with explicit type definition
         template <class T, class = typename std::enable_if
@@ -155,9 +193,25 @@ namespace spartan
         //=====================================================
 
     private:
+        void WriteBytes(const void* data, const uint64_t size);
+        void ReadBytes(void* data, const uint64_t size);
+        void FlushWriteBuffer();
+
+        // writing - buffered, so that serializing thousands of scalars doesn't turn into thousands of writes
         std::ofstream out;
-        std::ifstream in;
-        uint32_t m_flags;
-        bool m_is_open;
+        std::vector<std::byte> m_write_buffer;
+        uint64_t m_write_buffer_used = 0;
+
+        // reading - memory mapped
+        const std::byte* m_data = nullptr;
+        uint64_t m_size         = 0;
+        uint64_t m_cursor       = 0;
+        void* m_file_handle     = nullptr;
+        void* m_mapping_handle  = nullptr;
+        bool m_read_overflow    = false;
+
+        std::string m_path;
+        uint32_t m_flags = 0;
+        bool m_is_open   = false;
     };
 }
@@ -25,10 +25,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "PhysicsDebugDraw.h"
 #include "BulletPhysicsHelper.h"
 #include "ProgressTracker.h"
+#include "ThreadPool.h"
 #include "../Profiling/Profiler.h"
 #include "../Rendering/Renderer.h"
 #include "../Input/Input.h"
 #include "../World/Components/Camera.h"
+#include <shared_mutex>
 SP_WARNINGS_OFF
 #include <btBulletDynamicsCommon.h>
 #include <BulletDynamics/ConstraintSolver/btPoint2PointConstraint.h>
@@ -60,7 +62,14 @@ namespace spartan
         // world properties
         int max_solve_iterations       = 256;
         const float internal_time_step = 1.0f / 200.0f; // 200 Hz - needed for car simulation
+        const uint32_t max_substeps    = 8;                // beyond this, the simulation slows down instead of catching up
         float accumulator              = 0.0f;
+        float interpolation_alpha      = 0.0f;
+
+        // the simulation runs on the thread pool while the renderer works, World::Tick() and the editor only see it finished
+        future<void> simulation;
+        shared_mutex simulation_mutex;      // the step and structural changes (bodies, constraints) own the world, queries share it
+        thread_local bool stepping = false; // set on the thread that steps, queries made from inside the step (wheel rays) already own the world
         math::Vector3 gravity          = math::Vector3(0.0f, -9.81f, 0.0f);
 
         // picking
@@ -70,47 +79,203 @@ namespace spartan
         math::Vector3 hit_position              = math::Vector3::Zero;
         math::Vector3 picking_position_previous = math::Vector3::Zero;
         float picking_distance_previous         = 0.0f;
-
-        const bool soft_body_support = true;
     }
 
-    void Physics::Initialize()
+    namespace queries
     {
-        broadphase        = new btDbvtBroadphase();
-        constraint_solver = new btSequentialImpulseConstraintSolver();
+        const uint32_t parallel_count = 32; // below this, splitting the batch costs more than it saves
+        mutex overlap_mutex;                // overlaps get their collision algorithms from the dispatcher's pools, which aren't thread safe
+
+        // bullet's broadphase traverses its tree with a stack that belongs to the broadphase (unless bullet is built with BT_THREADSAFE),
+        // this one gives each thread its own, so that rays and sweeps can run side by side against the same tree
+        struct Broadphase : public btDbvtBroadphase
+        {
+            struct RayTester : btDbvt::ICollide
+            {
+                RayTester(btBroadphaseRayCallback& callback) : m_callback(callback) { }
+
+                void Process(const btDbvtNode* leaf) override
+                {
+                    m_callback.process(static_cast<btDbvtProxy*>(leaf->data));
+                }
+
+                btBroadphaseRayCallback& m_callback;
+            };
+
+            void rayTest(const btVector3& from, const btVector3& to, btBroadphaseRayCallback& callback, const btVector3& aabb_min, const btVector3& aabb_max) override
+            {
+                thread_local btAlignedObjectArray<const btDbvtNode*> stack;
+                RayTester tester(callback);
+
+                for (btDbvt& set : m_sets)
+                {
+                    set.rayTestInternal(set.m_root, from, to, callback.m_rayDirectionInverse, callback.m_signs, callback.m_lambda_max, aabb_min, aabb_max, stack, tester);
+                }
+            }
+        };
+
+        struct RayCallback : public btCollisionWorld::ClosestRayResultCallback
+        {
+            RayCallback(const btVector3& from, const btVector3& to, const btCollisionObject* ignore)
+            : ClosestRayResultCallback(from, to), m_ignore(ignore) { }
+
+            bool needsCollision(btBroadphaseProxy* proxy) const override
+            {
+                return proxy->m_clientObject != m_ignore && ClosestRayResultCallback::needsCollision(proxy);
+            }
+
+            const btCollisionObject* m_ignore;
+        };
+
+        struct SweepCallback : public btCollisionWorld::ClosestConvexResultCallback
+        {
+            SweepCallback(const btVector3& from, const btVector3& to, const btCollisionObject* ignore)
+            : ClosestConvexResultCallback(from, to), m_ignore(ignore) { }
+
+            bool needsCollision(btBroadphaseProxy* proxy) const override
+            {
+                return proxy->m_clientObject != m_ignore && ClosestConvexResultCallback::needsCollision(proxy);
+            }
+
+            const btCollisionObject* m_ignore;
+        };
 
-        if (soft_body_support)
+        // keeps the deepest contact
+        struct OverlapCallback : public btCollisionWorld::ContactResultCallback
         {
-            // create
-            collision_configuration = new btSoftBodyRigidBodyCollisionConfiguration();
-            collision_dispatcher    = new btCollisionDispatcher(collision_configuration);
-            world                   = new btSoftRigidDynamicsWorld(collision_dispatcher, broadphase, constraint_solver, collision_configuration);
-
-            // setup         
-            world_info = new btSoftBodyWorldInfo();
-            world_info->m_sparsesdf.Initialize();
-            world->getDispatchInfo().m_enableSPU = true;
-            world_info->m_dispatcher             = collision_dispatcher;
-            world_info->m_broadphase             = broadphase;
-            world_info->air_density              = (btScalar)1.2;
-            world_info->water_density            = 0;
-            world_info->water_offset             = 0;
-            world_info->water_normal             = btVector3(0, 0, 0);
-            world_info->m_gravity                = vector_to_bt(gravity);
+            OverlapCallback(const btCollisionObject* query, const btCollisionObject* ignore) : m_query(query), m_ignore(ignore) { }
+
+            bool needsCollision(btBroadphaseProxy* proxy) const override
+            {
+                return proxy->m_clientObject != m_ignore && ContactResultCallback::needsCollision(proxy);
+            }
+
+            btScalar addSingleResult(btManifoldPoint& point, const btCollisionObjectWrapper* wrapper_a, int, int, const btCollisionObjectWrapper* wrapper_b, int, int) override
+            {
+                if (point.getDistance() < m_distance)
+                {
+                    // the query object can end up on either side, depending on the collision algorithm that handled the pair,
+                    // the normal on b points from b to a, so it's flipped when the hit object is a
+                    const bool query_is_a = wrapper_a->getCollisionObject() == m_query;
+
+                    m_distance = point.getDistance();
+                    m_object   = (query_is_a ? wrapper_b : wrapper_a)->getCollisionObject();
+                    m_position = query_is_a ? point.getPositionWorldOnB() : point.getPositionWorldOnA();
+                    m_normal   = query_is_a ? point.m_normalWorldOnB : -point.m_normalWorldOnB;
+                }
+
+                return 0;
+            }
+
+            const btCollisionObject* m_query  = nullptr;
+            const btCollisionObject* m_ignore = nullptr;
+            const btCollisionObject* m_object = nullptr;
+            btScalar m_distance               = 0.0f; // only penetrating contacts count
+            btVector3 m_position;
+            btVector3 m_normal;
+        };
+
+        bool is_overlap(const PhysicsQuery& query)
+        {
+            return query.type == PhysicsQueryType::OverlapSphere || query.type == PhysicsQueryType::OverlapBox;
         }
-        else
+
+        btRigidBody* to_body(const btCollisionObject* object)
         {
-            // create
-            collision_configuration = new btDefaultCollisionConfiguration();
-            collision_dispatcher    = new btCollisionDispatcher(collision_configuration);
-            world                   = new btDiscreteDynamicsWorld(collision_dispatcher, broadphase, constraint_solver, collision_configuration);
+            return const_cast<btRigidBody*>(btRigidBody::upcast(object));
         }
 
+        void execute(const PhysicsQuery& query, PhysicsHit& hit)
+        {
+            hit = PhysicsHit();
+
+            const btVector3 start = vector_to_bt(query.start);
+            const btVector3 end   = vector_to_bt(query.end);
+
+            if (query.type == PhysicsQueryType::Ray)
+            {
+                RayCallback callback(start, end, query.ignore);
+                world->rayTest(start, end, callback);
+
+                if (callback.hasHit())
+                {
+                    hit.body     = to_body(callback.m_collisionObject);
+                    hit.position = bt_to_vector(callback.m_hitPointWorld);
+                    hit.normal   = bt_to_vector(callback.m_hitNormalWorld);
+                    hit.fraction = callback.m_closestHitFraction;
+                }
+
+                return;
+            }
+
+            // the shapes live on the stack, nothing is allocated per query
+            btSphereShape sphere(query.extents.x);
+            btBoxShape box(vector_to_bt(query.extents));
+            const bool is_sphere = query.type == PhysicsQueryType::SweepSphere || query.type == PhysicsQueryType::OverlapSphere;
+            btConvexShape* shape = is_sphere ? static_cast<btConvexShape*>(&sphere) : static_cast<btConvexShape*>(&box);
+            const btQuaternion rotation = quaternion_to_bt(query.rotation);
+
+            if (query.type == PhysicsQueryType::SweepSphere || query.type == PhysicsQueryType::SweepBox)
+            {
+                SweepCallback callback(start, end, query.ignore);
+                world->convexSweepTest(shape, btTransform(rotation, start), btTransform(rotation, end), callback);
+
+                if (callback.hasHit())
+                {
+                    hit.body     = to_body(callback.m_hitCollisionObject);
+                    hit.position = bt_to_vector(callback.m_hitPointWorld);
+                    hit.normal   = bt_to_vector(callback.m_hitNormalWorld);
+                    hit.fraction = callback.m_closestHitFraction;
+                }
+            }
+            else
+            {
+                btCollisionObject object;
+                object.setCollisionShape(shape);
+                object.setWorldTransform(btTransform(rotation, start));
+
+                OverlapCallback callback(&object, query.ignore);
+                world->contactTest(&object, callback);
+
+                if (callback.m_object)
+                {
+                    hit.body     = to_body(callback.m_object);
+                    hit.position = bt_to_vector(callback.m_position);
+                    hit.normal   = bt_to_vector(callback.m_normal);
+                    hit.fraction = 0.0f;
+                }
+            }
+        }
+    }
+
+    void Physics::Initialize()
+    {
+        broadphase        = new queries::Broadphase();
+        constraint_solver = new btSequentialImpulseConstraintSolver();
+
+        // create
+        collision_configuration = new btSoftBodyRigidBodyCollisionConfiguration();
+        collision_dispatcher    = new btCollisionDispatcher(collision_configuration);
+        world                   = new btSoftRigidDynamicsWorld(collision_dispatcher, broadphase, constraint_solver, collision_configuration);
+
+        // setup soft bodies
+        world_info = new btSoftBodyWorldInfo();
+        world_info->m_sparsesdf.Initialize();
+        world->getDispatchInfo().m_enableSPU = true;
+        world_info->m_dispatcher             = collision_dispatcher;
+        world_info->m_broadphase             = broadphase;
+        world_info->air_density              = (btScalar)1.2;
+        world_info->water_density            = 0;
+        world_info->water_offset             = 0;
+        world_info->water_normal             = btVector3(0, 0, 0);
+        world_info->m_gravity                = vector_to_bt(gravity);
+
         // setup
         world->setGravity(vector_to_bt(gravity));
         world->getDispatchInfo().m_useContinuous = true;
         world->getSolverInfo().m_splitImpulse    = false;
         world->getSolverInfo().m_numIterations   = max_solve_iterations;
+        world->setLatencyMotionStateInterpolation(false); // motion states get the actual state, they interpolate themselves
 
         // get version
         const string major = to_string(btGetVersion() / 100);
@@ -130,6 +295,8 @@ namespace spartan
 
     void Physics::Shutdown()
     {
+        PostTick();
+
         delete world;
         world = nullptr;
     
@@ -155,11 +322,17 @@ namespace spartan
     void Physics::Tick()
     {
         SP_PROFILE_CPU();
-;
+
         // don't simulate or debug draw when loading a world (a different thread could be creating physics objects)
         if (ProgressTracker::IsLoading())
             return;
 
+        // draw before stepping, the world is off limits once the simulation is running
+        if (Renderer::GetOption<bool>(Renderer_Option::Physics))
+        {
+            world->debugDrawWorld();
+        }
+
         if (Engine::IsFlagSet(EngineMode::Playing))
         {
             // Picking
@@ -176,95 +349,134 @@ namespace spartan
                 MovePickedBody();
             }
 
-            // accumulate elapsed time
-            float freme_time  = static_cast<float>(Timer::GetDeltaTimeSec());
-            accumulator      += freme_time;
-            // update physics as many times as needed to consume the accumulator at 200 Hz rate
-            while (accumulator >= internal_time_step)
+            // accumulate elapsed time, capped so that a long frame (loading, shader compilation) can't
+            // turn into a burst of substeps which makes the next frame long as well, time dilates instead
+            float frame_time = static_cast<float>(Timer::GetDeltaTimeSec());
+            accumulator      = min(accumulator + frame_time, max_substeps * internal_time_step);
+
+            // consume the accumulator at a 200 Hz rate
+            uint32_t substep_count = static_cast<uint32_t>(accumulator / internal_time_step);
+            accumulator           -= substep_count * internal_time_step;
+
+            // bodies render this far between their last two states, see PhysicsBody
+            interpolation_alpha = accumulator / internal_time_step;
+
+            // step asynchronously, motion states are the only engine side state written, PostTick() waits
+            if (substep_count > 0)
             {
-                world->stepSimulation(internal_time_step, 1, internal_time_step);
-                accumulator -= internal_time_step;
+                simulation = ThreadPool::AddTask([substep_count]()
+                {
+                    lock_guard<shared_mutex> lock(simulation_mutex);
+                    stepping = true;
+
+                    for (uint32_t i = 0; i < substep_count; i++)
+                    {
+                        world->stepSimulation(internal_time_step, 1, internal_time_step);
+                    }
+
+                    stepping = false;
+                });
             }
         }
+    }
 
-        if (Renderer::GetOption<bool>(Renderer_Option::Physics))
+    void Physics::PostTick()
+    {
+        SP_PROFILE_CPU();
+
+        // the simulation ran next to the renderer, it has to finish before the next World::Tick() and the editor touch bodies
+        if (simulation.valid())
         {
-            world->debugDrawWorld();
+            simulation.get();
         }
     }
 
-    vector<btRigidBody*> Physics::RayCast(const Vector3& start, const Vector3& end)
+    void Physics::Query(const PhysicsQuery* queries, PhysicsHit* hits, const uint32_t count)
     {
-        btVector3 bt_start = vector_to_bt(start);
-        btVector3 bt_end   = vector_to_bt(end);
+        SP_PROFILE_CPU();
 
-        btCollisionWorld::AllHitsRayResultCallback ray_callback(bt_start, bt_end);
-        world->rayTest(bt_start, bt_end, ray_callback);
+        if (count == 0)
+            return;
 
-        vector<btRigidBody*> hit_bodies;
-        if (ray_callback.hasHit())
+        // queries only read the world, so they can run side by side, as long as the simulation isn't
+        shared_lock<shared_mutex> lock(simulation_mutex, defer_lock);
+        if (!stepping)
         {
-            for (int i = 0; i < ray_callback.m_collisionObjects.size(); ++i)
+            lock.lock();
+        }
+
+        // rays and sweeps are spread across the thread pool
+        auto execute_range = [queries, hits](uint32_t start, uint32_t end)
+        {
+            for (uint32_t i = start; i < end; i++)
             {
-                if (const btRigidBody* body = btRigidBody::upcast(ray_callback.m_collisionObjects[i]))
+                if (!queries::is_overlap(queries[i]))
                 {
-                    hit_bodies.push_back(const_cast<btRigidBody*>(body));
+                    queries::execute(queries[i], hits[i]);
                 }
             }
-        }
-
-        return hit_bodies;
-    }
-
-    Vector3 Physics::RayCastFirstHitPosition(const math::Vector3& start, const math::Vector3& end)
-    {
-        btVector3 bt_start = vector_to_bt(start);
-        btVector3 bt_end   = vector_to_bt(end);
-
-        btCollisionWorld::ClosestRayResultCallback ray_callback(bt_start, bt_end);
-        world->rayTest(bt_start, bt_end, ray_callback);
+        };
 
-        if (ray_callback.hasHit())
+        if (count >= queries::parallel_count)
+        {
+            ThreadPool::ParallelLoop(execute_range, count);
+        }
+        else
         {
-            return bt_to_vector(ray_callback.m_hitPointWorld);
+            execute_range(0, count);
         }
 
-        return Vector3::Infinity;
+        // overlaps run here, one at a time
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (queries::is_overlap(queries[i]))
+            {
+                lock_guard<mutex> lock_overlap(queries::overlap_mutex);
+                queries::execute(queries[i], hits[i]);
+            }
+        }
     }
 
     void Physics::AddBody(btRigidBody* body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->addRigidBody(body);
     }
 
     void Physics::RemoveBody(btRigidBody*& body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->removeRigidBody(body);
     }
 
     void Physics::AddBody(btRaycastVehicle* body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->addVehicle(body);
     }
 
     void Physics::RemoveBody(btRaycastVehicle*& body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->removeVehicle(body);
     }
 
     void Physics::AddConstraint(btTypedConstraint* constraint, bool collision_with_linked_body /*= true*/)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->addConstraint(constraint, !collision_with_linked_body);
     }
 
     void Physics::RemoveConstraint(btTypedConstraint*& constraint)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         world->removeConstraint(constraint);
         delete constraint;
     }
 
     void Physics::AddBody(btSoftBody* body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         if (btSoftRigidDynamicsWorld* _world = static_cast<btSoftRigidDynamicsWorld*>(world))
         {
             _world->addSoftBody(body);
@@ -273,6 +485,7 @@ namespace spartan
 
     void Physics::RemoveBody(btSoftBody*& body)
     {
+        lock_guard<shared_mutex> lock(simulation_mutex);
         if (btSoftRigidDynamicsWorld* _world = static_cast<btSoftRigidDynamicsWorld*>(world))
         {
             _world->removeSoftBody(body);
@@ -305,6 +518,11 @@ namespace spartan
         return 1.0f / internal_time_step;
     }
 
+    float Physics::GetInterpolationAlpha()
+    {
+        return interpolation_alpha;
+    }
+
     void Physics::PickBody()
     {
         if (shared_ptr<Camera> camera = Renderer::GetCamera())
@@ -41,15 +41,44 @@ class btRaycastVehicle;
 
 namespace spartan
 {
+    enum class PhysicsQueryType : uint8_t
+    {
+        Ray,
+        SweepSphere,
+        SweepBox,
+        OverlapSphere,
+        OverlapBox
+    };
+
+    struct PhysicsQuery
+    {
+        PhysicsQueryType type            = PhysicsQueryType::Ray;
+        math::Vector3 start              = math::Vector3::Zero;
+        math::Vector3 end                = math::Vector3::Zero;          // ignored by overlaps
+        math::Vector3 extents            = math::Vector3::One;           // sphere radius in x, box half extents
+        math::Quaternion rotation        = math::Quaternion::Identity;   // boxes only
+        const btCollisionObject* ignore  = nullptr;                      // usually the body asking
+    };
+
+    struct PhysicsHit
+    {
+        btRigidBody* body      = nullptr; // nullptr when nothing was hit
+        math::Vector3 position = math::Vector3::Infinity;
+        math::Vector3 normal   = math::Vector3::Zero;
+        float fraction         = 1.0f;    // how far along start -> end, 0 for overlaps
+    };
+
     class Physics
     {
     public:
         static void Initialize();
         static void Shutdown();
         static void Tick();
+        static void PostTick();
 
-        static std::vector<btRigidBody*> RayCast(const math::Vector3& start, const math::Vector3& end);
-        static math::Vector3 RayCastFirstHitPosition(const math::Vector3& start, const math::Vector3& end);
+        // runs a batch of queries, writing the closest hit of each into the matching element of hits
+        // large batches are spread across the thread pool, can be called from any thread, and from within the step (e.g. a vehicle raycaster)
+        static void Query(const PhysicsQuery* queries, PhysicsHit* hits, const uint32_t count);
 
         // body
         static void AddBody(btRigidBody* body);
@@ -69,6 +98,7 @@ namespace spartan
         static void* GetPhysicsDebugDraw();
         static void* GetWorld();
         static float GetTimeStepInternalSec();
+        static float GetInterpolationAlpha();
 
     private:
         // picking
@@ -0,0 +1,735 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//= INCLUDES ================================
+#include "pch.h"
+#include "PhysicsShapeCache.h"
+#include "../Rendering/Mesh.h"
+#include "../IO/FileStream.h"
+#include "../Resource/DerivedDataCache.h"
+#include "../RHI/RHI_Vertex.h"
+SP_WARNINGS_OFF
+#include <BulletCollision/CollisionShapes/btConvexHullShape.h>
+#include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#include <LinearMath/btConvexHullComputer.h>
+SP_WARNINGS_ON
+//===========================================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    namespace
+    {
+        const uint32_t magic   = 0x48425053; // "SPBH"
+        const uint32_t version = 1;
+
+        enum class ShapeKind : uint64_t
+        {
+            ConvexHull,
+            TriangleMesh,
+            ConvexDecomposition
+        };
+
+        // the positions and indices of a mesh range, copied once per unique geometry since the shape outlives the mesh
+        struct Geometry
+        {
+            vector<float> positions;
+            vector<int> indices; // relative to the first vertex of the range
+            uint64_t hash = 0;
+        };
+
+        // weak, so that shapes are freed along with the last body, the derived data cache makes rebuilding them cheap
+        // an entry is erased when its shape is freed
+        unordered_map<uint64_t, weak_ptr<btCollisionShape>> shapes;
+        // geometry hashes by mesh and range, so that a shape which already exists is found without copying and hashing its geometry again
+        // a mesh's entries are erased when the mesh is destroyed
+        unordered_map<uint64_t, unordered_map<uint64_t, uint64_t>> geometry_hashes;
+        mutex mutex_shapes;
+
+        uint64_t compute_range_key(Mesh* mesh, const SubMesh& range)
+        {
+            // the total counts are part of the key, so that a mesh which is cleared and refilled doesn't hit stale hashes
+            uint64_t key = static_cast<uint64_t>(range.vertex_offset);
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(range.vertex_count));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(range.index_offset));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(range.index_count));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(mesh->GetVertices().size()));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(mesh->GetIndices().size()));
+
+            return key;
+        }
+
+        Geometry extract_geometry(Mesh* mesh, const SubMesh& range)
+        {
+            const vector<RHI_Vertex_PosTexNorTan>& vertices = mesh->GetVertices();
+            const vector<uint32_t>& indices                 = mesh->GetIndices();
+
+            Geometry geometry;
+            geometry.positions.resize(static_cast<size_t>(range.vertex_count) * 3);
+            for (uint32_t i = 0; i < range.vertex_count; i++)
+            {
+                const RHI_Vertex_PosTexNorTan& vertex = vertices[range.vertex_offset + i];
+                geometry.positions[i * 3 + 0]        = vertex.pos[0];
+                geometry.positions[i * 3 + 1]        = vertex.pos[1];
+                geometry.positions[i * 3 + 2]        = vertex.pos[2];
+            }
+
+            geometry.indices.assign(indices.begin() + range.index_offset, indices.begin() + range.index_offset + range.index_count);
+
+            geometry.hash = DerivedDataCache::HashBytes(geometry.positions.data(), geometry.positions.size() * sizeof(float));
+            geometry.hash = rhi_hash_combine(geometry.hash, DerivedDataCache::HashBytes(geometry.indices.data(), geometry.indices.size() * sizeof(int)));
+
+            lock_guard<mutex> lock(mutex_shapes);
+            geometry_hashes[mesh->GetObjectId()][compute_range_key(mesh, range)] = geometry.hash;
+
+            return geometry;
+        }
+
+        // owns everything a triangle mesh shape points to, destroyed in reverse order of construction
+        struct TriangleMesh
+        {
+            ~TriangleMesh()
+            {
+                shape.reset();
+
+                if (bvh_loaded)
+                {
+                    bvh_loaded->~btOptimizedBvh();
+                    btAlignedFree(bvh_buffer);
+                }
+            }
+
+            Geometry geometry;
+            unique_ptr<btTriangleIndexVertexArray> mesh_interface;
+            void* bvh_buffer            = nullptr; // when the bvh was loaded, it lives in here
+            btOptimizedBvh* bvh_loaded  = nullptr;
+            unique_ptr<btBvhTriangleMeshShape> shape;
+        };
+
+        // owns the parts, the compound doesn't
+        struct ConvexDecomposition
+        {
+            vector<unique_ptr<btConvexHullShape>> parts;
+            unique_ptr<btCompoundShape> shape;
+        };
+
+        uint64_t compute_key(const ShapeKind kind, const uint64_t geometry_hash)
+        {
+            uint64_t key = rhi_hash_combine(geometry_hash, static_cast<uint64_t>(kind));
+            key          = rhi_hash_combine(key, magic);
+            key          = rhi_hash_combine(key, version);
+            key          = rhi_hash_combine(key, sizeof(btScalar)); // the bvh layout depends on it
+
+            return key;
+        }
+
+        void remove_expired(const uint64_t key)
+        {
+            lock_guard<mutex> lock(mutex_shapes);
+
+            // a new shape may have been registered under the key since this one expired
+            auto it = shapes.find(key);
+            if (it != shapes.end() && it->second.expired())
+            {
+                shapes.erase(it);
+            }
+        }
+
+        // returns a live shape if another body (or thread) got there first, otherwise registers the given one
+        template<typename T>
+        shared_ptr<T> find_or_add(const uint64_t key, shared_ptr<T> shape)
+        {
+            lock_guard<mutex> lock(mutex_shapes);
+
+            auto it = shapes.find(key);
+            if (it != shapes.end())
+            {
+                if (shared_ptr<btCollisionShape> existing = it->second.lock())
+                    return static_pointer_cast<T>(existing);
+            }
+
+            if (!shape)
+                return nullptr;
+
+            // the bodies get a handle which erases the entry once the last of them lets go, and only then frees the shape
+            shared_ptr<T> handle(shape.get(), [key, shape](T*) mutable
+            {
+                remove_expired(key);
+                shape.reset();
+            });
+            shapes[key] = handle;
+
+            return handle;
+        }
+
+        // a live shape for a mesh range whose geometry has been hashed before, without touching the geometry
+        template<typename T>
+        shared_ptr<T> find_by_range(const ShapeKind kind, Mesh* mesh, const SubMesh& range)
+        {
+            uint64_t geometry_hash = 0;
+            {
+                lock_guard<mutex> lock(mutex_shapes);
+
+                auto it_mesh = geometry_hashes.find(mesh->GetObjectId());
+                if (it_mesh == geometry_hashes.end())
+                    return nullptr;
+
+                auto it = it_mesh->second.find(compute_range_key(mesh, range));
+                if (it == it_mesh->second.end())
+                    return nullptr;
+
+                geometry_hash = it->second;
+            }
+
+            return find_or_add<T>(compute_key(kind, geometry_hash), nullptr);
+        }
+
+        bool load_bvh(const uint64_t key, TriangleMesh& mesh)
+        {
+            FileStream file(DerivedDataCache::GetFilePath(key), FileStream_Read);
+            if (!file.IsOpen())
+                return false;
+
+            if (file.ReadAs<uint32_t>() != magic || file.ReadAs<uint32_t>() != version || file.ReadAs<uint64_t>() != key)
+                return false;
+
+            // bullet requires the buffer to be 16 byte aligned, the bvh is used in place
+            const uint32_t size = file.ReadAs<uint32_t>();
+            if (size == 0 || size > file.GetSize())
+                return false;
+
+            void* buffer = btAlignedAlloc(size, 16);
+            file.Read(buffer, size);
+
+            // the trailing magic guards against truncated files
+            btOptimizedBvh* bvh = file.ReadAs<uint32_t>() == magic ? btOptimizedBvh::deSerializeInPlace(buffer, size, false) : nullptr;
+            if (!bvh)
+            {
+                btAlignedFree(buffer);
+                return false;
+            }
+
+            mesh.bvh_buffer = buffer;
+            mesh.bvh_loaded = bvh;
+            mesh.shape      = make_unique<btBvhTriangleMeshShape>(mesh.mesh_interface.get(), true, false);
+            mesh.shape->setOptimizedBvh(bvh);
+
+            return true;
+        }
+
+        void save_bvh(const uint64_t key, const btOptimizedBvh* bvh)
+        {
+            const uint32_t size = bvh->calculateSerializeBufferSize();
+            void* buffer        = btAlignedAlloc(size, 16);
+
+            if (bvh->serializeInPlace(buffer, size, false))
+            {
+                const string file_path_temp = DerivedDataCache::GetFilePathTemp(key);
+                {
+                    FileStream file(file_path_temp, FileStream_Write);
+                    if (file.IsOpen())
+                    {
+                        file.Write(magic);
+                        file.Write(version);
+                        file.Write(key);
+                        file.Write(size);
+                        file.Write(buffer, size);
+                        file.Write(magic);
+                    }
+                }
+
+                DerivedDataCache::Commit(key, file_path_temp);
+            }
+
+            btAlignedFree(buffer);
+        }
+    }
+
+    namespace decomposition
+    {
+        // the mesh is voxelized and the voxels are split by axis aligned planes, the part whose hull covers the most empty
+        // space is split where the two halves are the most convex, until every part is nearly convex or the budget is spent
+        const uint32_t resolution           = 32;    // voxels along the longest axis
+        const uint32_t max_parts            = 16;
+        const float max_concavity           = 0.02f; // empty space a part's hull can cover, relative to the volume of the whole mesh
+        const array<float, 3> split_offsets = { 0.25f, 0.5f, 0.75f };
+
+        struct Grid
+        {
+            btVector3 origin;
+            btVector3 bounds_min; // of the mesh, voxels stick out by up to a voxel
+            btVector3 bounds_max;
+            float cell = 1.0f;
+            int dims[3] = { 0, 0, 0 };
+
+            uint32_t index(const int x, const int y, const int z) const { return static_cast<uint32_t>((z * dims[1] + y) * dims[0] + x); }
+            void coordinates(const uint32_t index, int* xyz) const
+            {
+                xyz[0] = static_cast<int>(index % dims[0]);
+                xyz[1] = static_cast<int>((index / dims[0]) % dims[1]);
+                xyz[2] = static_cast<int>(index / (dims[0] * dims[1]));
+            }
+        };
+
+        struct Part
+        {
+            vector<uint32_t> voxels;
+            vector<btVector3> hull;
+            float concavity = 0.0f; // hull volume minus voxel volume
+            int min[3]      = { INT_MAX, INT_MAX, INT_MAX };
+            int max[3]      = { INT_MIN, INT_MIN, INT_MIN };
+        };
+
+        // surface voxels come from sampling the triangles, the rest are found by flood filling the outside, open meshes stay hollow
+        vector<uint32_t> voxelize(const Geometry& geometry, Grid& grid)
+        {
+            const uint32_t vertex_count = static_cast<uint32_t>(geometry.positions.size() / 3);
+
+            btVector3 mesh_min(FLT_MAX, FLT_MAX, FLT_MAX);
+            btVector3 mesh_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (uint32_t i = 0; i < vertex_count; i++)
+            {
+                const btVector3 position(geometry.positions[i * 3], geometry.positions[i * 3 + 1], geometry.positions[i * 3 + 2]);
+                mesh_min.setMin(position);
+                mesh_max.setMax(position);
+            }
+
+            // one voxel of padding around the mesh, so that the outside is connected
+            const btVector3 extent = mesh_max - mesh_min;
+            grid.bounds_min        = mesh_min;
+            grid.bounds_max        = mesh_max;
+            grid.cell              = max(extent[extent.maxAxis()] / resolution, 0.0001f);
+            grid.origin            = mesh_min - btVector3(grid.cell, grid.cell, grid.cell);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                grid.dims[axis] = static_cast<int>(ceil(extent[axis] / grid.cell)) + 3;
+            }
+
+            enum : uint8_t { Unknown, Surface, Outside };
+            vector<uint8_t> state(static_cast<size_t>(grid.dims[0]) * grid.dims[1] * grid.dims[2], Unknown);
+
+            auto mark = [&](const btVector3& position)
+            {
+                const btVector3 local = (position - grid.origin) / grid.cell;
+                const int x           = clamp(static_cast<int>(local.x()), 0, grid.dims[0] - 1);
+                const int y           = clamp(static_cast<int>(local.y()), 0, grid.dims[1] - 1);
+                const int z           = clamp(static_cast<int>(local.z()), 0, grid.dims[2] - 1);
+                state[grid.index(x, y, z)] = Surface;
+            };
+
+            for (size_t i = 0; i + 2 < geometry.indices.size(); i += 3)
+            {
+                const float* p0 = &geometry.positions[geometry.indices[i + 0] * 3];
+                const float* p1 = &geometry.positions[geometry.indices[i + 1] * 3];
+                const float* p2 = &geometry.positions[geometry.indices[i + 2] * 3];
+                const btVector3 a(p0[0], p0[1], p0[2]);
+                const btVector3 b(p1[0], p1[1], p1[2]);
+                const btVector3 c(p2[0], p2[1], p2[2]);
+
+                // samples closer than half a voxel can't skip one
+                const float edge = max((b - a).length(), max((c - a).length(), (c - b).length()));
+                const int steps  = max(1, static_cast<int>(ceil(edge / (grid.cell * 0.5f))));
+                for (int u = 0; u <= steps; u++)
+                {
+                    for (int v = 0; u + v <= steps; v++)
+                    {
+                        mark(a + (b - a) * (static_cast<float>(u) / steps) + (c - a) * (static_cast<float>(v) / steps));
+                    }
+                }
+            }
+
+            vector<uint32_t> stack = { grid.index(0, 0, 0) };
+            state[stack[0]]        = Outside;
+            while (!stack.empty())
+            {
+                int xyz[3];
+                grid.coordinates(stack.back(), xyz);
+                stack.pop_back();
+
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    for (int direction = -1; direction <= 1; direction += 2)
+                    {
+                        int neighbor[3]  = { xyz[0], xyz[1], xyz[2] };
+                        neighbor[axis]  += direction;
+                        if (neighbor[axis] < 0 || neighbor[axis] >= grid.dims[axis])
+                            continue;
+
+                        const uint32_t index = grid.index(neighbor[0], neighbor[1], neighbor[2]);
+                        if (state[index] == Unknown)
+                        {
+                            state[index] = Outside;
+                            stack.push_back(index);
+                        }
+                    }
+                }
+            }
+
+            vector<uint32_t> voxels;
+            for (uint32_t i = 0; i < static_cast<uint32_t>(state.size()); i++)
+            {
+                if (state[i] != Outside)
+                {
+                    voxels.push_back(i);
+                }
+            }
+
+            return voxels;
+        }
+
+        float hull_volume(const btConvexHullComputer& computer)
+        {
+            btVector3 center(0.0f, 0.0f, 0.0f);
+            for (int i = 0; i < computer.vertices.size(); i++)
+            {
+                center += computer.vertices[i];
+            }
+            center /= static_cast<btScalar>(computer.vertices.size());
+
+            // a fan of tetrahedra from the center through every face
+            float volume = 0.0f;
+            for (int face = 0; face < computer.faces.size(); face++)
+            {
+                const btConvexHullComputer::Edge* first = &computer.edges[computer.faces[face]];
+                const btVector3& a                      = computer.vertices[first->getSourceVertex()];
+                for (const btConvexHullComputer::Edge* edge = first->getNextEdgeOfFace(); edge->getTargetVertex() != first->getSourceVertex(); edge = edge->getNextEdgeOfFace())
+                {
+                    const btVector3& b = computer.vertices[edge->getSourceVertex()];
+                    const btVector3& c = computer.vertices[edge->getTargetVertex()];
+                    volume            += btFabs((a - center).dot((b - center).cross(c - center))) / 6.0f;
+                }
+            }
+
+            return volume;
+        }
+
+        // the hull goes through the outer corners of the part's boundary voxels
+        void evaluate(const Grid& grid, Part& part, vector<uint32_t>& voxel_stamps, vector<uint32_t>& corner_stamps, uint32_t& stamp)
+        {
+            stamp++;
+            for (uint32_t voxel : part.voxels)
+            {
+                voxel_stamps[voxel] = stamp;
+
+                int xyz[3];
+                grid.coordinates(voxel, xyz);
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    part.min[axis] = min(part.min[axis], xyz[axis]);
+                    part.max[axis] = max(part.max[axis], xyz[axis]);
+                }
+            }
+
+            const int corner_dims[3] = { grid.dims[0] + 1, grid.dims[1] + 1, grid.dims[2] + 1 };
+            vector<btVector3> points;
+            for (uint32_t voxel : part.voxels)
+            {
+                int xyz[3];
+                grid.coordinates(voxel, xyz);
+
+                // interior voxels can't contribute to the hull
+                bool is_boundary = false;
+                for (int axis = 0; axis < 3 && !is_boundary; axis++)
+                {
+                    for (int direction = -1; direction <= 1 && !is_boundary; direction += 2)
+                    {
+                        int neighbor[3]  = { xyz[0], xyz[1], xyz[2] };
+                        neighbor[axis]  += direction;
+                        is_boundary      = voxel_stamps[grid.index(neighbor[0], neighbor[1], neighbor[2])] != stamp;
+                    }
+                }
+                if (!is_boundary)
+                    continue;
+
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    const int x           = xyz[0] + (corner & 1);
+                    const int y           = xyz[1] + ((corner >> 1) & 1);
+                    const int z           = xyz[2] + ((corner >> 2) & 1);
+                    const uint32_t index  = static_cast<uint32_t>((z * corner_dims[1] + y) * corner_dims[0] + x);
+                    if (corner_stamps[index] != stamp)
+                    {
+                        corner_stamps[index] = stamp;
+                        btVector3 point = grid.origin + btVector3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) * grid.cell;
+                        point.setMax(grid.bounds_min);
+                        point.setMin(grid.bounds_max);
+                        points.push_back(point);
+                    }
+                }
+            }
+
+            // a part without points (or a degenerate one) has no hull, it's dropped when the hulls are collected
+            part.hull.clear();
+            part.concavity = 0.0f;
+            if (points.empty())
+                return;
+
+            btConvexHullComputer computer;
+            computer.compute(points[0].m_floats, static_cast<int>(sizeof(btVector3)), static_cast<int>(points.size()), 0.0f, 0.0f);
+            if (computer.vertices.size() == 0)
+                return;
+
+            const float voxel_volume = static_cast<float>(part.voxels.size()) * grid.cell * grid.cell * grid.cell;
+            part.hull.assign(&computer.vertices[0], &computer.vertices[0] + computer.vertices.size());
+            part.concavity = max(0.0f, hull_volume(computer) - voxel_volume);
+        }
+
+        vector<vector<btVector3>> decompose(const Geometry& geometry)
+        {
+            Grid grid;
+            vector<Part> parts(1);
+            parts[0].voxels = voxelize(geometry, grid);
+
+            // voxels on the padding are never part of the mesh, so neighbor lookups never leave the grid
+            vector<uint32_t> voxel_stamps(static_cast<size_t>(grid.dims[0]) * grid.dims[1] * grid.dims[2], 0);
+            vector<uint32_t> corner_stamps(static_cast<size_t>(grid.dims[0] + 1) * (grid.dims[1] + 1) * (grid.dims[2] + 1), 0);
+            uint32_t stamp = 0;
+            evaluate(grid, parts[0], voxel_stamps, corner_stamps, stamp);
+
+            const float threshold = max_concavity * static_cast<float>(parts[0].voxels.size()) * grid.cell * grid.cell * grid.cell;
+            while (parts.size() < max_parts)
+            {
+                // the least convex part
+                auto worst = max_element(parts.begin(), parts.end(), [](const Part& a, const Part& b) { return a.concavity < b.concavity; });
+                if (worst->concavity <= threshold)
+                    break;
+
+                // try a few planes on every axis
+                Part best_a, best_b;
+                float best_cost = numeric_limits<float>::max();
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    for (float offset : split_offsets)
+                    {
+                        const int split = worst->min[axis] + static_cast<int>(round((worst->max[axis] - worst->min[axis]) * offset));
+
+                        Part a, b;
+                        for (uint32_t voxel : worst->voxels)
+                        {
+                            int xyz[3];
+                            grid.coordinates(voxel, xyz);
+                            (xyz[axis] < split ? a : b).voxels.push_back(voxel);
+                        }
+                        if (a.voxels.empty() || b.voxels.empty())
+                            continue;
+
+                        evaluate(grid, a, voxel_stamps, corner_stamps, stamp);
+                        evaluate(grid, b, voxel_stamps, corner_stamps, stamp);
+
+                        const float cost = a.concavity + b.concavity;
+                        if (cost < best_cost)
+                        {
+                            best_cost = cost;
+                            best_a    = move(a);
+                            best_b    = move(b);
+                        }
+                    }
+                }
+
+                // a single voxel, it can't be split any further
+                if (best_a.voxels.empty())
+                {
+                    worst->concavity = 0.0f;
+                    continue;
+                }
+
+                *worst = move(best_a);
+                parts.push_back(move(best_b));
+            }
+
+            vector<vector<btVector3>> hulls;
+            for (Part& part : parts)
+            {
+                if (!part.hull.empty())
+                {
+                    hulls.push_back(move(part.hull));
+                }
+            }
+
+            return hulls;
+        }
+
+        bool load(const uint64_t key, vector<vector<btVector3>>& hulls)
+        {
+            FileStream file(DerivedDataCache::GetFilePath(key), FileStream_Read);
+            if (!file.IsOpen())
+                return false;
+
+            if (file.ReadAs<uint32_t>() != magic || file.ReadAs<uint32_t>() != version || file.ReadAs<uint64_t>() != key)
+                return false;
+
+            const uint32_t hull_count = file.ReadAs<uint32_t>();
+            if (hull_count > max_parts)
+                return false;
+
+            hulls.resize(hull_count);
+            for (vector<btVector3>& hull : hulls)
+            {
+                const uint32_t point_count = file.ReadAs<uint32_t>();
+                if (point_count == 0 || static_cast<uint64_t>(point_count) * sizeof(btVector3) > file.GetSize())
+                    return false;
+
+                hull.resize(point_count);
+                file.Read(hull.data(), point_count * sizeof(btVector3));
+            }
+
+            // the trailing magic guards against truncated files
+            return file.ReadAs<uint32_t>() == magic;
+        }
+
+        void save(const uint64_t key, const vector<vector<btVector3>>& hulls)
+        {
+            const string file_path_temp = DerivedDataCache::GetFilePathTemp(key);
+            {
+                FileStream file(file_path_temp, FileStream_Write);
+                if (!file.IsOpen())
+                    return;
+
+                file.Write(magic);
+                file.Write(version);
+                file.Write(key);
+                // empty hulls are skipped, load() treats them as a corrupt entry
+                const uint32_t hull_count = static_cast<uint32_t>(count_if(hulls.begin(), hulls.end(), [](const vector<btVector3>& hull) { return !hull.empty(); }));
+                file.Write(hull_count);
+                for (const vector<btVector3>& hull : hulls)
+                {
+                    if (hull.empty())
+                        continue;
+
+                    file.Write(static_cast<uint32_t>(hull.size()));
+                    file.Write(hull.data(), hull.size() * sizeof(btVector3));
+                }
+                file.Write(magic);
+            }
+
+            DerivedDataCache::Commit(key, file_path_temp);
+        }
+    }
+
+    shared_ptr<btConvexHullShape> PhysicsShapeCache::GetConvexHull(Mesh* mesh, const SubMesh& range)
+    {
+        if (shared_ptr<btConvexHullShape> shape = find_by_range<btConvexHullShape>(ShapeKind::ConvexHull, mesh, range))
+            return shape;
+
+        // the same geometry may already have a shape through another mesh or range
+        Geometry geometry  = extract_geometry(mesh, range);
+        const uint64_t key = compute_key(ShapeKind::ConvexHull, geometry.hash);
+        if (shared_ptr<btConvexHullShape> shape = find_or_add<btConvexHullShape>(key, nullptr))
+            return shape;
+
+        // built outside of the lock, hulls of different meshes can be built in parallel
+        shared_ptr<btConvexHullShape> shape(new btConvexHullShape(geometry.positions.data(), range.vertex_count, static_cast<int>(sizeof(float) * 3)));
+        shape->optimizeConvexHull();
+
+        return find_or_add(key, shape);
+    }
+
+    shared_ptr<btBvhTriangleMeshShape> PhysicsShapeCache::GetTriangleMesh(Mesh* mesh, const SubMesh& range)
+    {
+        if (shared_ptr<btBvhTriangleMeshShape> shape = find_by_range<btBvhTriangleMeshShape>(ShapeKind::TriangleMesh, mesh, range))
+            return shape;
+
+        // the same geometry may already have a shape through another mesh or range
+        Geometry geometry  = extract_geometry(mesh, range);
+        const uint64_t key = compute_key(ShapeKind::TriangleMesh, geometry.hash);
+        if (shared_ptr<btBvhTriangleMeshShape> shape = find_or_add<btBvhTriangleMeshShape>(key, nullptr))
+            return shape;
+
+        shared_ptr<TriangleMesh> triangle_mesh = make_shared<TriangleMesh>();
+        triangle_mesh->geometry                = move(geometry);
+        triangle_mesh->mesh_interface          = make_unique<btTriangleIndexVertexArray>(
+            static_cast<int>(triangle_mesh->geometry.indices.size() / 3),
+            triangle_mesh->geometry.indices.data(),
+            static_cast<int>(sizeof(int) * 3),
+            static_cast<int>(range.vertex_count),
+            triangle_mesh->geometry.positions.data(),
+            static_cast<int>(sizeof(float) * 3)
+        );
+
+        // building the bvh is what dominates physics setup for large static meshes, so it's only done once
+        if (DerivedDataCache::Exists(key) && !load_bvh(key, *triangle_mesh))
+        {
+            DerivedDataCache::Invalidate(key);
+        }
+
+        if (!triangle_mesh->shape)
+        {
+            triangle_mesh->shape = make_unique<btBvhTriangleMeshShape>(triangle_mesh->mesh_interface.get(), true);
+            save_bvh(key, triangle_mesh->shape->getOptimizedBvh());
+        }
+
+        // the shape shares ownership of everything it points to
+        return find_or_add(key, shared_ptr<btBvhTriangleMeshShape>(triangle_mesh, triangle_mesh->shape.get()));
+    }
+
+    shared_ptr<btCompoundShape> PhysicsShapeCache::GetConvexDecomposition(Mesh* mesh, const SubMesh& range)
+    {
+        if (shared_ptr<btCompoundShape> shape = find_by_range<btCompoundShape>(ShapeKind::ConvexDecomposition, mesh, range))
+            return shape;
+
+        // the same geometry may already have a shape through another mesh or range
+        Geometry geometry  = extract_geometry(mesh, range);
+        const uint64_t key = compute_key(ShapeKind::ConvexDecomposition, geometry.hash);
+        if (shared_ptr<btCompoundShape> shape = find_or_add<btCompoundShape>(key, nullptr))
+            return shape;
+
+        // decomposing is slow, so it's done once per asset, after that the hulls come from the derived data cache
+        vector<vector<btVector3>> hulls;
+        if (DerivedDataCache::Exists(key) && !decomposition::load(key, hulls))
+        {
+            DerivedDataCache::Invalidate(key);
+            hulls.clear();
+        }
+
+        if (hulls.empty())
+        {
+            hulls = decomposition::decompose(geometry);
+            decomposition::save(key, hulls);
+        }
+
+        shared_ptr<ConvexDecomposition> entry = make_shared<ConvexDecomposition>();
+        entry->shape                          = make_unique<btCompoundShape>(true, static_cast<int>(hulls.size()));
+        for (const vector<btVector3>& hull : hulls)
+        {
+            if (hull.empty())
+                continue;
+
+            unique_ptr<btConvexHullShape> part = make_unique<btConvexHullShape>(hull[0].m_floats, static_cast<int>(hull.size()), static_cast<int>(sizeof(btVector3)));
+            entry->shape->addChildShape(btTransform::getIdentity(), part.get());
+            entry->parts.push_back(move(part));
+        }
+
+        // the compound shares ownership of its parts
+        return find_or_add(key, shared_ptr<btCompoundShape>(entry, entry->shape.get()));
+    }
+
+    void PhysicsShapeCache::RemoveMesh(const Mesh* mesh)
+    {
+        lock_guard<mutex> lock(mutex_shapes);
+        geometry_hashes.erase(mesh->GetObjectId());
+    }
+}
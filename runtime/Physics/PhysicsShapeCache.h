@@ -0,0 +1,54 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+//= INCLUDES =
+#include <memory>
+//============
+
+//= FORWARD DECLARATIONS =====
+class btConvexHullShape;
+class btBvhTriangleMeshShape;
+class btCompoundShape;
+//============================
+
+namespace spartan
+{
+    class Mesh;
+    struct SubMesh;
+
+    // collision shapes built from mesh geometry, shared by every body which uses the same geometry (by content, not by mesh),
+    // triangle mesh bvhs are also kept in the derived data cache so that large static meshes don't rebuild them on every load
+    class PhysicsShapeCache
+    {
+    public:
+        // unscaled, the returned pointer keeps the shape alive, it's freed along with the last body using it
+        static std::shared_ptr<btConvexHullShape> GetConvexHull(Mesh* mesh, const SubMesh& range);
+        static std::shared_ptr<btBvhTriangleMeshShape> GetTriangleMesh(Mesh* mesh, const SubMesh& range);
+
+        // a compound of convex parts which approximates concave geometry, for dynamic bodies which can't use a triangle mesh
+        static std::shared_ptr<btCompoundShape> GetConvexDecomposition(Mesh* mesh, const SubMesh& range);
+
+        // forgets the geometry hashes of a mesh's ranges, called when the mesh is destroyed
+        static void RemoveMesh(const Mesh* mesh);
+    };
+}
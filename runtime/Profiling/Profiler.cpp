@@ -28,6 +28,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../Core/ThreadPool.h"
 #include "../Core/Debugging.h"
 #include "../Rendering/Renderer.h"
+#include "../Rendering/TextureStreaming.h"
 #include "../Resource/ResourceCache.h"
 #include "../Display/Display.h"
 //====================================
@@ -434,6 +435,7 @@ namespace spartan
                 "GPU\n"
                 "Name:\t\t\t%s\n"
                 "Memory:\t\t%u/%u MB\n"
+                "Streaming:\t%u/%u MB\n"
                 "API:\t\t\t\t\t%s\t%s\n"
                 "Driver:\t\t\t%s\t\t%s\n\n"
                 "CPU\n"
@@ -471,6 +473,7 @@ namespace spartan
 
                 gpu_name.c_str(),
                 gpu_memory_used, gpu_memory_available,
+                TextureStreaming::GetResidentMb(), TextureStreaming::GetBudgetMb(),
                 RHI_Context::api_type_str.c_str(), gpu_api.c_str(),
                 RHI_Device::GetPrimaryPhysicalDevice()->GetVendorName().c_str(), gpu_driver.c_str(),
 
@@ -0,0 +1,415 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+//= INCLUDES =================
+#include "pch.h"
+#include "RHI_BlockCompressor.h"
+#include "../Core/ThreadPool.h"
+//============================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    namespace
+    {
+        // a 4x4 block of texels in the 0-255 range, laid out as structure of arrays so that four texels can be processed at once
+        struct Block
+        {
+            alignas(16) float r[16];
+            alignas(16) float g[16];
+            alignas(16) float b[16];
+            alignas(16) float a[16];
+        };
+
+        void load_block(const vector<byte>& source, const uint32_t width, const uint32_t height, const uint32_t block_x, const uint32_t block_y, Block& block)
+        {
+            const uint8_t* texels = reinterpret_cast<const uint8_t*>(source.data());
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                // blocks which extend past the edge of the image (small mips or odd sizes) repeat the last row and column
+                const uint32_t texel_y = min(block_y * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    const uint32_t texel_x = min(block_x * 4 + x, width - 1);
+                    const uint8_t* texel   = texels + (static_cast<size_t>(texel_y) * width + texel_x) * 4;
+                    const uint32_t i       = y * 4 + x;
+
+                    block.r[i] = static_cast<float>(texel[0]);
+                    block.g[i] = static_cast<float>(texel[1]);
+                    block.b[i] = static_cast<float>(texel[2]);
+                    block.a[i] = static_cast<float>(texel[3]);
+                }
+            }
+        }
+
+        void write_block(byte* destination, const uint64_t block)
+        {
+            memcpy(destination, &block, sizeof(block));
+        }
+
+        // bc4: two 8-bit endpoints followed by a 3-bit index per texel, the min and max of the block are used as endpoints
+        // so that the block decodes in the mode with 8 interpolated values, index 0 and 1 are the endpoints and 2 to 7
+        // step from the first endpoint towards the second
+        uint64_t encode_bc4(const float* values)
+        {
+            float value_min = values[0];
+            float value_max = values[0];
+            for (uint32_t i = 1; i < 16; i++)
+            {
+                value_min = min(value_min, values[i]);
+                value_max = max(value_max, values[i]);
+            }
+
+            const uint32_t endpoint_0 = static_cast<uint32_t>(value_max);
+            const uint32_t endpoint_1 = static_cast<uint32_t>(value_min);
+            uint64_t block            = endpoint_0 | (endpoint_1 << 8);
+
+            // a constant block, all indices point to the first endpoint
+            if (endpoint_0 == endpoint_1)
+                return block;
+
+            static constexpr uint64_t step_to_index[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+            const float step_scale = 7.0f / static_cast<float>(endpoint_0 - endpoint_1);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const uint32_t step = static_cast<uint32_t>((static_cast<float>(endpoint_0) - values[i]) * step_scale + 0.5f);
+                block |= step_to_index[step] << (16 + i * 3);
+            }
+
+            return block;
+        }
+
+        uint16_t to_565(const float r, const float g, const float b)
+        {
+            const uint32_t r5 = static_cast<uint32_t>(clamp(r, 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+            const uint32_t g6 = static_cast<uint32_t>(clamp(g, 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+            const uint32_t b5 = static_cast<uint32_t>(clamp(b, 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+
+            return static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+        }
+
+        void from_565(const uint16_t color, float* rgb)
+        {
+            const uint32_t r5 = (color >> 11) & 31;
+            const uint32_t g6 = (color >> 5) & 63;
+            const uint32_t b5 = color & 31;
+
+            rgb[0] = static_cast<float>((r5 << 3) | (r5 >> 2));
+            rgb[1] = static_cast<float>((g6 << 2) | (g6 >> 4));
+            rgb[2] = static_cast<float>((b5 << 3) | (b5 >> 2));
+        }
+
+        // picks the closest of the four palette colors for every texel and returns the squared error of the block
+        float compute_bc1_indices(const Block& block, const uint16_t color_0, const uint16_t color_1, uint32_t& indices)
+        {
+            float palette[4][3];
+            from_565(color_0, palette[0]);
+            from_565(color_1, palette[1]);
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+
+            indices     = 0;
+            float error = 0.0f;
+
+        #if defined(__AVX2__)
+            for (uint32_t i = 0; i < 16; i += 4)
+            {
+                const __m128 r = _mm_load_ps(&block.r[i]);
+                const __m128 g = _mm_load_ps(&block.g[i]);
+                const __m128 b = _mm_load_ps(&block.b[i]);
+
+                __m128 distance_best = _mm_set1_ps(numeric_limits<float>::max());
+                __m128i index_best   = _mm_setzero_si128();
+                for (uint32_t p = 0; p < 4; p++)
+                {
+                    const __m128 dr       = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+                    const __m128 dg       = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+                    const __m128 db       = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+                    const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                    const __m128 closer   = _mm_cmplt_ps(distance, distance_best);
+
+                    distance_best = _mm_min_ps(distance, distance_best);
+                    index_best    = _mm_blendv_epi8(index_best, _mm_set1_epi32(static_cast<int32_t>(p)), _mm_castps_si128(closer));
+                }
+
+                alignas(16) uint32_t lane_index[4];
+                alignas(16) float lane_distance[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lane_index), index_best);
+                _mm_store_ps(lane_distance, distance_best);
+                for (uint32_t lane = 0; lane < 4; lane++)
+                {
+                    indices |= lane_index[lane] << ((i + lane) * 2);
+                    error   += lane_distance[lane];
+                }
+            }
+        #else
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                float distance_best = numeric_limits<float>::max();
+                uint32_t index_best = 0;
+                for (uint32_t p = 0; p < 4; p++)
+                {
+                    const float dr       = block.r[i] - palette[p][0];
+                    const float dg       = block.g[i] - palette[p][1];
+                    const float db       = block.b[i] - palette[p][2];
+                    const float distance = dr * dr + dg * dg + db * db;
+                    if (distance < distance_best)
+                    {
+                        distance_best = distance;
+                        index_best    = p;
+                    }
+                }
+
+                indices |= index_best << (i * 2);
+                error   += distance_best;
+            }
+        #endif
+
+            return error;
+        }
+
+        // orders the endpoints so the block decodes in four color mode (two equal endpoints decode as that color with index 0)
+        float fit_bc1(const Block& block, uint16_t& color_0, uint16_t& color_1, uint32_t& indices)
+        {
+            if (color_0 < color_1)
+            {
+                swap(color_0, color_1);
+            }
+
+            return compute_bc1_indices(block, color_0, color_1, indices);
+        }
+
+        // least squares fit of the two endpoints which minimize the error for the given indices
+        bool refine_bc1(const Block& block, const uint32_t indices, uint16_t& color_0, uint16_t& color_1)
+        {
+            static constexpr float index_to_weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f }; // weight of color_0
+
+            float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+            float ax[3] = {}, bx[3] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const float a = index_to_weight[(indices >> (i * 2)) & 3];
+                const float b = 1.0f - a;
+
+                aa    += a * a;
+                bb    += b * b;
+                ab    += a * b;
+                ax[0] += a * block.r[i];
+                ax[1] += a * block.g[i];
+                ax[2] += a * block.b[i];
+                bx[0] += b * block.r[i];
+                bx[1] += b * block.g[i];
+                bx[2] += b * block.b[i];
+            }
+
+            // all texels use the same index
+            const float determinant = aa * bb - ab * ab;
+            if (fabs(determinant) < 1e-6f)
+                return false;
+
+            const float determinant_inverse = 1.0f / determinant;
+            float endpoint_0[3], endpoint_1[3];
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                endpoint_0[c] = (ax[c] * bb - bx[c] * ab) * determinant_inverse;
+                endpoint_1[c] = (bx[c] * aa - ax[c] * ab) * determinant_inverse;
+            }
+
+            color_0 = to_565(endpoint_0[0], endpoint_0[1], endpoint_0[2]);
+            color_1 = to_565(endpoint_1[0], endpoint_1[1], endpoint_1[2]);
+
+            return true;
+        }
+
+        // bc1: two 565 endpoints followed by a 2-bit index per texel, the endpoints start at the texels that lie
+        // furthest apart along the principal axis of the block's colors and are then refined with least squares
+        uint64_t encode_bc1(const Block& block)
+        {
+            float mean[3] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                mean[0] += block.r[i];
+                mean[1] += block.g[i];
+                mean[2] += block.b[i];
+            }
+            mean[0] /= 16.0f;
+            mean[1] /= 16.0f;
+            mean[2] /= 16.0f;
+
+            // covariance, rr rg rb gg gb bb
+            float covariance[6] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const float r = block.r[i] - mean[0];
+                const float g = block.g[i] - mean[1];
+                const float b = block.b[i] - mean[2];
+
+                covariance[0] += r * r;
+                covariance[1] += r * g;
+                covariance[2] += r * b;
+                covariance[3] += g * g;
+                covariance[4] += g * b;
+                covariance[5] += b * b;
+            }
+
+            // principal axis through power iteration
+            float axis[3] = { 1.0f, 1.0f, 1.0f };
+            for (uint32_t iteration = 0; iteration < 4; iteration++)
+            {
+                const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+                const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+                const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+
+                const float length = max(fabs(x), max(fabs(y), fabs(z)));
+                if (length < 1e-4f)
+                    break;
+
+                axis[0] = x / length;
+                axis[1] = y / length;
+                axis[2] = z / length;
+            }
+
+            // a flat block, a single color with all indices at 0
+            if (covariance[0] + covariance[3] + covariance[5] < 1e-4f)
+            {
+                const uint64_t color = to_565(mean[0], mean[1], mean[2]);
+                return color | (color << 16);
+            }
+
+            uint32_t index_min   = 0;
+            uint32_t index_max   = 0;
+            float projection_min = numeric_limits<float>::max();
+            float projection_max = -numeric_limits<float>::max();
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const float projection = block.r[i] * axis[0] + block.g[i] * axis[1] + block.b[i] * axis[2];
+                if (projection < projection_min)
+                {
+                    projection_min = projection;
+                    index_min      = i;
+                }
+                if (projection > projection_max)
+                {
+                    projection_max = projection;
+                    index_max      = i;
+                }
+            }
+
+            uint16_t color_0 = to_565(block.r[index_max], block.g[index_max], block.b[index_max]);
+            uint16_t color_1 = to_565(block.r[index_min], block.g[index_min], block.b[index_min]);
+            uint32_t indices = 0;
+            float error      = fit_bc1(block, color_0, color_1, indices);
+
+            for (uint32_t iteration = 0; iteration < 2; iteration++)
+            {
+                uint16_t refined_0 = color_0;
+                uint16_t refined_1 = color_1;
+                if (!refine_bc1(block, indices, refined_0, refined_1))
+                    break;
+
+                uint32_t refined_indices  = 0;
+                const float refined_error = fit_bc1(block, refined_0, refined_1, refined_indices);
+                if (refined_error >= error)
+                    break;
+
+                color_0 = refined_0;
+                color_1 = refined_1;
+                indices = refined_indices;
+                error   = refined_error;
+            }
+
+            return static_cast<uint64_t>(color_0) | (static_cast<uint64_t>(color_1) << 16) | (static_cast<uint64_t>(indices) << 32);
+        }
+    }
+
+    bool RHI_BlockCompressor::IsSupported(const RHI_Format format)
+    {
+        return format == RHI_Format::BC1_Unorm || format == RHI_Format::BC3_Unorm || format == RHI_Format::BC5_Unorm;
+    }
+
+    void RHI_BlockCompressor::Compress(const vector<byte>& source, const uint32_t width, const uint32_t height, const RHI_Format format, vector<byte>& destination)
+    {
+        SP_ASSERT(IsSupported(format));
+        SP_ASSERT(width > 0 && height > 0);
+        SP_ASSERT(source.size() >= static_cast<size_t>(width) * height * 4);
+
+        const uint32_t block_count_x   = (width + 3) / 4;
+        const uint32_t block_count_y   = (height + 3) / 4;
+        const uint32_t bytes_per_block = format == RHI_Format::BC1_Unorm ? 8 : 16;
+        destination.resize(static_cast<size_t>(block_count_x) * block_count_y * bytes_per_block);
+
+        auto compress_rows = [&](uint32_t row_start, uint32_t row_end)
+        {
+            Block block;
+            for (uint32_t block_y = row_start; block_y < row_end; block_y++)
+            {
+                for (uint32_t block_x = 0; block_x < block_count_x; block_x++)
+                {
+                    load_block(source, width, height, block_x, block_y, block);
+                    byte* output = &destination[(static_cast<size_t>(block_y) * block_count_x + block_x) * bytes_per_block];
+
+                    if (format == RHI_Format::BC1_Unorm)
+                    {
+                        write_block(output, encode_bc1(block));
+                    }
+                    else if (format == RHI_Format::BC3_Unorm)
+                    {
+                        write_block(output,     encode_bc4(block.a));
+                        write_block(output + 8, encode_bc1(block));
+                    }
+                    else // BC5
+                    {
+                        write_block(output,     encode_bc4(block.r));
+                        write_block(output + 8, encode_bc4(block.g));
+                    }
+                }
+            }
+        };
+
+        // the tail of the mip chain is only a few blocks, not worth waking up threads for
+        if (block_count_y >= 16)
+        {
+            ThreadPool::ParallelLoop(compress_rows, block_count_y);
+        }
+        else
+        {
+            compress_rows(0, block_count_y);
+        }
+    }
+
+    bool RHI_BlockCompressor::IsOpaque(const vector<byte>& source)
+    {
+        for (size_t i = 3; i < source.size(); i += 4)
+        {
+            if (source[i] != static_cast<byte>(255))
+                return false;
+        }
+
+        return true;
+    }
+}
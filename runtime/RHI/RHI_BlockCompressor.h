@@ -0,0 +1,45 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+//= INCLUDES ==============
+#include <vector>
+#include "RHI_Definitions.h"
+//=========================
+
+namespace spartan
+{
+    // a fast bc1, bc3 and bc5 encoder for load time texture compression, rows of blocks are encoded in parallel
+    // on the thread pool, the compressonator remains the high quality (and much slower) path
+    class RHI_BlockCompressor
+    {
+    public:
+        static bool IsSupported(const RHI_Format format);
+
+        // source is rgba8, destination is resized to the whole blocks that cover width x height
+        static void Compress(const std::vector<std::byte>& source, const uint32_t width, const uint32_t height, const RHI_Format format, std::vector<std::byte>& destination);
+
+        // bc1 can't store alpha, so it's only an option when every texel is opaque
+        static bool IsOpaque(const std::vector<std::byte>& source);
+    };
+}
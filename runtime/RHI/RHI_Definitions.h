@@ -406,6 +406,9 @@ namespace spartan
             case RHI_Format::R32G32B32A32_Float:   return "RHI_Format_R32G32B32A32_Float";
             case RHI_Format::D32_Float:            return "RHI_Format_D32_Float";
             case RHI_Format::D32_Float_S8X24_Uint: return "RHI_Format_D32_Float_S8X24_Uint";
+            case RHI_Format::BC1_Unorm:            return "RHI_Format_BC1";
+            case RHI_Format::BC3_Unorm:            return "RHI_Format_BC3";
+            case RHI_Format::BC5_Unorm:            return "RHI_Format_BC5";
             case RHI_Format::BC7_Unorm:            return "RHI_Format_BC7";
             case RHI_Format::Max:                  return "RHI_Format_Undefined";
             default:                               break;
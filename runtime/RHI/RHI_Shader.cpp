@@ -23,7 +23,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pch.h"
 #include "RHI_Shader.h"
 #include "RHI_InputLayout.h"
+#include "RHI_ShaderCache.h"
+#include "RHI_Device.h"
 #include "../Core/ThreadPool.h"
+#include "../Core/Debugging.h"
 //=============================
 
 //= NAMESPACES =====
@@ -32,6 +35,52 @@ using namespace std;
 
 namespace spartan
 {
+    namespace
+    {
+        // process-wide cache of shader files, every shader and permutation shares the common includes
+        struct ShaderFile
+        {
+            std::shared_ptr<const string> source;
+            filesystem::file_time_type time;
+            uint64_t hash    = 0;
+            uint32_t version = 0; // increments only when the content changes, not when the file is merely touched
+        };
+        unordered_map<string, ShaderFile> shader_files;
+        mutex mutex_shader_files;
+
+        ShaderFile get_shader_file(const string& file_path)
+        {
+            error_code error;
+            filesystem::file_time_type time = filesystem::last_write_time(file_path, error);
+
+            {
+                lock_guard<mutex> lock(mutex_shader_files);
+                auto it = shader_files.find(file_path);
+                if (it != shader_files.end() && it->second.time == time)
+                    return it->second;
+            }
+
+            // read outside of the lock so that other threads can keep hitting the cache
+            ifstream in(file_path);
+            stringstream buffer;
+            buffer << in.rdbuf();
+            shared_ptr<const string> source = make_shared<const string>(buffer.str());
+            uint64_t hash                   = static_cast<uint64_t>(std::hash<string>{}(*source));
+
+            lock_guard<mutex> lock(mutex_shader_files);
+            ShaderFile& file = shader_files[file_path];
+            if (!file.source || file.hash != hash)
+            {
+                file.version++;
+            }
+            file.source = source;
+            file.time   = time;
+            file.hash   = hash;
+
+            return file;
+        }
+    }
+
     RHI_Shader::RHI_Shader() : SpartanObject()
     {
 
@@ -62,19 +111,26 @@ namespace spartan
         // compile
         {
             m_compilation_state = RHI_ShaderCompilationState::Idle;
+            RHI_ShaderCache::OnCompilationStart();
 
             auto compile = [this, shader_type, async]()
             {
                 // time compilation
                 const Stopwatch timer;
 
-                // compile
+                // compile, a previous module (re-compilation) is released once the gpu is done with it
+                m_is_from_cache     = false;
                 m_compilation_state = RHI_ShaderCompilationState::Compiling;
-                m_rhi_resource      = RHI_Compile();
-                m_compilation_state = m_rhi_resource ? RHI_ShaderCompilationState::Succeeded : RHI_ShaderCompilationState::Failed;
+
+                void* rhi_resource_previous = m_rhi_resource;
+                m_rhi_resource              = RHI_Compile();
+                RHI_Device::DeletionQueueAdd(RHI_Resource_Type::Shader, rhi_resource_previous);
+
+                const RHI_ShaderCompilationState state = m_rhi_resource ? RHI_ShaderCompilationState::Succeeded : RHI_ShaderCompilationState::Failed;
+                RHI_ShaderCache::OnCompilationEnd(m_is_from_cache);
 
                 // log failure
-                if (m_compilation_state != RHI_ShaderCompilationState::Succeeded)
+                if (state != RHI_ShaderCompilationState::Succeeded)
                 {
                     string defines_str;
                     for (const auto& define : m_defines)
@@ -94,6 +150,9 @@ namespace spartan
                         SP_LOG_ERROR("Failed to compile shader \"%s\" with definitions \"%s\".", m_object_name.c_str(), defines_str.c_str());
                     }
                 }
+
+                // set last, so that whoever waits on the state can release the shader as soon as it changes
+                m_compilation_state = state;
             };
 
             if (async)
@@ -121,28 +180,34 @@ namespace spartan
             return;
         }
 
-        // load source
-        ifstream in(file_path);
-        stringstream buffer;
-        buffer << in.rdbuf();
-        string source = buffer.str();
-        
+        // load source (from memory, unless the file has been modified)
+        ShaderFile file      = get_shader_file(file_path);
+        const string& source = *file.source;
+
         // go through every line
-        istringstream stream(source);
-        string source_line;
-        while (getline(stream, source_line))
+        size_t line_start = 0;
+        while (line_start < source.size())
         {
+            size_t line_end = source.find('\n', line_start);
+            if (line_end == string::npos)
+            {
+                line_end = source.size();
+            }
+            string_view source_line(source.data() + line_start, line_end - line_start);
+            line_start = line_end + 1;
+
             // add the line to the preprocessed source
-            bool is_include_directive = source_line.find(include_directive_prefix) != string::npos;
+            bool is_include_directive = source_line.find(include_directive_prefix) != string_view::npos;
             if (!is_include_directive)
             {
-                m_preprocessed_source += source_line + "\n";
+                m_preprocessed_source.append(source_line);
+                m_preprocessed_source += '\n';
             }
             // if the line is an include directive, process it recursively
             else
             {
                 // construct include file
-                string file_name         = FileSystem::GetStringBetweenExpressions(source_line, include_directive_prefix, "\"");
+                string file_name         = FileSystem::GetStringBetweenExpressions(string(source_line), include_directive_prefix, "\"");
                 string include_file_path = FileSystem::GetDirectoryFromFilePath(file_path) + file_name;
 
                 // process
@@ -156,6 +221,9 @@ namespace spartan
         // save file path
         m_file_paths.emplace_back(file_path);
 
+        // save the version of the file, this is what hot reloading compares against
+        m_file_versions.emplace_back(file.version);
+
         // save source
         m_sources.emplace_back(source);
     }
@@ -169,6 +237,7 @@ namespace spartan
         m_names.clear();
         m_file_paths.clear();
         m_sources.clear();
+        m_file_versions.clear();
         m_file_paths_multiple.clear();
 
         // construct the source by recursively processing all include directives, starting from the actual file path.
@@ -191,6 +260,51 @@ namespace spartan
         reverse(m_names.begin(), m_names.end());
         reverse(m_file_paths.begin(), m_file_paths.end());
         reverse(m_sources.begin(), m_sources.end());
+        reverse(m_file_versions.begin(), m_file_versions.end());
+    }
+
+    bool RHI_Shader::IsStale() const
+    {
+        if (m_file_paths.empty())
+            return false;
+
+        // a file that was re-saved without changes keeps its version, so it doesn't cause a recompilation
+        for (uint32_t i = 0; i < static_cast<uint32_t>(m_file_paths.size()); i++)
+        {
+            if (get_shader_file(m_file_paths[i]).version != m_file_versions[i])
+                return true;
+        }
+
+        return false;
+    }
+
+    uint64_t RHI_Shader::GetCacheKey() const
+    {
+        // the source hash doesn't include anything that affects the compiler arguments
+        uint64_t key = m_hash;
+        key          = rhi_hash_combine(key, static_cast<uint64_t>(m_shader_type));
+        key          = rhi_hash_combine(key, static_cast<uint64_t>(Debugging::IsShaderOptimizationEnabled()));
+
+        return key;
+    }
+
+    void RHI_Shader::SwapResource(RHI_Shader* shader)
+    {
+        // takes over the module, the reflection and the sources of a shader that was compiled from the same file
+        // with the same defines - the other shader releases the old module (through the deletion queue) when it's destroyed
+        SP_ASSERT(shader != nullptr);
+        SP_ASSERT(shader->m_shader_type == m_shader_type && shader->m_vertex_type == m_vertex_type);
+
+        swap(m_preprocessed_source, shader->m_preprocessed_source);
+        swap(m_names,               shader->m_names);
+        swap(m_file_paths,          shader->m_file_paths);
+        swap(m_sources,             shader->m_sources);
+        swap(m_file_paths_multiple, shader->m_file_paths_multiple);
+        swap(m_file_versions,       shader->m_file_versions);
+        swap(m_descriptors,         shader->m_descriptors);
+        swap(m_input_layout,        shader->m_input_layout);
+        swap(m_hash,                shader->m_hash);
+        swap(m_rhi_resource,        shader->m_rhi_resource);
     }
 
     void RHI_Shader::SetSource(const uint32_t index, const string& source)
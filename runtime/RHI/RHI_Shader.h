@@ -51,6 +51,8 @@ namespace spartan
         void Compile(const RHI_Shader_Type type, const std::string& file_path, bool async, const RHI_Vertex_Type vertex_type = RHI_Vertex_Type::Max);
         RHI_ShaderCompilationState GetCompilationState() const { return m_compilation_state; }
         bool IsCompiled() const                                { return m_compilation_state == RHI_ShaderCompilationState::Succeeded; }
+        bool IsStale() const; // true if any file in the include closure has changed since the last load
+        void SwapResource(RHI_Shader* shader);
 
         // source
         void LoadFromDrive(const std::string& file_path);
@@ -69,6 +71,7 @@ namespace spartan
         const std::shared_ptr<RHI_InputLayout>& GetInputLayout() const { return m_input_layout; } // only valid for a vertex shader
         const auto& GetFilePath()                                const { return m_file_path; }
         RHI_Shader_Type GetShaderStage()                         const { return m_shader_type; }
+        RHI_Vertex_Type GetVertexType()                          const { return m_vertex_type; }
         uint64_t GetHash()                                       const { return m_hash; }
         const char* GetEntryPoint()                              const;
         const char* GetTargetProfile()                           const;
@@ -76,6 +79,7 @@ namespace spartan
 
     private:
         void PreprocessIncludeDirectives(const std::string& file_path);
+        uint64_t GetCacheKey() const;
         void* RHI_Compile();
         void Reflect(const RHI_Shader_Type shader_type, const uint32_t* ptr, uint32_t size);
 
@@ -85,6 +89,7 @@ namespace spartan
         std::vector<std::string> m_file_paths;          // The file paths of the files from the include directives in the shader
         std::vector<std::string> m_sources;             // The source of the files from the include directives in the shader
         std::vector<std::string> m_file_paths_multiple; // The file paths of include directives which are defined multiple times in the shader
+        std::vector<uint32_t> m_file_versions;          // The versions of the files from the include directives, as they were when loaded
         std::unordered_map<std::string, std::string> m_defines;
         std::vector<RHI_Descriptor> m_descriptors;
         std::shared_ptr<RHI_InputLayout> m_input_layout;
@@ -92,6 +97,7 @@ namespace spartan
         RHI_Shader_Type m_shader_type                              = RHI_Shader_Type::Max;
         RHI_Vertex_Type m_vertex_type                               = RHI_Vertex_Type::Max;
         uint64_t m_hash                                             = 0;
+        bool m_is_from_cache                                        = false;
 
         void* m_rhi_resource = nullptr;
     };
@@ -0,0 +1,206 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//= INCLUDES ======================
+#include "pch.h"
+#include "RHI_ShaderCache.h"
+#include "../IO/FileStream.h"
+#include "../IO/DiskCache.h"
+#include "../Resource/ResourceCache.h"
+#include "../Core/Debugging.h"
+//=================================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    namespace
+    {
+        // bump when the entry layout, the compiler arguments or the reflection changes
+        const uint32_t cache_version  = 1;
+        const uint32_t cache_magic    = 0x43535053; // "SPSC"
+        const uint32_t engine_version = (sp_info::version_major << 16) | (sp_info::version_minor << 8) | sp_info::version_revision;
+        DiskCache cache(".bin", 256);
+
+        // batch stats
+        atomic<uint32_t> compilations_in_flight = 0;
+        atomic<uint32_t> batch_hits             = 0;
+        atomic<uint32_t> batch_misses           = 0;
+        Stopwatch batch_timer;
+        mutex mutex_batch;
+    }
+
+    void RHI_ShaderCache::Initialize()
+    {
+        cache.Initialize(ResourceCache::GetResourceDirectory(ResourceDirectory::ShaderCache));
+    }
+
+    bool RHI_ShaderCache::Load(const uint64_t key, vector<byte>& binary, vector<RHI_Descriptor>& descriptors)
+    {
+        if (!Debugging::IsShaderCacheEnabled() || !cache.IsInitialized())
+            return false;
+
+        // the cache only locks for the file system operations, not the reads, so that shaders load in parallel
+        // a file that is evicted or replaced while it's read is either still readable or fails validation
+        if (!cache.Exists(key))
+            return false;
+
+        bool valid = false;
+        {
+            FileStream file(cache.GetFilePath(key), FileStream_Read);
+            if (!file.IsOpen())
+                return false;
+
+            // header
+            uint32_t magic          = file.ReadAs<uint32_t>();
+            uint32_t version        = file.ReadAs<uint32_t>();
+            uint32_t version_engine = file.ReadAs<uint32_t>();
+            uint64_t key_stored     = file.ReadAs<uint64_t>();
+            if (magic == cache_magic && version == cache_version && version_engine == engine_version && key_stored == key)
+            {
+                // binary
+                file.Read(&binary);
+
+                // descriptors
+                uint32_t descriptor_count = file.ReadAs<uint32_t>();
+                descriptors.clear();
+                descriptors.reserve(descriptor_count);
+                for (uint32_t i = 0; i < descriptor_count; i++)
+                {
+                    RHI_Descriptor& descriptor = descriptors.emplace_back();
+                    file.Read(&descriptor.name);
+                    descriptor.type   = static_cast<RHI_Descriptor_Type>(file.ReadAs<uint32_t>());
+                    descriptor.layout = static_cast<RHI_Image_Layout>(file.ReadAs<uint32_t>());
+                    file.Read(&descriptor.slot);
+                    file.Read(&descriptor.stage);
+                    file.Read(&descriptor.struct_size);
+                    file.Read(&descriptor.as_array);
+                    file.Read(&descriptor.array_length);
+                }
+
+                // the trailing magic guards against truncated files
+                uint32_t magic_end = 0;
+                file.Read(&magic_end);
+                valid = magic_end == cache_magic && !binary.empty();
+            }
+        }
+
+        if (!valid)
+        {
+            binary.clear();
+            descriptors.clear();
+            cache.Remove(key);
+            return false;
+        }
+
+        cache.Touch(key);
+
+        return true;
+    }
+
+    void RHI_ShaderCache::Save(const uint64_t key, const void* binary, const uint64_t binary_size, const vector<RHI_Descriptor>& descriptors)
+    {
+        if (!Debugging::IsShaderCacheEnabled() || !cache.IsInitialized() || !binary || binary_size == 0)
+            return;
+
+        const string file_path_temp = cache.GetFilePathTemp(key);
+
+        // write to a temporary file so that a crash or a concurrent reader never sees a partial entry
+        {
+            FileStream file(file_path_temp, FileStream_Write);
+            if (!file.IsOpen())
+                return;
+
+            file.Write(cache_magic);
+            file.Write(cache_version);
+            file.Write(engine_version);
+            file.Write(key);
+
+            vector<byte> bytes(static_cast<const byte*>(binary), static_cast<const byte*>(binary) + binary_size);
+            file.Write(bytes);
+
+            file.Write(static_cast<uint32_t>(descriptors.size()));
+            for (const RHI_Descriptor& descriptor : descriptors)
+            {
+                file.Write(descriptor.name);
+                file.Write(static_cast<uint32_t>(descriptor.type));
+                file.Write(static_cast<uint32_t>(descriptor.layout));
+                file.Write(descriptor.slot);
+                file.Write(descriptor.stage);
+                file.Write(descriptor.struct_size);
+                file.Write(descriptor.as_array);
+                file.Write(descriptor.array_length);
+            }
+
+            file.Write(cache_magic);
+        }
+
+        cache.Commit(key, file_path_temp);
+    }
+
+    void RHI_ShaderCache::OnCompilationStart()
+    {
+        lock_guard<mutex> lock(mutex_batch);
+
+        if (compilations_in_flight++ == 0)
+        {
+            batch_hits   = 0;
+            batch_misses = 0;
+            batch_timer.Start();
+        }
+    }
+
+    void RHI_ShaderCache::OnCompilationEnd(const bool cache_hit)
+    {
+        lock_guard<mutex> lock(mutex_batch);
+
+        (cache_hit ? batch_hits : batch_misses)++;
+
+        if (--compilations_in_flight == 0)
+        {
+            SP_LOG_INFO("%d shaders took %.1f ms (%d from cache, %d compiled), cache size is %llu/%llu MB",
+                batch_hits + batch_misses,
+                batch_timer.GetElapsedTimeMs(),
+                batch_hits.load(),
+                batch_misses.load(),
+                static_cast<unsigned long long>(GetSizeMb()),
+                static_cast<unsigned long long>(GetBudgetMb())
+            );
+        }
+    }
+
+    void RHI_ShaderCache::SetBudgetMb(const uint64_t budget_mb)
+    {
+        cache.SetBudgetMb(budget_mb);
+    }
+
+    uint64_t RHI_ShaderCache::GetBudgetMb()
+    {
+        return cache.GetBudgetMb();
+    }
+
+    uint64_t RHI_ShaderCache::GetSizeMb()
+    {
+        return cache.GetSizeMb();
+    }
+}
@@ -0,0 +1,53 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+//= INCLUDES ===============
+#include <vector>
+#include "RHI_Descriptor.h"
+//==========================
+
+namespace spartan
+{
+    // on-disk cache of compiled shader binaries and their reflected descriptors, keyed by a
+    // hash of the preprocessed source, the defines, the shader stage and the compiler options
+    class RHI_ShaderCache
+    {
+    public:
+        static void Initialize();
+
+        // returns true and fills the outputs if a valid entry exists for the key
+        static bool Load(const uint64_t key, std::vector<std::byte>& binary, std::vector<RHI_Descriptor>& descriptors);
+
+        // writes an entry atomically (temporary file + rename), evicting the oldest entries when over budget
+        static void Save(const uint64_t key, const void* binary, const uint64_t binary_size, const std::vector<RHI_Descriptor>& descriptors);
+
+        // compilation batch tracking, a batch ends when no shader is being compiled, its stats are logged
+        static void OnCompilationStart();
+        static void OnCompilationEnd(const bool cache_hit);
+
+        // budget
+        static void SetBudgetMb(const uint64_t budget_mb);
+        static uint64_t GetBudgetMb();
+        static uint64_t GetSizeMb();
+    };
+}
@@ -24,9 +24,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "RHI_Texture.h"
 #include "ThreadPool.h"
 #include "RHI_CommandList.h"
+#include "RHI_BlockCompressor.h"
 #include "../IO/FileStream.h"
 #include "../Resource/Import/ImageImporter.h"
+#include "../Resource/DerivedDataCache.h"
 #include "../Core/ProgressTracker.h"
+#include "../Rendering/TextureStreaming.h"
 SP_WARNINGS_OFF
 #include "compressonator.h"
 SP_WARNINGS_ON
@@ -40,7 +43,6 @@ namespace spartan
 {
     namespace compressonator
     {
-        RHI_Format destination_format = RHI_Format::BC3_Unorm;
         atomic<bool> registered = false;
 
         CMP_FORMAT to_cmp_format(const RHI_Format format)
@@ -53,9 +55,15 @@ namespace spartan
             if (format == RHI_Format::ASTC)
                 return CMP_FORMAT::CMP_FORMAT_ASTC; // that's a build option in the compressonator
 
+            if (format == RHI_Format::BC1_Unorm)
+                return CMP_FORMAT::CMP_FORMAT_BC1;
+
             if (format == RHI_Format::BC3_Unorm)
                 return CMP_FORMAT::CMP_FORMAT_BC3;
 
+            if (format == RHI_Format::BC5_Unorm)
+                return CMP_FORMAT::CMP_FORMAT_BC5;
+
             if (format == RHI_Format::BC7_Unorm)
                 return CMP_FORMAT::CMP_FORMAT_BC7;
 
@@ -99,77 +107,540 @@ namespace spartan
             // update texture with compressed data
             texture->GetMip(0, mip_index).bytes = destination_data;
         }
+    }
 
-        void compress(RHI_Texture* texture)
+    namespace compression
+    {
+        atomic<RHI_Texture_Compression> mode = RHI_Texture_Compression::Fast;
+
+        RHI_Format select_format(RHI_Texture* texture, const RHI_Texture_Compression mode)
+        {
+            // tangent space normals only need x and y, the shaders reconstruct z
+            if (texture->GetFlags() & RHI_Texture_NormalMap)
+                return RHI_Format::BC5_Unorm;
+
+            if (mode == RHI_Texture_Compression::Quality)
+                return RHI_Format::BC7_Unorm;
+
+            // opaque textures take half the memory of bc3 (this also catches color textures without the transparent flag)
+            return RHI_BlockCompressor::IsOpaque(texture->GetMip(0, 0).bytes) ? RHI_Format::BC1_Unorm : RHI_Format::BC3_Unorm;
+        }
+
+        // block formats store 8 bits per channel, so 16-bit and float sources are quantized before they are encoded
+        void quantize_to_rgba8(RHI_Texture* texture)
+        {
+            for (uint32_t mip_index = 0; mip_index < texture->GetMipCount(); mip_index++)
+            {
+                RHI_Texture_Mip& mip = texture->GetMip(0, mip_index);
+
+                vector<byte> destination;
+                RHI_Texture::QuantizeToRgba8(mip.bytes, texture->GetFormat(), max(1u, texture->GetWidth() >> mip_index), max(1u, texture->GetHeight() >> mip_index), destination);
+                mip.bytes = move(destination);
+            }
+
+            texture->SetFormat(RHI_Format::R8G8B8A8_Unorm);
+            texture->SetBitsPerChannel(8);
+        }
+
+        void compress(RHI_Texture* texture, const RHI_Texture_Compression mode)
         {
             SP_ASSERT(texture != nullptr);
 
+            if (texture->GetFormat() == RHI_Format::R16G16B16A16_Unorm || texture->GetFormat() == RHI_Format::R32G32B32A32_Float)
+            {
+                quantize_to_rgba8(texture);
+            }
+
+            const RHI_Format format = select_format(texture, mode);
             for (uint32_t mip_index = 0; mip_index < texture->GetMipCount(); mip_index++)
             {
-                compress(texture, mip_index, destination_format);
+                if (mode == RHI_Texture_Compression::Fast)
+                {
+                    RHI_Texture_Mip& mip = texture->GetMip(0, mip_index);
+
+                    vector<byte> destination;
+                    RHI_BlockCompressor::Compress(mip.bytes, max(1u, texture->GetWidth() >> mip_index), max(1u, texture->GetHeight() >> mip_index), format, destination);
+                    mip.bytes = move(destination);
+                }
+                else
+                {
+                    compressonator::compress(texture, mip_index, format);
+                }
             }
 
-            texture->SetFormat(destination_format);
+            texture->SetFormat(format);
         }
     }
 
     namespace mips
     {
-        void downsample_bilinear(const vector<byte>& input, vector<byte>& output, uint32_t width, uint32_t height)
+        atomic<RHI_Texture_MipFilter> filter = RHI_Texture_MipFilter::Box;
+
+        // kaiser parameters match the usual mip generation defaults (width 3, alpha 4), lanczos uses 3 lobes
+        constexpr float kaiser_width  = 3.0f;
+        constexpr float kaiser_alpha  = 4.0f;
+        constexpr float lanczos_width = 3.0f;
+
+        // separable resampling weights for one axis, every destination texel uses the same number of taps
+        struct Axis
         {
-            constexpr uint32_t channels = 4; // RGBA32 - engine standard
-  
-            // calculate new dimensions (halving both width and height)
-            uint32_t new_width  = width  >> 1;
-            uint32_t new_height = height >> 1;
-            
-            // ensure minimum size
-            if (new_width < 1) new_width = 1;
-            if (new_height < 1) new_height = 1;
-            
-             // perform bilinear downsampling
-            for (uint32_t y = 0; y < new_height; y++)
+            uint32_t tap_count = 0;
+            vector<uint32_t> indices; // source texel per destination texel and tap
+            vector<float> weights;    // normalized weight per destination texel and tap
+        };
+
+        float sinc(const float x)
+        {
+            if (fabs(x) < 1e-5f)
+                return 1.0f;
+
+            const float pi_x = math::helper::PI * x;
+            return sin(pi_x) / pi_x;
+        }
+
+        float bessel_i0(const float x)
+        {
+            // power series, converges within a few terms for the arguments the kaiser window uses
+            float sum  = 1.0f;
+            float term = 1.0f;
+            for (uint32_t k = 1; k < 32; k++)
+            {
+                const float factor = x / (2.0f * static_cast<float>(k));
+                term *= factor * factor;
+                sum  += term;
+
+                if (term < sum * 1e-8f)
+                    break;
+            }
+
+            return sum;
+        }
+
+        float get_width(const RHI_Texture_MipFilter filter)
+        {
+            return filter == RHI_Texture_MipFilter::Kaiser ? kaiser_width : lanczos_width;
+        }
+
+        float evaluate(const RHI_Texture_MipFilter filter, const float x)
+        {
+            const float width = get_width(filter);
+            if (fabs(x) >= width)
+                return 0.0f;
+
+            if (filter == RHI_Texture_MipFilter::Kaiser)
+            {
+                const float t = x / width;
+                return sinc(x) * bessel_i0(kaiser_alpha * sqrt(1.0f - t * t)) / bessel_i0(kaiser_alpha);
+            }
+
+            return sinc(x) * sinc(x / lanczos_width);
+        }
+
+        Axis compute_axis(const uint32_t size_source, const uint32_t size_destination, const RHI_Texture_MipFilter filter)
+        {
+            Axis axis;
+            const float scale = static_cast<float>(size_source) / static_cast<float>(size_destination);
+
+            if (filter == RHI_Texture_MipFilter::Box)
             {
-                for (uint32_t x = 0; x < new_width; x++)
+                // each destination texel covers exactly scale source texels, that's 2 taps for even sizes and 3 for odd ones
+                axis.tap_count = static_cast<uint32_t>(ceil(scale));
+                if (static_cast<float>(axis.tap_count) != scale)
                 {
-                    // calculate base indices for this 2x2 block
-                    uint32_t src_idx              = (y * 2 * width + x * 2) * channels;
-                    uint32_t src_idx_right        = src_idx + channels;                      // right pixel
-                    uint32_t src_idx_bottom       = src_idx + (width * channels);            // bottom pixel
-                    uint32_t src_idx_bottom_right = src_idx + (width * channels) + channels; // bottom-right pixel
-                    uint32_t dst_idx              = (y * new_width + x) * channels;
-
-                    // process all 4 channels (RGBA)
-                    for (uint32_t c = 0; c < channels; c++)
+                    axis.tap_count++;
+                }
+            }
+            else
+            {
+                // the kernel is stretched by the scale so that it also acts as the low pass filter
+                axis.tap_count = static_cast<uint32_t>(ceil(get_width(filter) * scale)) * 2 + 1;
+            }
+
+            axis.indices.resize(size_destination * axis.tap_count);
+            axis.weights.resize(size_destination * axis.tap_count);
+
+            for (uint32_t i = 0; i < size_destination; i++)
+            {
+                uint32_t* indices = &axis.indices[i * axis.tap_count];
+                float* weights    = &axis.weights[i * axis.tap_count];
+                float weight_sum  = 0.0f;
+
+                if (filter == RHI_Texture_MipFilter::Box)
+                {
+                    // weigh each source texel by how much of it the destination texel's footprint covers
+                    const float begin    = static_cast<float>(i) * scale;
+                    const float end      = begin + scale;
+                    const uint32_t first = static_cast<uint32_t>(floor(begin));
+                    for (uint32_t tap = 0; tap < axis.tap_count; tap++)
                     {
-                        uint32_t sum = to_integer<uint32_t>(input[src_idx + c]);
-                        uint32_t count = 1;
-            
-                        // right pixel
-                        if (x * 2 + 1 < width)
+                        const uint32_t index = first + tap;
+                        const float coverage = max(0.0f, min(end, static_cast<float>(index + 1)) - max(begin, static_cast<float>(index)));
+
+                        indices[tap]  = min(index, size_source - 1);
+                        weights[tap]  = coverage;
+                        weight_sum   += coverage;
+                    }
+                }
+                else
+                {
+                    // centers are at half texel offsets, texels outside of the image are clamped to the edge
+                    const float center  = (static_cast<float>(i) + 0.5f) * scale;
+                    const int32_t first = static_cast<int32_t>(ceil(center - get_width(filter) * scale - 0.5f));
+                    for (uint32_t tap = 0; tap < axis.tap_count; tap++)
+                    {
+                        const int32_t index = first + static_cast<int32_t>(tap);
+                        const float weight  = evaluate(filter, (static_cast<float>(index) + 0.5f - center) / scale);
+
+                        indices[tap]  = static_cast<uint32_t>(clamp(index, 0, static_cast<int32_t>(size_source) - 1));
+                        weights[tap]  = weight;
+                        weight_sum   += weight;
+                    }
+                }
+
+                for (uint32_t tap = 0; tap < axis.tap_count; tap++)
+                {
+                    weights[tap] /= weight_sum;
+                }
+            }
+
+            return axis;
+        }
+
+        const array<float, 256>& get_srgb_to_linear()
+        {
+            static const array<float, 256> table = []()
+            {
+                array<float, 256> values;
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    const float c = static_cast<float>(i) / 255.0f;
+                    values[i]     = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return values;
+            }();
+
+            return table;
+        }
+
+        // indexed by a 16-bit quantized linear value, which keeps the darks (where srgb spends most of its codes) exact
+        const vector<uint8_t>& get_linear_to_srgb()
+        {
+            static const vector<uint8_t> table = []()
+            {
+                vector<uint8_t> values(65536);
+                for (uint32_t i = 0; i < 65536; i++)
+                {
+                    const float c = static_cast<float>(i) / 65535.0f;
+                    const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * pow(c, 1.0f / 2.4f) - 0.055f;
+                    values[i]     = static_cast<uint8_t>(clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+                }
+                return values;
+            }();
+
+            return table;
+        }
+
+        // rgba as four floats, the color channels are linear and alpha is never gamma encoded
+        #if defined(__AVX2__)
+        struct Pixel
+        {
+            __m128 v;
+        };
+
+        Pixel pixel_zero()
+        {
+            return { _mm_setzero_ps() };
+        }
+
+        Pixel pixel_mad(const Pixel& pixel, const float weight, const Pixel& sum)
+        {
+            return { _mm_add_ps(_mm_mul_ps(pixel.v, _mm_set1_ps(weight)), sum.v) };
+        }
+
+        Pixel pixel_decode(const byte* source, const bool is_srgb, const array<float, 256>& srgb_to_linear)
+        {
+            if (is_srgb)
+            {
+                const uint8_t* rgba = reinterpret_cast<const uint8_t*>(source);
+                return { _mm_setr_ps(srgb_to_linear[rgba[0]], srgb_to_linear[rgba[1]], srgb_to_linear[rgba[2]], static_cast<float>(rgba[3]) * (1.0f / 255.0f)) };
+            }
+
+            int32_t packed;
+            memcpy(&packed, source, sizeof(packed));
+            const __m128i integers = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+            return { _mm_mul_ps(_mm_cvtepi32_ps(integers), _mm_set1_ps(1.0f / 255.0f)) };
+        }
+
+        void pixel_encode(const Pixel& pixel, byte* destination, const bool is_srgb, const vector<uint8_t>& linear_to_srgb)
+        {
+            // negative lobes of the kaiser and lanczos kernels can overshoot
+            const __m128 clamped = _mm_min_ps(_mm_max_ps(pixel.v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            const __m128 half    = _mm_set1_ps(0.5f);
+
+            // round by adding a half and truncating, like the scalar path, so that both produce identical mips
+
+            if (is_srgb)
+            {
+                alignas(16) int32_t quantized[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(quantized), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f)), half)));
+                destination[0] = static_cast<byte>(linear_to_srgb[quantized[0]]);
+                destination[1] = static_cast<byte>(linear_to_srgb[quantized[1]]);
+                destination[2] = static_cast<byte>(linear_to_srgb[quantized[2]]);
+                destination[3] = static_cast<byte>(quantized[3]);
+                return;
+            }
+
+            __m128i integers = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), half));
+            integers         = _mm_packus_epi32(integers, integers);
+            integers         = _mm_packus_epi16(integers, integers);
+            const int32_t packed = _mm_cvtsi128_si32(integers);
+            memcpy(destination, &packed, sizeof(packed));
+        }
+
+        // float texels are filtered as they are stored, only the negative overshoot of the kernels is removed
+        Pixel pixel_decode_float(const byte* source)
+        {
+            return { _mm_loadu_ps(reinterpret_cast<const float*>(source)) };
+        }
+
+        void pixel_encode_float(const Pixel& pixel, byte* destination)
+        {
+            _mm_storeu_ps(reinterpret_cast<float*>(destination), _mm_max_ps(pixel.v, _mm_setzero_ps()));
+        }
+        #else
+        struct Pixel
+        {
+            float v[4] = {};
+        };
+
+        Pixel pixel_zero()
+        {
+            return Pixel();
+        }
+
+        Pixel pixel_mad(const Pixel& pixel, const float weight, const Pixel& sum)
+        {
+            Pixel result;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                result.v[c] = pixel.v[c] * weight + sum.v[c];
+            }
+            return result;
+        }
+
+        Pixel pixel_decode(const byte* source, const bool is_srgb, const array<float, 256>& srgb_to_linear)
+        {
+            const uint8_t* rgba = reinterpret_cast<const uint8_t*>(source);
+
+            Pixel pixel;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                pixel.v[c] = (is_srgb && c < 3) ? srgb_to_linear[rgba[c]] : static_cast<float>(rgba[c]) * (1.0f / 255.0f);
+            }
+            return pixel;
+        }
+
+        void pixel_encode(const Pixel& pixel, byte* destination, const bool is_srgb, const vector<uint8_t>& linear_to_srgb)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                // negative lobes of the kaiser and lanczos kernels can overshoot
+                const float value = clamp(pixel.v[c], 0.0f, 1.0f);
+
+                if (is_srgb && c < 3)
+                {
+                    destination[c] = static_cast<byte>(linear_to_srgb[static_cast<uint32_t>(value * 65535.0f + 0.5f)]);
+                }
+                else
+                {
+                    destination[c] = static_cast<byte>(static_cast<uint32_t>(value * 255.0f + 0.5f));
+                }
+            }
+        }
+
+        // float texels are filtered as they are stored, only the negative overshoot of the kernels is removed
+        Pixel pixel_decode_float(const byte* source)
+        {
+            Pixel pixel;
+            memcpy(pixel.v, source, sizeof(pixel.v));
+            return pixel;
+        }
+
+        void pixel_encode_float(const Pixel& pixel, byte* destination)
+        {
+            float values[4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                values[c] = max(pixel.v[c], 0.0f);
+            }
+            memcpy(destination, values, sizeof(values));
+        }
+        #endif
+
+        // 16-bit texels go through floats, the float path does the loads and stores so that it works with either pixel layout
+        const vector<float>& get_srgb_to_linear_16()
+        {
+            static const vector<float> table = []()
+            {
+                vector<float> values(65536);
+                for (uint32_t i = 0; i < 65536; i++)
+                {
+                    const float c = static_cast<float>(i) / 65535.0f;
+                    values[i]     = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return values;
+            }();
+
+            return table;
+        }
+
+        Pixel pixel_decode_unorm16(const byte* source, const bool is_srgb, const vector<float>& srgb_to_linear)
+        {
+            uint16_t rgba[4];
+            memcpy(rgba, source, sizeof(rgba));
+
+            float values[4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                values[c] = (is_srgb && c < 3) ? srgb_to_linear[rgba[c]] : static_cast<float>(rgba[c]) * (1.0f / 65535.0f);
+            }
+
+            return pixel_decode_float(reinterpret_cast<const byte*>(values));
+        }
+
+        void pixel_encode_unorm16(const Pixel& pixel, byte* destination, const bool is_srgb)
+        {
+            float values[4];
+            pixel_encode_float(pixel, reinterpret_cast<byte*>(values));
+
+            uint16_t rgba[4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                // a table indexed by the linear value would lose the darks at 16 bits, so the curve is evaluated
+                float value = min(values[c], 1.0f);
+                if (is_srgb && c < 3)
+                {
+                    value = value <= 0.0031308f ? value * 12.92f : 1.055f * pow(value, 1.0f / 2.4f) - 0.055f;
+                }
+                rgba[c] = static_cast<uint16_t>(value * 65535.0f + 0.5f);
+            }
+
+            memcpy(destination, rgba, sizeof(rgba));
+        }
+
+        // rgba8, rgba16 (16-bit color) or rgba32f (float and greyscale 16-bit sources)
+        void downsample(const vector<byte>& input, vector<byte>& output, const uint32_t width, const uint32_t height, const bool is_srgb, const RHI_Format format, const RHI_Texture_MipFilter filter)
+        {
+            constexpr uint32_t block_rows  = 16; // destination rows filtered together, bounds the scratch memory
+            const bool is_float            = format == RHI_Format::R32G32B32A32_Float;
+            const bool is_unorm16          = format == RHI_Format::R16G16B16A16_Unorm;
+            const uint32_t bytes_per_pixel = is_float ? 16 : (is_unorm16 ? 8 : 4);
+            const uint32_t new_width       = max(1u, width >> 1);
+            const uint32_t new_height      = max(1u, height >> 1);
+            SP_ASSERT(input.size() >= static_cast<size_t>(width) * height * bytes_per_pixel);
+            SP_ASSERT(output.size() >= static_cast<size_t>(new_width) * new_height * bytes_per_pixel);
+
+            const Axis axis_x                       = compute_axis(width, new_width, filter);
+            const Axis axis_y                       = compute_axis(height, new_height, filter);
+            const array<float, 256>& srgb_to_linear = get_srgb_to_linear();
+            const vector<uint8_t>& linear_to_srgb   = get_linear_to_srgb();
+            const vector<float>* srgb_to_linear_16  = is_unorm16 ? &get_srgb_to_linear_16() : nullptr; // only built when it's needed
+
+            // filtering is separable, so each block filters the source rows it needs horizontally and then blends them vertically
+            auto downsample_rows = [&](uint32_t row_start, uint32_t row_end)
+            {
+                vector<Pixel> row_decoded(width);
+                vector<Pixel> row_sum(new_width);
+                vector<Pixel> rows_filtered;
+
+                for (uint32_t block_start = row_start; block_start < row_end; block_start += block_rows)
+                {
+                    const uint32_t block_end = min(block_start + block_rows, row_end);
+
+                    // find the source rows this block reads from
+                    uint32_t source_first = height - 1;
+                    uint32_t source_last  = 0;
+                    for (uint32_t i = block_start * axis_y.tap_count; i < block_end * axis_y.tap_count; i++)
+                    {
+                        source_first = min(source_first, axis_y.indices[i]);
+                        source_last  = max(source_last, axis_y.indices[i]);
+                    }
+                    rows_filtered.resize(static_cast<size_t>(source_last - source_first + 1) * new_width);
+
+                    // horizontal
+                    for (uint32_t y = source_first; y <= source_last; y++)
+                    {
+                        const byte* source = &input[static_cast<size_t>(y) * width * bytes_per_pixel];
+                        for (uint32_t x = 0; x < width; x++)
                         {
-                            sum += to_integer<uint32_t>(input[src_idx_right + c]);
-                            count++;
+                            const byte* texel = source + x * bytes_per_pixel;
+                            row_decoded[x]    = is_float   ? pixel_decode_float(texel) :
+                                                is_unorm16 ? pixel_decode_unorm16(texel, is_srgb, *srgb_to_linear_16) :
+                                                             pixel_decode(texel, is_srgb, srgb_to_linear);
                         }
-            
-                        // bottom pixel
-                        if (y * 2 + 1 < height)
+
+                        Pixel* filtered = &rows_filtered[static_cast<size_t>(y - source_first) * new_width];
+                        for (uint32_t x = 0; x < new_width; x++)
                         {
-                            sum += to_integer<uint32_t>(input[src_idx_bottom + c]);
-                            count++;
+                            const uint32_t* indices = &axis_x.indices[x * axis_x.tap_count];
+                            const float* weights    = &axis_x.weights[x * axis_x.tap_count];
+
+                            Pixel sum = pixel_zero();
+                            for (uint32_t tap = 0; tap < axis_x.tap_count; tap++)
+                            {
+                                sum = pixel_mad(row_decoded[indices[tap]], weights[tap], sum);
+                            }
+                            filtered[x] = sum;
                         }
-            
-                        // bottom-right pixel
-                        if ((x * 2 + 1 < width) && (y * 2 + 1 < height))
+                    }
+
+                    // vertical
+                    for (uint32_t y = block_start; y < block_end; y++)
+                    {
+                        const uint32_t* indices = &axis_y.indices[y * axis_y.tap_count];
+                        const float* weights    = &axis_y.weights[y * axis_y.tap_count];
+
+                        fill(row_sum.begin(), row_sum.end(), pixel_zero());
+                        for (uint32_t tap = 0; tap < axis_y.tap_count; tap++)
                         {
-                            sum += to_integer<uint32_t>(input[src_idx_bottom_right + c]);
-                            count++;
+                            if (weights[tap] == 0.0f)
+                                continue;
+
+                            const Pixel* filtered = &rows_filtered[static_cast<size_t>(indices[tap] - source_first) * new_width];
+                            for (uint32_t x = 0; x < new_width; x++)
+                            {
+                                row_sum[x] = pixel_mad(filtered[x], weights[tap], row_sum[x]);
+                            }
+                        }
+
+                        byte* destination = &output[static_cast<size_t>(y) * new_width * bytes_per_pixel];
+                        for (uint32_t x = 0; x < new_width; x++)
+                        {
+                            if (is_float)
+                            {
+                                pixel_encode_float(row_sum[x], destination + x * bytes_per_pixel);
+                            }
+                            else if (is_unorm16)
+                            {
+                                pixel_encode_unorm16(row_sum[x], destination + x * bytes_per_pixel, is_srgb);
+                            }
+                            else
+                            {
+                                pixel_encode(row_sum[x], destination + x * bytes_per_pixel, is_srgb, linear_to_srgb);
+                            }
                         }
-            
-                        // assign the averaged result to the output
-                        output[dst_idx + c] = byte(sum / count);
                     }
                 }
+            };
+
+            // small mips aren't worth waking up threads for
+            if (new_height > block_rows * 2)
+            {
+                ThreadPool::ParallelLoop(downsample_rows, new_height);
+            }
+            else
+            {
+                downsample_rows(0, new_height);
             }
         }
 
@@ -189,6 +660,261 @@ namespace spartan
         }
     }
 
+    namespace container
+    {
+        // engine texture files are laid out as a header, a mip table and the mip data
+        // the table and the data go from the smallest mip to the largest, so the mip tail
+        // sits at the front of the file and every other mip is a single positional read
+        constexpr uint32_t magic     = 0x58545053; // "SPTX"
+        constexpr uint32_t version   = 2;          // version 1 was a headerless sequential layout
+        constexpr uint64_t alignment = 16;
+
+        struct Header
+        {
+            uint32_t width            = 0;
+            uint32_t height           = 0;
+            uint32_t depth            = 0;
+            uint32_t mip_count        = 0;
+            uint32_t channel_count    = 0;
+            uint32_t bits_per_channel = 0;
+            uint32_t type             = 0;
+            uint32_t format           = 0;
+            uint32_t flags            = 0;
+            uint64_t object_id        = 0;
+            string resource_path;
+        };
+
+        struct Entry
+        {
+            uint64_t offset = 0; // relative to the start of the mip data
+            uint64_t size   = 0;
+        };
+
+        uint32_t entry_index(const Header& header, const uint32_t array_index, const uint32_t mip_index)
+        {
+            return (header.mip_count - 1 - mip_index) * header.depth + array_index;
+        }
+
+        bool read_header(FileStream* file, Header& header, vector<Entry>& table, uint64_t& data_start)
+        {
+            file->Seek(0);
+            if (file->ReadAs<uint32_t>() != magic)
+                return false;
+
+            if (file->ReadAs<uint32_t>() != version)
+                return false;
+
+            file->Read(&header.width);
+            file->Read(&header.height);
+            file->Read(&header.depth);
+            file->Read(&header.mip_count);
+            file->Read(&header.channel_count);
+            file->Read(&header.bits_per_channel);
+            file->Read(&header.type);
+            file->Read(&header.format);
+            file->Read(&header.flags);
+            file->Read(&header.object_id);
+            file->Read(&header.resource_path);
+
+            // the table is sized by values straight from the file, so check them before allocating, a corrupt file could ask for gigabytes
+            if (header.depth == 0 || header.depth > rhi_max_array_size || header.mip_count == 0 || header.mip_count > rhi_max_mip_count)
+                return false;
+
+            const uint64_t entry_count = static_cast<uint64_t>(header.depth) * header.mip_count;
+            if (entry_count * 2 * sizeof(uint64_t) > file->GetSize() - file->GetPosition())
+                return false;
+
+            table.resize(entry_count);
+            for (Entry& entry : table)
+            {
+                file->Read(&entry.offset);
+                file->Read(&entry.size);
+            }
+
+            file->Align(alignment);
+            data_start = file->GetPosition();
+
+            // validate the table against the file, a truncated file shouldn't turn into out of bounds reads
+            for (const Entry& entry : table)
+            {
+                if (data_start + entry.offset + entry.size > file->GetSize())
+                    return false;
+            }
+
+            return true;
+        }
+
+        void write_header(FileStream* file, const Header& header, const vector<Entry>& table)
+        {
+            file->Write(magic);
+            file->Write(version);
+            file->Write(header.width);
+            file->Write(header.height);
+            file->Write(header.depth);
+            file->Write(header.mip_count);
+            file->Write(header.channel_count);
+            file->Write(header.bits_per_channel);
+            file->Write(header.type);
+            file->Write(header.format);
+            file->Write(header.flags);
+            file->Write(header.object_id);
+            file->Write(header.resource_path);
+
+            for (const Entry& entry : table)
+            {
+                file->Write(entry.offset);
+                file->Write(entry.size);
+            }
+
+            file->Align(alignment);
+        }
+
+        void read_mips(FileStream* file, const Header& header, const vector<Entry>& table, const uint64_t data_start, const uint32_t mip_index_top, vector<RHI_Texture_Slice>& slices)
+        {
+            slices.resize(header.depth);
+            for (uint32_t array_index = 0; array_index < header.depth; array_index++)
+            {
+                slices[array_index].mips.resize(header.mip_count - mip_index_top);
+                for (uint32_t mip_index = mip_index_top; mip_index < header.mip_count; mip_index++)
+                {
+                    const Entry& entry = table[entry_index(header, array_index, mip_index)];
+                    file->Seek(data_start + entry.offset);
+                    span<const byte> bytes = file->ReadSpan(entry.size);
+
+                    slices[array_index].mips[mip_index - mip_index_top].bytes.assign(bytes.begin(), bytes.end());
+                }
+            }
+        }
+
+        bool read_legacy(FileStream* file, Header& header, vector<RHI_Texture_Slice>& slices)
+        {
+            // version 1 has no table, the whole file has to be read to get to the properties at the end
+            file->Seek(0);
+            file->Skip(sizeof(uint64_t)); // byte count
+            file->Read(&header.depth);
+            file->Read(&header.mip_count);
+
+            slices.resize(header.depth);
+            for (RHI_Texture_Slice& slice : slices)
+            {
+                slice.mips.resize(header.mip_count);
+                for (RHI_Texture_Mip& mip : slice.mips)
+                {
+                    file->Read(&mip.bytes);
+                }
+            }
+
+            file->Read(&header.width);
+            file->Read(&header.height);
+            file->Read(&header.channel_count);
+            file->Read(&header.bits_per_channel);
+            file->Read(&header.type);
+            file->Read(&header.format);
+            file->Read(&header.flags);
+            file->Read(&header.object_id);
+            file->Read(&header.resource_path);
+
+            return file->GetPosition() == file->GetSize();
+        }
+
+        void write(FileStream* file, const Header& header, const vector<RHI_Texture_Slice>& slices)
+        {
+            // build the mip table, smallest mip first
+            vector<Entry> table(static_cast<size_t>(header.depth) * header.mip_count);
+            {
+                uint64_t offset = 0;
+                for (uint32_t mip_index = header.mip_count; mip_index-- > 0;)
+                {
+                    for (uint32_t array_index = 0; array_index < header.depth; array_index++)
+                    {
+                        Entry& entry = table[entry_index(header, array_index, mip_index)];
+                        entry.offset = offset;
+                        entry.size   = (array_index < slices.size() && mip_index < slices[array_index].mips.size()) ? slices[array_index].mips[mip_index].bytes.size() : 0;
+                        offset      += (entry.size + alignment - 1) / alignment * alignment;
+                    }
+                }
+            }
+
+            write_header(file, header, table);
+
+            // write mip data, in the same order as the table
+            for (uint32_t mip_index = header.mip_count; mip_index-- > 0;)
+            {
+                for (uint32_t array_index = 0; array_index < header.depth; array_index++)
+                {
+                    const Entry& entry = table[entry_index(header, array_index, mip_index)];
+                    if (entry.size != 0)
+                    {
+                        file->Write(slices[array_index].mips[mip_index].bytes.data(), entry.size);
+                        file->Align(alignment);
+                    }
+                }
+            }
+        }
+
+        bool read(FileStream* file, uint32_t mip_index_top, Header& header, vector<RHI_Texture_Slice>& slices)
+        {
+            vector<Entry> table;
+            uint64_t data_start = 0;
+            if (read_header(file, header, table, data_start))
+            {
+                mip_index_top = min(mip_index_top, header.mip_count != 0 ? header.mip_count - 1 : 0);
+                read_mips(file, header, table, data_start, mip_index_top, slices);
+                return true;
+            }
+
+            if (!read_legacy(file, header, slices))
+                return false;
+
+            // the legacy layout is read in full, so just drop the mips that weren't asked for
+            mip_index_top = min(mip_index_top, header.mip_count != 0 ? header.mip_count - 1 : 0);
+            for (RHI_Texture_Slice& slice : slices)
+            {
+                slice.mips.erase(slice.mips.begin(), slice.mips.begin() + min<size_t>(mip_index_top, slice.mips.size()));
+            }
+
+            return true;
+        }
+    }
+
+    namespace derived_data
+    {
+        // bump when mip generation, thumbnails or compression change their output
+        constexpr uint64_t prepared_version = 4;
+
+        // flags which the image importer deduces from the image
+        constexpr uint32_t import_flags = RHI_Texture_Greyscale | RHI_Texture_Srgb | RHI_Texture_Transparent;
+
+        uint64_t compute_key_decoded(const vector<string>& file_paths, const uint32_t width, const uint32_t height)
+        {
+            uint64_t key = rhi_hash_combine(ImageImporter::version, (static_cast<uint64_t>(width) << 32) | height);
+            for (const string& file_path : file_paths)
+            {
+                uint64_t hash = DerivedDataCache::HashFile(file_path);
+                if (hash == 0)
+                    return 0;
+
+                key = rhi_hash_combine(key, hash);
+            }
+
+            return key;
+        }
+
+        uint64_t compute_key_prepared(const uint64_t key_source, const uint32_t flags, const uint32_t mip_count, const RHI_Texture_MipFilter mip_filter, const RHI_Texture_Compression compression_mode)
+        {
+            if (key_source == 0)
+                return 0;
+
+            uint64_t key = rhi_hash_combine(key_source, prepared_version);
+            key          = rhi_hash_combine(key, flags & (RHI_Texture_Compress | RHI_Texture_Thumbnail | RHI_Texture_Srgb | RHI_Texture_NormalMap));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(compression_mode));
+            key          = rhi_hash_combine(key, mip_count);
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(mip_filter));
+
+            return key;
+        }
+    }
+
     RHI_Texture::RHI_Texture() : IResource(ResourceType::Texture)
     {
 
@@ -236,72 +962,85 @@ namespace spartan
 
     RHI_Texture::~RHI_Texture()
     {
+        TextureStreaming::Unregister(this);
         RHI_DestroyResource();
     }
 
     void RHI_Texture::SaveToFile(const string& file_path)
     {
-        // if a file already exists, get the byte count
-        m_object_size = 0;
+        container::Header header;
+        header.width            = m_width;
+        header.height           = m_height;
+        header.depth            = m_depth;
+        header.mip_count        = m_mip_count;
+        header.channel_count    = m_channel_count;
+        header.bits_per_channel = m_bits_per_channel;
+        header.type             = static_cast<uint32_t>(m_type);
+        header.format           = static_cast<uint32_t>(m_format);
+        header.flags            = m_flags;
+        header.object_id        = GetObjectId();
+        header.resource_path    = GetResourceFilePath();
+
+        // if the existing file has texture data but we don't (or we only have part of the mip chain), carry the file's data over
+        vector<RHI_Texture_Slice> slices_existing;
+        vector<RHI_Texture_Slice>* slices = &m_slices;
+        if ((!HasData() || m_mip_index_top != 0) && FileSystem::Exists(file_path))
         {
-            if (FileSystem::Exists(file_path))
+            auto file = make_unique<FileStream>(file_path, FileStream_Read);
+            container::Header header_existing;
+            if (file->IsOpen() && container::read(file.get(), 0, header_existing, slices_existing) && !slices_existing.empty())
             {
-                auto file = make_unique<FileStream>(file_path, FileStream_Read);
-                if (file->IsOpen())
-                {
-                    file->Read(&m_object_size);
-                }
+                header.width     = header_existing.width;
+                header.height    = header_existing.height;
+                header.depth     = header_existing.depth;
+                header.mip_count = header_existing.mip_count;
+                slices           = &slices_existing;
             }
         }
 
-        bool append = true;
-        auto file = make_unique<FileStream>(file_path, FileStream_Write | FileStream_Append);
+        auto file = make_unique<FileStream>(file_path, FileStream_Write);
         if (!file->IsOpen())
             return;
 
-        // if the existing file has texture data but we don't, don't overwrite them
-        bool dont_overwrite_data = m_object_size != 0 && !HasData();
-        if (dont_overwrite_data)
+        container::write(file.get(), header, *slices);
+
+        if (slices == &m_slices)
         {
-            file->Skip
-            (
-                sizeof(m_object_size) + // byte count
-                sizeof(m_depth)       + // array length
-                sizeof(m_mip_count)   + // mip count
-                m_object_size           // bytes
-            );
+            ClearData();
         }
-        else
-        {
-            ComputeMemoryUsage();
-
-            // write mip info
-            file->Write(m_object_size);
-            file->Write(m_depth);
-            file->Write(m_mip_count);
+    }
 
-            // write mip data
-            for (RHI_Texture_Slice& slice : m_slices)
-            {
-                for (RHI_Texture_Mip& mip : slice.mips)
-                {
-                    file->Write(mip.bytes);
-                }
-            }
+    bool RHI_Texture::LoadMipsFromFile(const string& file_path, const uint32_t mip_index_top)
+    {
+        auto file = make_unique<FileStream>(file_path, FileStream_Read);
+        if (!file->IsOpen())
+            return false;
 
-            ClearData();
+        container::Header header;
+        vector<RHI_Texture_Slice> slices;
+        if (!container::read(file.get(), mip_index_top, header, slices))
+        {
+            SP_LOG_ERROR("Failed to read \"%s\"", file_path.c_str());
+            return false;
         }
 
-        // write properties
-        file->Write(m_width);
-        file->Write(m_height);
-        file->Write(m_channel_count);
-        file->Write(m_bits_per_channel);
-        file->Write(static_cast<uint32_t>(m_type));
-        file->Write(static_cast<uint32_t>(m_format));
-        file->Write(m_flags);
-        file->Write(GetObjectId());
-        file->Write(GetResourceFilePath());
+        const uint32_t mip_index = header.mip_count - static_cast<uint32_t>(slices.empty() ? header.mip_count : slices[0].mips.size());
+        m_mip_count_file         = header.mip_count;
+        m_mip_index_top          = mip_index;
+        m_width                  = max(1u, header.width  >> mip_index);
+        m_height                 = max(1u, header.height >> mip_index);
+        m_depth                  = header.depth;
+        m_mip_count              = header.mip_count - mip_index;
+        m_channel_count          = header.channel_count;
+        m_bits_per_channel       = header.bits_per_channel;
+        m_type                   = static_cast<RHI_Texture_Type>(header.type);
+        m_format                 = static_cast<RHI_Format>(header.format);
+        m_flags                  = header.flags;
+        m_slices                 = move(slices);
+        SetObjectId(header.object_id);
+        SetResourceFilePath(header.resource_path);
+
+        return true;
     }
 
     void RHI_Texture::LoadFromFile(const string& file_path)
@@ -325,35 +1064,12 @@ namespace spartan
         // load from drive
         if (FileSystem::IsEngineTextureFile(file_path))
         {
-            auto file = make_unique<FileStream>(file_path, FileStream_Read);
-            if (file->IsOpen())
-            {
-                // read mip info
-                file->Read(&m_object_size);
-                file->Read(&m_depth);
-                file->Read(&m_mip_count);
-
-                // read mip data
-                m_slices.resize(m_depth);
-                for (RHI_Texture_Slice& slice : m_slices)
-                {
-                    slice.mips.resize(m_mip_count);
-                    for (RHI_Texture_Mip& mip : slice.mips)
-                    {
-                        file->Read(&mip.bytes);
-                    }
-                }
+            const Stopwatch timer;
 
-                // read properties
-                file->Read(&m_width);
-                file->Read(&m_height);
-                file->Read(&m_channel_count);
-                file->Read(&m_bits_per_channel);
-                file->Read(reinterpret_cast<uint32_t*>(&m_type));
-                file->Read(reinterpret_cast<uint32_t*>(&m_format));
-                file->Read(&m_flags);
-                SetObjectId(file->ReadAs<uint64_t>());
-                SetResourceFilePath(file->ReadAs<string>());
+            if (LoadMipsFromFile(file_path, m_mip_index_top))
+            {
+                ComputeMemoryUsage();
+                SP_LOG_INFO("Loading \"%s\" (%.1f MB, %u of %u mips) took %d ms", m_object_name.c_str(), static_cast<float>(m_object_size) / (1024.0f * 1024.0f), m_mip_count, m_mip_count_file, static_cast<int>(timer.GetElapsedTimeMs()));
             }
         }
         else if (FileSystem::IsSupportedImageFile(file_path))
@@ -376,10 +1092,13 @@ namespace spartan
                 }
             }
 
-            // load texture
-            for (uint32_t slice_index = 0; slice_index < static_cast<uint32_t>(file_paths.size()); slice_index++)
+            // decoded images are cached by content, so an unchanged image is only ever decoded once
+            m_derived_data_key = derived_data::compute_key_decoded(file_paths, m_width, m_height);
+            if (!LoadDerivedData(m_derived_data_key))
             {
-                ImageImporter::Load(file_paths[slice_index], slice_index, this);
+                ImageImporter::Load(file_paths, this);
+
+                SaveDerivedData(m_derived_data_key);
             }
 
             // set resource file path so it can be used by the resource cache.
@@ -438,6 +1157,45 @@ namespace spartan
         mip.bytes.resize(size_bytes);
     }
 
+    void RHI_Texture::AddMip(const uint32_t array_index, vector<byte>&& bytes)
+    {
+        while (m_slices.size() <= array_index)
+        {
+            m_slices.emplace_back();
+        }
+
+        RHI_Texture_Slice& slice = m_slices[array_index];
+        const uint32_t mip_index = static_cast<uint32_t>(slice.mips.size());
+        SP_ASSERT(bytes.size() == CalculateMipSize(max(1u, m_width >> mip_index), max(1u, m_height >> mip_index), 1, m_format, m_bits_per_channel, m_channel_count));
+
+        slice.mips.emplace_back().bytes = move(bytes);
+        m_depth                         = static_cast<uint32_t>(m_slices.size());
+        m_mip_count                     = static_cast<uint32_t>(m_slices[0].mips.size());
+    }
+
+    void RHI_Texture::SwapResource(RHI_Texture* texture)
+    {
+        // takes over the gpu resource, and the part of the mip chain it holds, of a texture that was
+        // prepared from the same data - the other texture releases the old resource when it's destroyed
+        SP_ASSERT(texture != nullptr);
+        SP_ASSERT(texture->m_format == m_format && texture->m_depth == m_depth);
+
+        swap(m_width,               texture->m_width);
+        swap(m_height,              texture->m_height);
+        swap(m_mip_count,           texture->m_mip_count);
+        swap(m_mip_index_top,       texture->m_mip_index_top);
+        swap(m_viewport,            texture->m_viewport);
+        swap(m_layout,              texture->m_layout);
+        swap(m_object_size,         texture->m_object_size);
+        swap(m_rhi_resource,        texture->m_rhi_resource);
+        swap(m_rhi_srv,             texture->m_rhi_srv);
+        swap(m_rhi_srv_mips,        texture->m_rhi_srv_mips);
+        swap(m_rhi_rtv,             texture->m_rhi_rtv);
+        swap(m_rhi_dsv,             texture->m_rhi_dsv);
+        swap(m_rhi_external_memory, texture->m_rhi_external_memory);
+        swap(m_mapped_data,         texture->m_mapped_data);
+    }
+
     void RHI_Texture::ComputeMemoryUsage()
     {
         m_object_size = 0;
@@ -513,6 +1271,73 @@ namespace spartan
          m_slices.shrink_to_fit();
     }
 
+    bool RHI_Texture::LoadDerivedData(const uint64_t key)
+    {
+        if (!DerivedDataCache::Exists(key))
+            return false;
+
+        container::Header header;
+        vector<RHI_Texture_Slice> slices;
+        bool valid = false;
+        {
+            FileStream file(DerivedDataCache::GetFilePath(key), FileStream_Read);
+            vector<container::Entry> table;
+            uint64_t data_start = 0;
+            if (file.IsOpen() && container::read_header(&file, header, table, data_start) && header.depth != 0 && header.mip_count != 0)
+            {
+                container::read_mips(&file, header, table, data_start, 0, slices);
+                valid = true;
+            }
+        }
+
+        if (!valid)
+        {
+            DerivedDataCache::Invalidate(key);
+            return false;
+        }
+
+        // identity (object id, path, usage flags) stays as is, only the data and what describes it is replaced
+        m_width            = header.width;
+        m_height           = header.height;
+        m_depth            = header.depth;
+        m_mip_count        = header.mip_count;
+        m_channel_count    = header.channel_count;
+        m_bits_per_channel = header.bits_per_channel;
+        m_format           = static_cast<RHI_Format>(header.format);
+        m_flags           |= header.flags & derived_data::import_flags;
+        m_slices           = move(slices);
+
+        return true;
+    }
+
+    void RHI_Texture::SaveDerivedData(const uint64_t key)
+    {
+        if (key == 0 || !HasData())
+            return;
+
+        container::Header header;
+        header.width            = m_width;
+        header.height           = m_height;
+        header.depth            = static_cast<uint32_t>(m_slices.size());
+        header.mip_count        = static_cast<uint32_t>(m_slices[0].mips.size());
+        header.channel_count    = m_channel_count;
+        header.bits_per_channel = m_bits_per_channel;
+        header.type             = static_cast<uint32_t>(m_type);
+        header.format           = static_cast<uint32_t>(m_format);
+        header.flags            = m_flags;
+
+        const string file_path_temp = DerivedDataCache::GetFilePathTemp(key);
+        {
+            FileStream file(file_path_temp, FileStream_Write);
+            if (!file.IsOpen())
+                return;
+
+            container::write(&file, header, m_slices);
+        }
+
+        DerivedDataCache::Commit(key, file_path_temp);
+    }
+
     void RHI_Texture::PrepareForGpu()
     {
         SP_ASSERT_MSG(m_resource_state == ResourceState::Max, "Only unprepared textures can be prepared");
@@ -529,55 +1354,67 @@ namespace spartan
                 SP_ASSERT(!m_slices.empty());
                 SP_ASSERT(!m_slices.front().mips.empty());
 
-                // generate mip chain
-                uint32_t mip_count = mips::compute_count(m_width, m_height);
-                for (uint32_t mip_index = 1; mip_index < mip_count; mip_index++)
+                // mips, thumbnails and compression only depend on the source data and the flags, so they are cached with it
+                const RHI_Texture_MipFilter mip_filter         = mips::filter.load();
+                const RHI_Texture_Compression compression_mode = compression::mode.load();
+                const uint64_t key                             = derived_data::compute_key_prepared(m_derived_data_key, m_flags, static_cast<uint32_t>(m_slices[0].mips.size()), mip_filter, compression_mode);
+                if (!LoadDerivedData(key))
                 {
-                    AllocateMip();
-
-                    mips::downsample_bilinear(
-                        m_slices[0].mips[mip_index - 1].bytes, // larger
-                        m_slices[0].mips[mip_index].bytes,     // smaller
-                        max(1u, m_width  >> (mip_index - 1)),  // larger width
-                        max(1u, m_height >> (mip_index - 1))   // larger height
-                    );
-                }
+                    // generate mip chain (unless it was loaded from the drive)
+                    uint32_t mip_count = m_slices[0].mips.size() == 1 ? mips::compute_count(m_width, m_height) : 0;
+                    for (uint32_t mip_index = 1; mip_index < mip_count; mip_index++)
+                    {
+                        AllocateMip();
+
+                        mips::downsample(
+                            m_slices[0].mips[mip_index - 1].bytes, // larger
+                            m_slices[0].mips[mip_index].bytes,     // smaller
+                            max(1u, m_width  >> (mip_index - 1)),  // larger width
+                            max(1u, m_height >> (mip_index - 1)),  // larger height
+                            m_flags & RHI_Texture_Srgb,            // filter in linear space
+                            m_format,
+                            mip_filter
+                        );
+                    }
 
-                // for thumbnails, find the appropriate mip level close to 128x128 and make it the only mip
-                if (m_flags & RHI_Texture_Thumbnail)
-                {
-                    uint32_t target_mip = 0;
-                    for (uint32_t i = 0; i < m_slices[0].mips.size(); i++)
+                    // for thumbnails, find the appropriate mip level close to 128x128 and make it the only mip
+                    if (m_flags & RHI_Texture_Thumbnail)
                     {
-                        uint32_t mip_width  = max(1u, m_width >> i);
-                        uint32_t mip_height = max(1u, m_height >> i);
+                        uint32_t target_mip = 0;
+                        for (uint32_t i = 0; i < m_slices[0].mips.size(); i++)
+                        {
+                            uint32_t mip_width  = max(1u, m_width >> i);
+                            uint32_t mip_height = max(1u, m_height >> i);
                         
-                        if (mip_width <= 128 && mip_height <= 128)
+                            if (mip_width <= 128 && mip_height <= 128)
+                            {
+                                target_mip = i;
+                                break;
+                            }
+                        }
+
+                        // move the target mip to the top
+                        if (target_mip > 0)
                         {
-                            target_mip = i;
-                            break;
+                            m_slices[0].mips[0] = move(m_slices[0].mips[target_mip]);
+                            m_width             = max(1u, m_width >> target_mip);
+                            m_height            = max(1u, m_height >> target_mip);
                         }
+                    
+                        // clear all other mips
+                        m_slices[0].mips.resize(1);
+                        m_mip_count = static_cast<uint32_t>(m_slices[0].mips.size());
                     }
 
-                    // move the target mip to the top
-                    if (target_mip > 0)
+                    // compress
+                    bool compress       = m_flags & RHI_Texture_Compress;
+                    bool not_compressed = !IsCompressedFormat();
+                    if (compress && not_compressed)
                     {
-                        m_slices[0].mips[0] = move(m_slices[0].mips[target_mip]);
-                        m_width             = max(1u, m_width >> target_mip);
-                        m_height            = max(1u, m_height >> target_mip);
+                        compression::compress(this, compression_mode);
                     }
-                    
-                    // clear all other mips
-                    m_slices[0].mips.resize(1);
-                    m_mip_count = static_cast<uint32_t>(m_slices[0].mips.size());
-                }
 
-                // compress
-                bool compress       = m_flags & RHI_Texture_Compress;
-                bool not_compressed = !IsCompressedFormat();
-                if (compress && not_compressed)
-                {
-                    compressonator::compress(this);
+                    SaveDerivedData(key);
                 }
             }
             
@@ -619,6 +1456,28 @@ namespace spartan
             format == RHI_Format::ASTC;
     }
 
+    void RHI_Texture::SetMipFilter(const RHI_Texture_MipFilter filter)
+    {
+        SP_ASSERT(filter != RHI_Texture_MipFilter::Max);
+        mips::filter = filter;
+    }
+
+    RHI_Texture_MipFilter RHI_Texture::GetMipFilter()
+    {
+        return mips::filter;
+    }
+
+    void RHI_Texture::SetCompression(const RHI_Texture_Compression compression)
+    {
+        SP_ASSERT(compression != RHI_Texture_Compression::Max);
+        compression::mode = compression;
+    }
+
+    RHI_Texture_Compression RHI_Texture::GetCompression()
+    {
+        return compression::mode;
+    }
+
     size_t RHI_Texture::CalculateMipSize(uint32_t width, uint32_t height, uint32_t depth, RHI_Format format, uint32_t bits_per_channel, uint32_t channel_count)
     {
         SP_ASSERT(width  > 0);
@@ -660,4 +1519,48 @@ namespace spartan
             return static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * static_cast<size_t>(channel_count) * static_cast<size_t>(bits_per_channel / 8);
         }
     }
+
+    void RHI_Texture::QuantizeToRgba8(const vector<byte>& source, const RHI_Format format, const uint32_t width, const uint32_t height, vector<byte>& destination)
+    {
+        SP_ASSERT(format == RHI_Format::R16G16B16A16_Unorm || format == RHI_Format::R32G32B32A32_Float);
+
+        const size_t values_per_row = static_cast<size_t>(width) * 4;
+        SP_ASSERT(source.size() >= values_per_row * height * (format == RHI_Format::R16G16B16A16_Unorm ? sizeof(uint16_t) : sizeof(float)));
+        destination.resize(values_per_row * height);
+
+        // values are rounded to the nearest 8-bit code, gamma encoded sources simply stay gamma encoded
+        auto quantize_rows = [&](uint32_t row_start, uint32_t row_end)
+        {
+            uint8_t* output     = reinterpret_cast<uint8_t*>(destination.data());
+            const size_t start  = row_start * values_per_row;
+            const size_t end    = row_end * values_per_row;
+
+            if (format == RHI_Format::R16G16B16A16_Unorm)
+            {
+                const uint16_t* input = reinterpret_cast<const uint16_t*>(source.data());
+                for (size_t i = start; i < end; i++)
+                {
+                    output[i] = static_cast<uint8_t>((static_cast<uint32_t>(input[i]) * 255 + 32767) / 65535);
+                }
+            }
+            else
+            {
+                const float* input = reinterpret_cast<const float*>(source.data());
+                for (size_t i = start; i < end; i++)
+                {
+                    output[i] = static_cast<uint8_t>(clamp(input[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        };
+
+        // small images aren't worth waking up threads for
+        if (height >= 64)
+        {
+            ThreadPool::ParallelLoop(quantize_rows, height);
+        }
+        else
+        {
+            quantize_rows(0, height);
+        }
+    }
 }
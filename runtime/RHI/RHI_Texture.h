@@ -55,7 +55,23 @@ namespace spartan
         RHI_Texture_Compress          = 1U << 11,
         RHI_Texture_ExternalMemory    = 1U << 12,
         RHI_Texture_DontPrepareForGpu = 1U << 13,
-        RHI_Texture_Thumbnail         = 1U << 14
+        RHI_Texture_Thumbnail         = 1U << 14,
+        RHI_Texture_NormalMap         = 1U << 15
+    };
+
+    enum class RHI_Texture_MipFilter
+    {
+        Box,     // exact footprint average, fastest
+        Kaiser,  // sharper, with little ringing
+        Lanczos, // sharpest, can ring around hard edges
+        Max
+    };
+
+    enum class RHI_Texture_Compression
+    {
+        Fast,    // built-in block encoder (bc1, bc3, bc5), suited to load time
+        Quality, // compressonator (bc7, bc5), much slower
+        Max
     };
 
     struct RHI_Texture_Mip
@@ -119,6 +135,11 @@ namespace spartan
         void PrepareForGpu();
         void SaveAsImage(const std::string& file_path);
         static size_t CalculateMipSize(uint32_t width, uint32_t height, uint32_t depth, RHI_Format format, uint32_t bits_per_channel, uint32_t channel_count);
+        static void QuantizeToRgba8(const std::vector<std::byte>& source, const RHI_Format format, const uint32_t width, const uint32_t height, std::vector<std::byte>& destination);
+        static void SetMipFilter(const RHI_Texture_MipFilter filter);
+        static RHI_Texture_MipFilter GetMipFilter();
+        static void SetCompression(const RHI_Texture_Compression compression);
+        static RHI_Texture_Compression GetCompression();
 
         // data
         uint32_t GetMipCount() const { return m_mip_count; }
@@ -127,6 +148,18 @@ namespace spartan
         RHI_Texture_Mip& GetMip(const uint32_t array_index, const uint32_t mip_index);
         RHI_Texture_Slice& GetSlice(const uint32_t array_index);
         void AllocateMip();
+        void AddMip(const uint32_t array_index, std::vector<std::byte>&& bytes); // appends already filled data, growing the slices as needed
+
+        // streaming - engine texture files keep a mip table, so any part of the mip chain can be read on its own
+        bool LoadMipsFromFile(const std::string& file_path, const uint32_t mip_index_top);
+        void SetMipIndexTop(const uint32_t mip_index) { m_mip_index_top = mip_index; } // the largest mip to load, larger mips stay on the drive
+        uint32_t GetMipIndexTop() const               { return m_mip_index_top; }
+        uint32_t GetMipCountInFile() const            { return m_mip_count_file; }
+        void SwapResource(RHI_Texture* texture);
+
+        // derived data - a key of the source data (zero if unknown), decoded and prepared data is cached under it
+        uint64_t GetDerivedDataKey() const         { return m_derived_data_key; }
+        void SetDerivedDataKey(const uint64_t key) { m_derived_data_key = key; }
 
         // flags
         bool IsSrv() const             { return m_flags & RHI_Texture_Srv; }
@@ -186,6 +219,9 @@ namespace spartan
         RHI_Texture_Type m_type     = RHI_Texture_Type::Max;
         RHI_Viewport m_viewport;
         std::vector<RHI_Texture_Slice> m_slices;
+        uint32_t m_mip_index_top    = 0; // relative to the mip chain in the file
+        uint32_t m_mip_count_file   = 0;
+        uint64_t m_derived_data_key = 0;
         std::array<RHI_Image_Layout, rhi_max_mip_count> m_layout = { RHI_Image_Layout::Max };
 
         // api resources
@@ -199,5 +235,7 @@ namespace spartan
 
     private:
         void ComputeMemoryUsage();
+        bool LoadDerivedData(const uint64_t key);
+        void SaveDerivedData(const uint64_t key);
     };
 }
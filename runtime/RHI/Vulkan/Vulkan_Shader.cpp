@@ -28,6 +28,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../RHI_Shader.h"
 #include "../RHI_InputLayout.h"
 #include "../RHI_DirectXShaderCompiler.h"
+#include "../RHI_ShaderCache.h"
 SP_WARNINGS_OFF
 #include <spirv_cross/spirv_hlsl.hpp>
 SP_WARNINGS_ON
@@ -88,6 +89,40 @@ namespace spartan
         };
 
         atomic<bool> spriv_cross_registered = false;
+
+        void register_spirv_cross()
+        {
+            // done here and not in Reflect() since shaders that come from the cache are never reflected
+            if (!spriv_cross_registered)
+            {
+                unsigned int major         = (SPV_VERSION >> 16) & 0xff; // extract major version
+                unsigned int minor         = (SPV_VERSION >> 8) & 0xff;  // extract minor version
+                unsigned int path_revision = SPV_VERSION & 0xff;         // extract patch version
+                unsigned int revision      = SPV_REVISION;               // get revision
+
+                ostringstream version;
+                version << major << "." << minor << "." << path_revision << "." << revision;
+
+                Settings::RegisterThirdPartyLib("SPIRV-Cross", version.str(), "https://github.com/KhronosGroup/SPIRV-Cross");
+                spriv_cross_registered = true;
+            }
+        }
+
+        VkShaderModule create_shader_module(const void* binary, const size_t binary_size, const char* name)
+        {
+            VkShaderModule shader_module         = nullptr;
+            VkShaderModuleCreateInfo create_info = {};
+            create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            create_info.codeSize                 = binary_size;
+            create_info.pCode                    = reinterpret_cast<const uint32_t*>(binary);
+
+            SP_ASSERT_VK(vkCreateShaderModule(RHI_Context::device, &create_info, nullptr, &shader_module));
+
+            // name the shader module (useful for gpu-based validation)
+            RHI_Device::SetResourceName(static_cast<void*>(shader_module), RHI_Resource_Type::Shader, name);
+
+            return shader_module;
+        }
     }
 
     RHI_Shader::~RHI_Shader()
@@ -101,6 +136,27 @@ namespace spartan
 
     void* RHI_Shader::RHI_Compile()
     {
+        register_spirv_cross();
+
+        // try the cache first, a hit skips both the compiler and the reflection
+        const uint64_t cache_key = GetCacheKey();
+        {
+            vector<byte> binary;
+            if (RHI_ShaderCache::Load(cache_key, binary, m_descriptors))
+            {
+                m_is_from_cache = true;
+
+                VkShaderModule shader_module = create_shader_module(binary.data(), binary.size(), m_object_name.c_str());
+
+                if (m_input_layout)
+                {
+                    m_input_layout->Create(m_vertex_type, nullptr);
+                }
+
+                return static_cast<void*>(shader_module);
+            }
+        }
+
         vector<string> arguments;
 
         // arguments
@@ -162,16 +218,7 @@ namespace spartan
             dxc_result->GetResult(&shader_buffer);
 
             // create shader module
-            VkShaderModule shader_module         = nullptr;
-            VkShaderModuleCreateInfo create_info = {};
-            create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-            create_info.codeSize                 = static_cast<size_t>(shader_buffer->GetBufferSize());
-            create_info.pCode                    = reinterpret_cast<const uint32_t*>(shader_buffer->GetBufferPointer());
-
-            SP_ASSERT_VK(vkCreateShaderModule(RHI_Context::device, &create_info, nullptr, &shader_module));
-
-            // name the shader module (useful for gpu-based validation)
-            RHI_Device::SetResourceName(static_cast<void*>(shader_module), RHI_Resource_Type::Shader, m_object_name.c_str());
+            VkShaderModule shader_module = create_shader_module(shader_buffer->GetBufferPointer(), static_cast<size_t>(shader_buffer->GetBufferSize()), m_object_name.c_str());
 
             // reflect shader resources (so that descriptor sets can be created later)
             Reflect
@@ -180,6 +227,9 @@ namespace spartan
                 reinterpret_cast<uint32_t*>(shader_buffer->GetBufferPointer()),
                 static_cast<uint32_t>(shader_buffer->GetBufferSize() / 4)
             );
+
+            // store the binary and the reflection so that the next run can skip all of the above
+            RHI_ShaderCache::Save(cache_key, shader_buffer->GetBufferPointer(), shader_buffer->GetBufferSize(), m_descriptors);
             
             // create input layout
             if (m_input_layout)
@@ -201,20 +251,6 @@ namespace spartan
         SP_ASSERT(ptr != nullptr);
         SP_ASSERT(size != 0);
 
-        if (!spriv_cross_registered)
-        {
-            unsigned int major         = (SPV_VERSION >> 16) & 0xff; // extract major version
-            unsigned int minor         = (SPV_VERSION >> 8) & 0xff;  // extract minor version
-            unsigned int path_revision = SPV_VERSION & 0xff;         // extract patch version
-            unsigned int revision      = SPV_REVISION;               // get revision
-
-            ostringstream version;
-            version << major << "." << minor << "." << path_revision << "." << revision;
-
-            Settings::RegisterThirdPartyLib("SPIRV-Cross", version.str(), "https://github.com/KhronosGroup/SPIRV-Cross");
-            spriv_cross_registered = true;
-        }
-        
         const CompilerHLSL compiler = CompilerHLSL(ptr, size);
         ShaderResources resources   = compiler.get_shader_resources();
 
@@ -22,6 +22,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES =========================
 #include "pch.h"
 #include "Material.h"
+#include "TextureStreaming.h"
 #include "../Resource/ResourceCache.h"
 #include "../RHI/RHI_Texture.h"
 #include "../World/World.h"
@@ -72,6 +73,7 @@ namespace spartan
                 case MaterialProperty::WindAnimation:    return "vertex_animate_wind";
                 case MaterialProperty::VertexAnimateWater:   return "vertex_animate_water";
                 case MaterialProperty::CullMode:             return "cull_mode";
+                case MaterialProperty::IsTerrain:            return "is_terrain";
                 case MaterialProperty::Max:                  return "max";
                 default:
                 {
@@ -80,48 +82,228 @@ namespace spartan
                 }
             }
         }
+
+        // textures built out of other textures cache their prepared data under a key of their sources, the key
+        // is zero (nothing is cached) if a source doesn't have one, e.g. because it was generated at runtime
+        uint64_t combine_derived_data_keys(uint64_t key, initializer_list<RHI_Texture*> sources)
+        {
+            for (RHI_Texture* source : sources)
+            {
+                if (source && source->GetDerivedDataKey() == 0)
+                    return 0;
+
+                key = rhi_hash_combine(key, source ? source->GetDerivedDataKey() : 0);
+            }
+
+            return key;
+        }
     }
 
     namespace texture_packing
     {
-        void pack_occlusion_roughness_metalness_height(
-            const vector<byte>& occlusion,
-            const vector<byte>& roughness,
-            const vector<byte>& metalness,
-            const vector<byte>& height,
-            const bool is_gltf,
-            vector<byte>& output
-        )
-        {
-            SP_ASSERT_MSG(
-                occlusion.size() == roughness.size() &&
-                roughness.size() == metalness.size() &&
-                metalness.size() == height.size(),
-                "The dimensions must be equal"
-            );
-
-            // just like gltf: occlusion, roughness and metalness as r, g, b channels respectively
-            for (size_t i = 0; i < occlusion.size(); i += 4)
+        // a channel of an rgba8 texture, a missing texture reads as the constant instead
+        struct Channel
+        {
+            const byte* data = nullptr;
+            uint32_t width   = 0;
+            uint32_t height  = 0;
+            uint32_t offset  = 0; // byte of the channel within a texel
+            uint8_t constant = 0;
+            shared_ptr<vector<byte>> quantized; // owns data when the source is rgba16 or rgba32f
+        };
+
+        Channel get_channel(RHI_Texture* texture, const uint32_t offset, const uint8_t constant)
+        {
+            Channel channel;
+            channel.constant = constant;
+
+            if (!texture || texture->GetMip(0, 0).bytes.empty())
+                return channel;
+
+            // 16-bit and float sources are quantized to rgba8, the packed texture is 8 bits per channel anyway
+            if (texture->GetFormat() == RHI_Format::R16G16B16A16_Unorm || texture->GetFormat() == RHI_Format::R32G32B32A32_Float)
             {
-                output[i + 0] = occlusion[i];
-                output[i + 1] = roughness[i + (is_gltf ? 1 : 0)];
-                output[i + 2] = metalness[i + (is_gltf ? 2 : 0)];
-                output[i + 3] = height[i];
+                channel.quantized = make_shared<vector<byte>>();
+                RHI_Texture::QuantizeToRgba8(texture->GetMip(0, 0).bytes, texture->GetFormat(), texture->GetWidth(), texture->GetHeight(), *channel.quantized);
             }
+
+            // compressed formats can't be packed, they are treated as missing
+            if (channel.quantized || texture->GetFormat() == RHI_Format::R8G8B8A8_Unorm)
+            {
+                channel.data   = channel.quantized ? channel.quantized->data() : texture->GetMip(0, 0).bytes.data();
+                channel.width  = texture->GetWidth();
+                channel.height = texture->GetHeight();
+                channel.offset = offset;
+            }
+
+            return channel;
+        }
+
+        // returns the row of the channel's texture which lines up with the output row, sources of a different
+        // resolution are bilinearly resampled into scratch (only the channel's byte of each texel is written)
+        const byte* get_row(const Channel& channel, const uint32_t y, const uint32_t width, const uint32_t height, vector<byte>& scratch)
+        {
+            if (channel.width == width && channel.height == height)
+                return channel.data + static_cast<size_t>(y) * width * 4;
+
+            scratch.resize(static_cast<size_t>(width) * 4);
+
+            const float scale_x    = static_cast<float>(channel.width) / static_cast<float>(width);
+            const float scale_y    = static_cast<float>(channel.height) / static_cast<float>(height);
+            const float source_y   = max(0.0f, (static_cast<float>(y) + 0.5f) * scale_y - 0.5f);
+            const uint32_t y0      = min(static_cast<uint32_t>(source_y), channel.height - 1);
+            const uint32_t y1      = min(y0 + 1, channel.height - 1);
+            const float fraction_y = source_y - static_cast<float>(y0);
+            const uint8_t* row_0   = reinterpret_cast<const uint8_t*>(channel.data) + static_cast<size_t>(y0) * channel.width * 4 + channel.offset;
+            const uint8_t* row_1   = reinterpret_cast<const uint8_t*>(channel.data) + static_cast<size_t>(y1) * channel.width * 4 + channel.offset;
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const float source_x   = max(0.0f, (static_cast<float>(x) + 0.5f) * scale_x - 0.5f);
+                const uint32_t x0      = min(static_cast<uint32_t>(source_x), channel.width - 1);
+                const uint32_t x1      = min(x0 + 1, channel.width - 1);
+                const float fraction_x = source_x - static_cast<float>(x0);
+
+                const float top    = lerp(static_cast<float>(row_0[x0 * 4]), static_cast<float>(row_0[x1 * 4]), fraction_x);
+                const float bottom = lerp(static_cast<float>(row_1[x0 * 4]), static_cast<float>(row_1[x1 * 4]), fraction_x);
+
+                scratch[x * 4 + channel.offset] = static_cast<byte>(static_cast<uint8_t>(min(lerp(top, bottom, fraction_y) + 0.5f, 255.0f)));
+            }
+
+            return scratch.data();
         }
 
-        void merge_alpha_mask_into_color_alpha(vector<byte>& albedo, vector<byte>& mask)
+        // large textures are split across the thread pool by rows
+        void for_each_row_range(const uint32_t height, function<void(uint32_t row_start, uint32_t row_end)>&& function)
         {
-            SP_ASSERT_MSG(albedo.size() == mask.size(), "The dimensions must be equal");
-        
-            for (size_t i = 0; i < albedo.size(); i += 4)
+            if (height >= 64)
+            {
+                ThreadPool::ParallelLoop(move(function), height);
+            }
+            else
             {
-                float alpha_albedo   = static_cast<float>(albedo[i + 3]) / 255.0f; // channel a
-                float alpha_mask     = static_cast<float>(mask[i]) / 255.0f;       // channel r
-                float alpha_combined = min(alpha_albedo, alpha_mask);
+                function(0, height);
+            }
+        }
 
-                albedo[i + 3] = static_cast<byte>(alpha_combined * 255.0f);
+        #if defined(__AVX2__)
+        // a byte shuffle which moves the source byte of every texel to the destination byte and zeroes the rest,
+        // pshufb indexes within 128-bit lanes so both lanes use the same pattern
+        __m256i channel_shuffle(const uint32_t source_offset, const uint32_t destination_offset)
+        {
+            alignas(32) int8_t indices[32];
+            for (uint32_t i = 0; i < 32; i++)
+            {
+                const uint32_t texel = (i % 16) / 4;
+                indices[i]           = (i % 4 == destination_offset) ? static_cast<int8_t>(texel * 4 + source_offset) : static_cast<int8_t>(-128);
             }
+
+            return _mm256_load_si256(reinterpret_cast<const __m256i*>(indices));
+        }
+        #endif
+
+        // just like gltf: occlusion, roughness and metalness as r, g, b channels respectively, height goes to alpha
+        void pack_occlusion_roughness_metalness_height(const array<Channel, 4>& channels, const uint32_t width, const uint32_t height, vector<byte>& output)
+        {
+            SP_ASSERT(output.size() >= static_cast<size_t>(width) * height * 4);
+
+            // missing channels are written as constants instead of being read from fallback buffers
+            uint32_t constants = 0;
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                if (!channels[i].data)
+                {
+                    constants |= static_cast<uint32_t>(channels[i].constant) << (i * 8);
+                }
+            }
+
+            for_each_row_range(height, [&](uint32_t row_start, uint32_t row_end)
+            {
+                array<vector<byte>, 4> scratch;
+                array<const byte*, 4> rows = {};
+
+                #if defined(__AVX2__)
+                const __m256i texels_constant = _mm256_set1_epi32(static_cast<int32_t>(constants));
+                __m256i shuffles[4];
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    shuffles[i] = channel_shuffle(channels[i].offset, i);
+                }
+                #endif
+
+                for (uint32_t y = row_start; y < row_end; y++)
+                {
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        rows[i] = channels[i].data ? get_row(channels[i], y, width, height, scratch[i]) : nullptr;
+                    }
+
+                    byte* destination = &output[static_cast<size_t>(y) * width * 4];
+                    uint32_t x        = 0;
+
+                    #if defined(__AVX2__)
+                    for (; x + 8 <= width; x += 8)
+                    {
+                        __m256i texels = texels_constant;
+                        for (uint32_t i = 0; i < 4; i++)
+                        {
+                            if (rows[i])
+                            {
+                                const __m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[i] + x * 4));
+                                texels               = _mm256_or_si256(texels, _mm256_shuffle_epi8(source, shuffles[i]));
+                            }
+                        }
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x * 4), texels);
+                    }
+                    #endif
+
+                    for (; x < width; x++)
+                    {
+                        for (uint32_t i = 0; i < 4; i++)
+                        {
+                            destination[x * 4 + i] = rows[i] ? rows[i][x * 4 + channels[i].offset] : static_cast<byte>(channels[i].constant);
+                        }
+                    }
+                }
+            });
+        }
+
+        // the color's alpha becomes the min of itself and the mask
+        void merge_alpha_mask_into_color_alpha(vector<byte>& color, const uint32_t width, const uint32_t height, const Channel& mask)
+        {
+            SP_ASSERT(mask.data != nullptr);
+            SP_ASSERT(color.size() >= static_cast<size_t>(width) * height * 4);
+
+            for_each_row_range(height, [&](uint32_t row_start, uint32_t row_end)
+            {
+                vector<byte> scratch;
+
+                #if defined(__AVX2__)
+                const __m256i shuffle   = channel_shuffle(mask.offset, 3);
+                const __m256i color_rgb = _mm256_set1_epi32(0x00FFFFFF); // leaves rgb untouched by the min
+                #endif
+
+                for (uint32_t y = row_start; y < row_end; y++)
+                {
+                    const byte* row_mask = get_row(mask, y, width, height, scratch);
+                    byte* row_color      = &color[static_cast<size_t>(y) * width * 4];
+                    uint32_t x           = 0;
+
+                    #if defined(__AVX2__)
+                    for (; x + 8 <= width; x += 8)
+                    {
+                        const __m256i texels_mask  = _mm256_or_si256(_mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_mask + x * 4)), shuffle), color_rgb);
+                        const __m256i texels_color = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_color + x * 4));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row_color + x * 4), _mm256_min_epu8(texels_color, texels_mask));
+                    }
+                    #endif
+
+                    for (; x < width; x++)
+                    {
+                        row_color[x * 4 + 3] = min(row_color[x * 4 + 3], row_mask[x * 4 + mask.offset]);
+                    }
+                }
+            });
         }
     }
 
@@ -164,24 +346,48 @@ namespace spartan
 
         // load textures
         uint32_t texture_count = node_material.child("textures").attribute("count").as_uint();
+        vector<MaterialTextureType> tex_types(texture_count);
+        vector<shared_ptr<RHI_Texture>> textures(texture_count);
+        vector<string> tex_paths(texture_count);
         for (uint32_t i = 0; i < texture_count; ++i)
         {
             string node_name            = "texture_" + to_string(i);
             pugi::xml_node node_texture = node_material.child("textures").child(node_name.c_str());
 
-            MaterialTextureType tex_type = static_cast<MaterialTextureType>(node_texture.attribute("texture_type").as_uint());
-            string tex_name              = node_texture.attribute("texture_name").as_string();
-            string tex_path              = node_texture.attribute("texture_path").as_string();
+            tex_types[i]    = static_cast<MaterialTextureType>(node_texture.attribute("texture_type").as_uint());
+            string tex_name = node_texture.attribute("texture_name").as_string();
+            tex_paths[i]    = node_texture.attribute("texture_path").as_string();
 
             // If the texture happens to be loaded, get a reference to it
-            auto texture = ResourceCache::GetByName<RHI_Texture>(tex_name);
-            // If there is not texture (it's not loaded yet), load it
-            if (!texture)
+            textures[i] = ResourceCache::GetByName<RHI_Texture>(tex_name);
+        }
+
+        // If there is not texture (it's not loaded yet), load it, the images are independent so they are decoded in parallel
+        // a path that several types share (e.g. a packed occlusion/roughness/metalness map) is only loaded once
+        unordered_map<string, uint32_t> path_to_load;
+        vector<string> load_paths;
+        for (uint32_t i = 0; i < texture_count; ++i)
+        {
+            if (!textures[i] && path_to_load.emplace(tex_paths[i], static_cast<uint32_t>(load_paths.size())).second)
             {
-                texture = ResourceCache::Load<RHI_Texture>(tex_path);
+                load_paths.push_back(tex_paths[i]);
             }
+        }
+
+        vector<shared_ptr<RHI_Texture>> loaded(load_paths.size());
+        ThreadPool::ParallelForEach([&](uint32_t i)
+        {
+            loaded[i] = ResourceCache::Load<RHI_Texture>(load_paths[i]);
+        }, static_cast<uint32_t>(load_paths.size()));
 
-            SetTexture(tex_type, texture);
+        for (uint32_t i = 0; i < texture_count; ++i)
+        {
+            if (!textures[i])
+            {
+                textures[i] = loaded[path_to_load[tex_paths[i]]];
+            }
+
+            SetTexture(tex_types[i], textures[i]);
         }
 
         m_object_size = sizeof(*this);
@@ -358,9 +564,27 @@ namespace spartan
                     }
                     else
                     {
-                        if (!texture_color->IsCompressedFormat() && !texture_alpha_mask->IsCompressedFormat())
+                        texture_packing::Channel mask = texture_packing::get_channel(texture_alpha_mask, 0, 255);
+
+                        // the mask is 8 bits and so is the compressed color, so a 16-bit or float color texture is quantized to take it
+                        const bool is_wide = texture_color->GetFormat() == RHI_Format::R16G16B16A16_Unorm || texture_color->GetFormat() == RHI_Format::R32G32B32A32_Float;
+                        if (is_wide && texture_color->HasData() && mask.data)
+                        {
+                            for (uint32_t mip_index = 0; mip_index < texture_color->GetMipCount(); mip_index++)
+                            {
+                                vector<byte> quantized;
+                                RHI_Texture_Mip& mip = texture_color->GetMip(0, mip_index);
+                                RHI_Texture::QuantizeToRgba8(mip.bytes, texture_color->GetFormat(), max(1u, texture_color->GetWidth() >> mip_index), max(1u, texture_color->GetHeight() >> mip_index), quantized);
+                                mip.bytes = move(quantized);
+                            }
+                            texture_color->SetFormat(RHI_Format::R8G8B8A8_Unorm);
+                            texture_color->SetBitsPerChannel(8);
+                        }
+
+                        if (texture_color->GetFormat() == RHI_Format::R8G8B8A8_Unorm && texture_color->HasData() && mask.data)
                         {
-                            texture_packing::merge_alpha_mask_into_color_alpha(texture_color->GetMip(0, 0).bytes, texture_alpha_mask->GetMip(0, 0).bytes);
+                            texture_packing::merge_alpha_mask_into_color_alpha(texture_color->GetMip(0, 0).bytes, texture_color->GetWidth(), texture_color->GetHeight(), mask);
+                            texture_color->SetDerivedDataKey(combine_derived_data_keys(1, { texture_color, texture_alpha_mask }));
                         }
                     }
                 }
@@ -386,11 +610,6 @@ namespace spartan
                     shared_ptr<RHI_Texture> texture_packed = ResourceCache::GetByName<RHI_Texture>(tex_name);
                     if (!texture_packed)
                     {
-                        bool textures_are_compressed = (texture_occlusion  && texture_occlusion->IsCompressedFormat()) ||
-                                                       (texture_roughness  && texture_roughness->IsCompressedFormat()) ||
-                                                       (texture_metalness  && texture_metalness->IsCompressedFormat()) ||
-                                                       (texture_height     && texture_height->IsCompressedFormat());
-
                         // create packed texture
                         texture_packed = make_shared<RHI_Texture>
                         (
@@ -406,23 +625,23 @@ namespace spartan
                         texture_packed->SetResourceFilePath(tex_name + ".png"); // that's a hack, need to fix the ResourceCache to rely on a hash, not names and paths
                         texture_packed->AllocateMip();
                         
-                        // create some default data to replace missing textures
-                        const size_t texture_size = reference_width * reference_height * 4;
-                        vector<byte> texture_one(texture_size, static_cast<byte>(255));
-                        vector<byte> texture_zero(texture_size, static_cast<byte>(0));
-                        vector<byte> texture_half(texture_size, static_cast<byte>(127));
-                        
-                        // create packed data and fallback to default data when needed
-                        texture_packing::pack_occlusion_roughness_metalness_height
-                        (
-                            (texture_occlusion && !texture_occlusion->GetMip(0, 0).bytes.empty()) ? texture_occlusion->GetMip(0, 0).bytes : texture_one,
-                            (texture_roughness && !texture_roughness->GetMip(0, 0).bytes.empty()) ? texture_roughness->GetMip(0, 0).bytes : texture_one,
-                            (texture_metalness && !texture_metalness->GetMip(0, 0).bytes.empty()) ? texture_metalness->GetMip(0, 0).bytes : texture_zero,
-                            (texture_height    && !texture_height->GetMip(0, 0).bytes.empty())    ? texture_height->GetMip(0, 0).bytes    : texture_half,
-                            GetProperty(MaterialProperty::Gltf) == 1.0f,
-                            texture_packed->GetMip(0, 0).bytes
-                        );
- 
+                        // missing channels read as constants, sources of a different resolution are resampled
+                        const bool is_gltf = GetProperty(MaterialProperty::Gltf) == 1.0f;
+                        const array<texture_packing::Channel, 4> channels =
+                        {
+                            texture_packing::get_channel(texture_occlusion, 0,               255),
+                            texture_packing::get_channel(texture_roughness, is_gltf ? 1 : 0, 255),
+                            texture_packing::get_channel(texture_metalness, is_gltf ? 2 : 0, 0),
+                            texture_packing::get_channel(texture_height,    0,               127)
+                        };
+
+                        // sources which read as constants don't take part in the key either
+                        auto source = [&channels](RHI_Texture* texture, const uint32_t index) { return channels[index].data ? texture : nullptr; };
+                        uint64_t key_seed = rhi_hash_combine((static_cast<uint64_t>(reference_width) << 32) | reference_height, is_gltf);
+                        texture_packed->SetDerivedDataKey(combine_derived_data_keys(key_seed, { source(texture_occlusion, 0), source(texture_roughness, 1), source(texture_metalness, 2), source(texture_height, 3) }));
+
+                        texture_packing::pack_occlusion_roughness_metalness_height(channels, reference_width, reference_height, texture_packed->GetMip(0, 0).bytes);
+
                         texture_packed = ResourceCache::Cache<RHI_Texture>(texture_packed);
                     }
 
@@ -449,12 +668,31 @@ namespace spartan
         ThreadPool::AddTask([this]()
         {
             // prepare all textures
-            for (RHI_Texture* texture : m_textures)
+            for (uint32_t i = 0; i < static_cast<uint32_t>(m_textures.size()); i++)
             {
+                RHI_Texture* texture = m_textures[i];
                 if (texture && texture->GetResourceState() == ResourceState::Max)
                 {
+                    // lets compression pick a two channel format
+                    if (i / slots_per_texture_type == static_cast<uint32_t>(MaterialTextureType::Normal))
+                    {
+                        texture->SetFlag(RHI_Texture_NormalMap);
+                    }
+
+                    // streamable textures keep their data until the full mip chain is on the drive
+                    const bool is_streamable = TextureStreaming::IsStreamable(texture);
+                    if (is_streamable)
+                    {
+                        texture->SetFlag(RHI_Texture_KeepData);
+                    }
+
                     texture->SetFlag(RHI_Texture_DontPrepareForGpu, false);
                     texture->PrepareForGpu();
+
+                    if (is_streamable)
+                    {
+                        TextureStreaming::Register(texture);
+                    }
                 }
             }
 
@@ -73,6 +73,7 @@ namespace spartan
         WindAnimation,        // applies vertex-based animation to simulate wind
         VertexAnimateWater,   // applies vertex-based animation to simulate water flow
         CullMode,             // sets the culling mode based on RHI_CullMode enum values
+        IsTerrain,            // the vertex shader displaces the geometry using the terrain height map
         Gltf,                 // indicates if the material was imported from a glTF file
         Max                   // total number of properties, used to size arrays
     };
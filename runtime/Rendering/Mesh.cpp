@@ -28,6 +28,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../IO/FileStream.h"
 #include "../Resource/Import/ModelImporter.h"
 #include "../Core/GeometryProcessing.h"
+#include "../Core/ThreadPool.h"
+#include "../Physics/PhysicsShapeCache.h"
 //===========================================
 
 //= NAMESPACES ================
@@ -37,6 +39,25 @@ using namespace spartan::math;
 
 namespace spartan
 {
+    namespace
+    {
+        // version 1 had no header, it started with the resource path followed by raw indices and vertices
+        const uint32_t model_magic   = 0x444D5053; // "SPMD"
+        const uint32_t model_version = 2;
+
+        void for_each_sub_mesh(const uint32_t count, function<void(uint32_t start, uint32_t end)>&& function)
+        {
+            if (count > 1)
+            {
+                ThreadPool::ParallelLoop(move(function), count);
+            }
+            else
+            {
+                function(0, count);
+            }
+        }
+    }
+
     Mesh::Mesh() : IResource(ResourceType::Mesh)
     {
         m_flags = GetDefaultFlags();
@@ -44,6 +65,7 @@ namespace spartan
 
     Mesh::~Mesh()
     {
+        PhysicsShapeCache::RemoveMesh(this);
         m_index_buffer  = nullptr;
         m_vertex_buffer = nullptr;
     }
@@ -55,6 +77,8 @@ namespace spartan
 
         m_vertices.clear();
         m_vertices.shrink_to_fit();
+
+        m_sub_meshes.clear();
     }
 
     void Mesh::LoadFromFile(const string& file_path)
@@ -75,9 +99,24 @@ namespace spartan
             if (!file->IsOpen())
                 return;
 
-            SetResourceFilePath(file->ReadAs<string>());
-            file->Read(&m_indices);
-            file->Read(&m_vertices);
+            uint32_t magic_or_path_length = file->ReadAs<uint32_t>();
+            if (magic_or_path_length == model_magic)
+            {
+                file->Seek(0);
+                if (!LoadFromFileEncoded(file.get()))
+                {
+                    SP_LOG_ERROR("Failed to decode \"%s\"", file_path.c_str());
+                    Clear();
+                    return;
+                }
+            }
+            else
+            {
+                span<const byte> path = file->ReadSpan(magic_or_path_length);
+                SetResourceFilePath(string(reinterpret_cast<const char*>(path.data()), path.size()));
+                file->Read(&m_indices);
+                file->Read(&m_vertices);
+            }
 
             PostProcess();
         }
@@ -104,15 +143,160 @@ namespace spartan
 
     void Mesh::SaveToFile(const string& file_path)
     {
+        const Stopwatch timer;
+
         auto file = make_unique<FileStream>(file_path, FileStream_Write);
         if (!file->IsOpen())
             return;
 
-        file->Write(GetResourceFilePath());
-        file->Write(m_indices);
-        file->Write(m_vertices);
+        const uint64_t size_encoded = SaveToFileEncoded(file.get());
 
         file->Close();
+
+        const float size_raw = static_cast<float>(GetMemoryUsage()) / (1024.0f * 1024.0f);
+        SP_LOG_INFO("Saving \"%s\" took %d ms, %.1f MB encoded (%.1f MB raw)",
+            FileSystem::GetFileNameFromFilePath(file_path).c_str(),
+            static_cast<int>(timer.GetElapsedTimeMs()),
+            static_cast<float>(size_encoded) / (1024.0f * 1024.0f),
+            size_raw
+        );
+    }
+
+    uint64_t Mesh::SaveToFileEncoded(FileStream* file)
+    {
+        // geometry that didn't come from AddGeometry() (e.g. loaded from a version 1 file) is stored as one sub-mesh
+        vector<SubMesh> sub_meshes = m_sub_meshes;
+        if (sub_meshes.empty())
+        {
+            sub_meshes.push_back({ 0, GetVertexCount(), 0, GetIndexCount() });
+        }
+        const uint32_t sub_mesh_count = static_cast<uint32_t>(sub_meshes.size());
+
+        // encode
+        vector<vector<unsigned char>> encoded_vertices(sub_mesh_count);
+        vector<vector<unsigned char>> encoded_indices(sub_mesh_count);
+        for_each_sub_mesh(sub_mesh_count, [&](uint32_t start, uint32_t end)
+        {
+            for (uint32_t i = start; i < end; i++)
+            {
+                const SubMesh& sub_mesh = sub_meshes[i];
+
+                vector<unsigned char>& vertices = encoded_vertices[i];
+                vertices.resize(meshopt_encodeVertexBufferBound(sub_mesh.vertex_count, sizeof(RHI_Vertex_PosTexNorTan)));
+                vertices.resize(meshopt_encodeVertexBuffer(vertices.data(), vertices.size(), m_vertices.data() + sub_mesh.vertex_offset, sub_mesh.vertex_count, sizeof(RHI_Vertex_PosTexNorTan)));
+
+                vector<unsigned char>& indices = encoded_indices[i];
+                indices.resize(meshopt_encodeIndexBufferBound(sub_mesh.index_count, sub_mesh.vertex_count));
+                indices.resize(meshopt_encodeIndexBuffer(indices.data(), indices.size(), m_indices.data() + sub_mesh.index_offset, sub_mesh.index_count));
+            }
+        });
+
+        // header
+        file->Write(model_magic);
+        file->Write(model_version);
+        file->Write(GetResourceFilePath());
+        file->Write(GetVertexCount());
+        file->Write(GetIndexCount());
+        file->Write(sub_mesh_count);
+        for (uint32_t i = 0; i < sub_mesh_count; i++)
+        {
+            file->Write(sub_meshes[i].vertex_offset);
+            file->Write(sub_meshes[i].vertex_count);
+            file->Write(sub_meshes[i].index_offset);
+            file->Write(sub_meshes[i].index_count);
+            file->Write(static_cast<uint64_t>(encoded_vertices[i].size()));
+            file->Write(static_cast<uint64_t>(encoded_indices[i].size()));
+        }
+
+        // payload
+        uint64_t size_encoded = 0;
+        for (uint32_t i = 0; i < sub_mesh_count; i++)
+        {
+            file->Write(encoded_vertices[i].data(), encoded_vertices[i].size());
+            file->Write(encoded_indices[i].data(), encoded_indices[i].size());
+            size_encoded += encoded_vertices[i].size() + encoded_indices[i].size();
+        }
+
+        return size_encoded;
+    }
+
+    bool Mesh::LoadFromFileEncoded(FileStream* file)
+    {
+        if (file->ReadAs<uint32_t>() != model_magic)
+            return false;
+
+        const uint32_t version = file->ReadAs<uint32_t>();
+        if (version != model_version)
+            return false;
+
+        SetResourceFilePath(file->ReadAs<string>());
+        const uint32_t vertex_count   = file->ReadAs<uint32_t>();
+        const uint32_t index_count    = file->ReadAs<uint32_t>();
+        const uint32_t sub_mesh_count = file->ReadAs<uint32_t>();
+
+        // sub-mesh table
+        vector<uint64_t> encoded_vertex_sizes(sub_mesh_count);
+        vector<uint64_t> encoded_index_sizes(sub_mesh_count);
+        m_sub_meshes.resize(sub_mesh_count);
+        for (uint32_t i = 0; i < sub_mesh_count; i++)
+        {
+            file->Read(&m_sub_meshes[i].vertex_offset);
+            file->Read(&m_sub_meshes[i].vertex_count);
+            file->Read(&m_sub_meshes[i].index_offset);
+            file->Read(&m_sub_meshes[i].index_count);
+            file->Read(&encoded_vertex_sizes[i]);
+            file->Read(&encoded_index_sizes[i]);
+        }
+
+        // payload, decoded straight out of the file mapping
+        vector<span<const byte>> encoded_vertices(sub_mesh_count);
+        vector<span<const byte>> encoded_indices(sub_mesh_count);
+        for (uint32_t i = 0; i < sub_mesh_count; i++)
+        {
+            encoded_vertices[i] = file->ReadSpan(encoded_vertex_sizes[i]);
+            encoded_indices[i]  = file->ReadSpan(encoded_index_sizes[i]);
+
+            const SubMesh& sub_mesh = m_sub_meshes[i];
+            bool in_range           = static_cast<uint64_t>(sub_mesh.vertex_offset) + sub_mesh.vertex_count <= vertex_count &&
+                                      static_cast<uint64_t>(sub_mesh.index_offset)  + sub_mesh.index_count  <= index_count;
+            if (!in_range || encoded_vertices[i].size() != encoded_vertex_sizes[i] || encoded_indices[i].size() != encoded_index_sizes[i])
+                return false;
+        }
+
+        m_vertices.resize(vertex_count);
+        m_indices.resize(index_count);
+
+        atomic<bool> success = true;
+        for_each_sub_mesh(sub_mesh_count, [&](uint32_t start, uint32_t end)
+        {
+            for (uint32_t i = start; i < end; i++)
+            {
+                const SubMesh& sub_mesh = m_sub_meshes[i];
+
+                const unsigned char* vertices = reinterpret_cast<const unsigned char*>(encoded_vertices[i].data());
+                if (meshopt_decodeVertexBuffer(m_vertices.data() + sub_mesh.vertex_offset, sub_mesh.vertex_count, sizeof(RHI_Vertex_PosTexNorTan), vertices, encoded_vertices[i].size()) != 0)
+                {
+                    success = false;
+                }
+
+                const unsigned char* indices = reinterpret_cast<const unsigned char*>(encoded_indices[i].data());
+                if (meshopt_decodeIndexBuffer(m_indices.data() + sub_mesh.index_offset, sub_mesh.index_count, sizeof(uint32_t), indices, encoded_indices[i].size()) != 0)
+                {
+                    success = false;
+                }
+            }
+        });
+
+        if (success)
+        {
+            SP_LOG_INFO("Decoded %d sub-meshes, %.1f MB on disk (%.1f MB raw)",
+                sub_mesh_count,
+                static_cast<float>(file->GetSize()) / (1024.0f * 1024.0f),
+                static_cast<float>(GetMemoryUsage()) / (1024.0f * 1024.0f)
+            );
+        }
+
+        return success;
     }
 
     uint32_t Mesh::GetMemoryUsage() const
@@ -169,10 +353,54 @@ namespace spartan
         }
     
         // add
+        m_sub_meshes.push_back({ static_cast<uint32_t>(m_vertices.size()), static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(m_indices.size()), static_cast<uint32_t>(indices.size()) });
         m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
         m_indices.insert(m_indices.end(), indices.begin(), indices.end());
     }
 
+    void Mesh::AddGeometry(vector<vector<RHI_Vertex_PosTexNorTan>>& vertices, vector<vector<uint32_t>>& indices, vector<SubMesh>* sub_meshes_out)
+    {
+        SP_ASSERT(vertices.size() == indices.size());
+        const uint32_t count = static_cast<uint32_t>(vertices.size());
+
+        // optimize each piece on its own
+        if (m_flags & static_cast<uint32_t>(MeshFlags::PostProcessOptimize))
+        {
+            ThreadPool::ParallelForEach([&](uint32_t i)
+            {
+                geometry_processing::optimize(vertices[i], indices[i]);
+            }, count);
+        }
+
+        lock_guard lock(m_mutex);
+
+        // lay the pieces out in the order they were given, so the result doesn't depend on which thread finished first
+        vector<SubMesh> sub_meshes(count);
+        uint64_t vertex_count = m_vertices.size();
+        uint64_t index_count  = m_indices.size();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            sub_meshes[i]  = { static_cast<uint32_t>(vertex_count), static_cast<uint32_t>(vertices[i].size()), static_cast<uint32_t>(index_count), static_cast<uint32_t>(indices[i].size()) };
+            vertex_count  += vertices[i].size();
+            index_count   += indices[i].size();
+        }
+
+        // grow once, then copy in parallel
+        m_vertices.resize(vertex_count);
+        m_indices.resize(index_count);
+        ThreadPool::ParallelForEach([&](uint32_t i)
+        {
+            copy(vertices[i].begin(), vertices[i].end(), m_vertices.begin() + sub_meshes[i].vertex_offset);
+            copy(indices[i].begin(),  indices[i].end(),  m_indices.begin()  + sub_meshes[i].index_offset);
+        }, count);
+
+        m_sub_meshes.insert(m_sub_meshes.end(), sub_meshes.begin(), sub_meshes.end());
+        if (sub_meshes_out)
+        {
+            *sub_meshes_out = move(sub_meshes);
+        }
+    }
+
     uint32_t Mesh::GetVertexCount() const
     {
         return static_cast<uint32_t>(m_vertices.size());
@@ -194,6 +422,8 @@ namespace spartan
 
     void Mesh::CreateGpuBuffers()
     {
+        m_object_size = m_vertices.size() * sizeof(m_vertices[0]) + m_indices.size() * sizeof(m_indices[0]);
+
         m_vertex_buffer = make_shared<RHI_Buffer>(RHI_Buffer_Type::Vertex,
             sizeof(m_vertices[0]),
             static_cast<uint32_t>(m_vertices.size()),
@@ -32,6 +32,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace spartan
 {
+    class FileStream;
+
     enum class MeshFlags : uint32_t
     {
         ImportRemoveRedundantData = 1 << 0,
@@ -41,6 +43,15 @@ namespace spartan
         PostProcessOptimize       = 1 << 4
     };
 
+    // a range of geometry added via AddGeometry(), indices are relative to the vertex offset
+    struct SubMesh
+    {
+        uint32_t vertex_offset = 0;
+        uint32_t vertex_count  = 0;
+        uint32_t index_offset  = 0;
+        uint32_t index_count   = 0;
+    };
+
     enum class MeshType
     {
         Cube,
@@ -77,8 +88,10 @@ namespace spartan
 
         // geometry
         void AddGeometry(std::vector<RHI_Vertex_PosTexNorTan>& vertices, std::vector<uint32_t>& indices, uint32_t* vertex_offset_out = nullptr, uint32_t* index_offset_out = nullptr);
+        void AddGeometry(std::vector<std::vector<RHI_Vertex_PosTexNorTan>>& vertices, std::vector<std::vector<uint32_t>>& indices, std::vector<SubMesh>* sub_meshes_out = nullptr);
         std::vector<RHI_Vertex_PosTexNorTan>& GetVertices() { return m_vertices; }
         std::vector<uint32_t>& GetIndices()                 { return m_indices; }
+        const std::vector<SubMesh>& GetSubMeshes() const    { return m_sub_meshes; }
 
         // get counts
         uint32_t GetVertexCount() const;
@@ -107,10 +120,16 @@ namespace spartan
         void PostProcess();
         void SetMaterial(std::shared_ptr<Material>& material, Entity* entity) const;
 
+        // encoded geometry, the body of a .model file, also embedded in the derived data of imported models
+        uint64_t SaveToFileEncoded(FileStream* file);
+        bool LoadFromFileEncoded(FileStream* file);
+
     private:
+
         // geometry
         std::vector<RHI_Vertex_PosTexNorTan> m_vertices;
         std::vector<uint32_t> m_indices;
+        std::vector<SubMesh> m_sub_meshes;
 
         // gpu buffers
         std::shared_ptr<RHI_Buffer> m_vertex_buffer;
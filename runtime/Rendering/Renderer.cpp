@@ -22,6 +22,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES ===============================
 #include "pch.h"
 #include "Renderer.h"
+#include "TextureStreaming.h"
 #include "ThreadPool.h"
 #include "ProgressTracker.h"
 #include "../Profiling/RenderDoc.h"
@@ -35,6 +36,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../RHI/RHI_Queue.h"
 #include "../RHI/RHI_Implementation.h"
 #include "../RHI/RHI_Buffer.h"
+#include "../RHI/RHI_ShaderCache.h"
 #include "../RHI/RHI_FidelityFX.h"
 #include "../RHI/RHI_OpenImageDenoise.h"
 #include "../World/Entity.h"
@@ -145,6 +147,8 @@ namespace spartan
             }
 
             RHI_Device::Initialize();
+            RHI_ShaderCache::Initialize();
+            TextureStreaming::Initialize();
         }
 
         // set options (after the device has been created since it can clamp values like max shadow resolution etc)
@@ -269,6 +273,7 @@ namespace spartan
         // manually invoke the deconstructors so that ParseDeletionQueue()
         // releases their rhi resources before device destruction
         {
+            TextureStreaming::Shutdown();
             DestroyResources();
 
             m_renderables.clear();
@@ -296,7 +301,9 @@ namespace spartan
             }
 
             RHI_Device::Tick(frame_num);
+            PublishReloadedShaders();
             RHI_FidelityFX::Tick(&m_cb_frame_cpu);
+            TextureStreaming::Tick();
             dynamic_resolution();
         }
 
@@ -929,6 +936,7 @@ namespace spartan
                 properties[index].flags |= material->GetProperty(MaterialProperty::WindAnimation)      ? (1U << 9) : 0;
                 properties[index].flags |= material->GetProperty(MaterialProperty::VertexAnimateWater) ? (1U << 10) : 0;
                 properties[index].flags |= material->IsTessellated()                                   ? (1U << 11) : 0;
+                properties[index].flags |= material->GetProperty(MaterialProperty::IsTerrain)          ? (1U << 12) : 0;
                 // when changing the bit flags, ensure that you also update the Surface struct in common_structs.hlsl, so that it reads those flags as expected
             }
     
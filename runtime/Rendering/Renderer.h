@@ -124,6 +124,10 @@ namespace spartan
         static std::shared_ptr<Mesh>& GetStandardMesh(const MeshType type);
         static std::shared_ptr<Font>& GetFont();
         static std::shared_ptr<Material>& GetStandardMaterial();
+
+        // recompiles (in parallel) the shaders whose include closure has changed on disk, each one is compiled
+        // into a new shader which the existing one takes over at the start of a frame, once it has compiled
+        static void ReloadShaders();
         //=====================================================================================================================
 
     private:
@@ -141,6 +145,7 @@ namespace spartan
         static void CreateStandardMeshes();
         static void CreateStandardTextures();
         static void CreateStandardMaterials();
+        static void PublishReloadedShaders();
 
         // passes - core
         static void ProduceFrame(RHI_CommandList* cmd_list_graphics, RHI_CommandList* cmd_list_compute);
@@ -142,7 +142,10 @@ namespace spartan
         // bindless
         material_textures   = 24,
         material_parameters = 25,
-        light_parameters    = 26
+        light_parameters    = 26,
+
+        // terrain
+        terrain_height = 27
     };
 
     enum class Renderer_BindingsUav
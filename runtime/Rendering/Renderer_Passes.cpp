@@ -22,10 +22,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES ===========================
 #include "pch.h"
 #include "Renderer.h"
+#include "TextureStreaming.h"
 #include "../Profiling/Profiler.h"
 #include "../World/Entity.h"
 #include "../World/Components/Camera.h"
 #include "../World/Components/Light.h"
+#include "../World/Components/Terrain.h"
 #include "../RHI/RHI_CommandList.h"
 #include "../RHI/RHI_Buffer.h"
 #include "../RHI/RHI_Shader.h"
@@ -203,6 +205,33 @@ namespace spartan
                 }
             }
 
+            void request_texture_mips(vector<shared_ptr<Entity>>& renderables)
+            {
+                const RHI_Viewport& viewport  = Renderer::GetViewport();
+                const float screen_area       = max(viewport.width * viewport.height, 1.0f);
+                const Vector3 camera_position = Renderer::GetCamera()->GetEntity()->GetPosition();
+
+                for (shared_ptr<Entity>& entity : renderables)
+                {
+                    shared_ptr<Renderable> renderable = entity->GetComponent<Renderable>();
+                    if (!renderable || renderable->HasFlag(RenderableFlags::OccludedCpu))
+                        continue;
+
+                    // screen extent, when the camera is inside the bounding box (say terrain) the renderable covers the screen
+                    const BoundingBox& box = renderable->GetBoundingBox(BoundingBoxType::Transformed);
+                    float width            = viewport.width;
+                    float height           = viewport.height;
+                    if (!box.Contains(camera_position))
+                    {
+                        Rectangle rectangle = Renderer::GetCamera()->WorldToScreenCoordinates(box);
+                        width               = clamp(rectangle.Width(),  0.0f, viewport.width);
+                        height              = clamp(rectangle.Height(), 0.0f, viewport.height);
+                    }
+
+                    TextureStreaming::Request(renderable->GetMaterial(), max(width, height), (width * height) / screen_area);
+                }
+            }
+
             void remove_false_gpu_occlusion(shared_ptr<Entity>& entity_occludee, vector<shared_ptr<Entity>>& entities)
             {
                 // if this entity is outside of the view frustum, don't bother
@@ -309,7 +338,7 @@ namespace spartan
                     }
 
                     // skip this iteration if we've reached the total number of instances
-                    if (instance_start_index + instance_count >= renderable->GetInstanceCount())
+                    if (instance_start_index + instance_count > renderable->GetInstanceCount())
                         continue;
 
                     if (instance_count > 0)
@@ -338,6 +367,25 @@ namespace spartan
             cmd_list->SetIgnoreClearValues(true);
         }
 
+        void set_terrain_height_map(RHI_CommandList* cmd_list, Entity* entity, Renderable* renderable)
+        {
+            // terrain patches are flat, the vertex shader displaces them using the terrain's height map
+            Material* material = renderable->GetMaterial();
+            if (!material || material->GetProperty(MaterialProperty::IsTerrain) == 0.0f)
+                return;
+
+            if (shared_ptr<Entity> parent = entity->GetParent())
+            {
+                if (shared_ptr<Terrain> terrain = parent->GetComponent<Terrain>())
+                {
+                    if (RHI_Texture* height_map = terrain->GetHeightMapGpu())
+                    {
+                        cmd_list->SetTexture(Renderer_BindingsSrv::terrain_height, height_map);
+                    }
+                }
+            }
+        }
+
         int64_t get_mesh_indices(vector<shared_ptr<Entity>>& renderables, bool is_transparent, bool get_start)
         {
             int64_t index_start, index_end;
@@ -604,6 +652,7 @@ namespace spartan
                         cmd_list->PushConstants(m_pcb_pass_cpu);
                     }
 
+                    set_terrain_height_map(cmd_list, entity.get(), renderable.get());
                     draw_renderable(cmd_list, pso, GetCamera().get(), renderable.get(), light.get(), array_index);
                 }
             }
@@ -621,6 +670,7 @@ namespace spartan
 
         visibility::clear();
         visibility::frustum_cull_and_sort(m_renderables[Renderer_Entity::Mesh]);
+        visibility::request_texture_mips(m_renderables[Renderer_Entity::Mesh]);
 
         if (GetOption<bool>(Renderer_Option::OcclusionCulling))
         {
@@ -727,6 +777,7 @@ namespace spartan
                     cmd_list->BeginOcclusionQuery(entity->GetObjectId());
                 }
 
+                set_terrain_height_map(cmd_list, entity.get(), renderable.get());
                 draw_renderable(cmd_list, pso, GetCamera().get(), renderable.get());
 
                 if (GetOption<bool>(Renderer_Option::OcclusionCulling) && !is_transparent_pass)
@@ -894,6 +945,7 @@ namespace spartan
                 entity->SetMatrixPrevious(m_pcb_pass_cpu.transform);
             }
 
+            set_terrain_height_map(cmd_list, entity.get(), renderable.get());
             draw_renderable(cmd_list, pso, GetCamera().get(), renderable.get());
         }
 
@@ -56,6 +56,7 @@ namespace spartan
         // renderer resources
         array<shared_ptr<RHI_Texture>, static_cast<uint32_t>(Renderer_RenderTarget::max)> render_targets;
         array<shared_ptr<RHI_Shader>,  static_cast<uint32_t>(Renderer_Shader::max)>       shaders;
+        array<shared_ptr<RHI_Shader>,  static_cast<uint32_t>(Renderer_Shader::max)>       shaders_reloading; // compiling in the background, indexed like shaders
         array<shared_ptr<RHI_Sampler>, static_cast<uint32_t>(Renderer_Sampler::Max)>      samplers;
         array<shared_ptr<RHI_Buffer>,  static_cast<uint32_t>(Renderer_Buffer::Max)>       buffers;
 
@@ -470,6 +471,61 @@ namespace spartan
         shader(Renderer_Shader::additive_transparent_c)->Compile(RHI_Shader_Type::Compute, shader_dir + "additive_transparent.hlsl", async);
     }
 
+    void Renderer::ReloadShaders()
+    {
+        // shaders share most of their includes, so the first staleness check reads a modified file
+        // and every other check (for the same file) gets its result from the include cache
+        // frames keep recording with the current shaders, so the recompilation goes into new ones
+        uint32_t reload_count = 0;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(shaders.size()); i++)
+        {
+            shared_ptr<RHI_Shader>& shader = shaders[i];
+            if (!shader || shaders_reloading[i] || !shader->IsStale())
+                continue;
+
+            shared_ptr<RHI_Shader> shader_new = make_shared<RHI_Shader>();
+            shader_new->SetObjectName(shader->GetObjectName());
+            for (const auto& [define, value] : shader->GetDefines())
+            {
+                shader_new->AddDefine(define, value);
+            }
+
+            const bool async = true;
+            shader_new->Compile(shader->GetShaderStage(), shader->GetFilePath(), async, shader->GetVertexType());
+            shaders_reloading[i] = shader_new;
+            reload_count++;
+        }
+
+        if (reload_count != 0)
+        {
+            SP_LOG_INFO("Recompiling %d shaders", reload_count);
+        }
+    }
+
+    void Renderer::PublishReloadedShaders()
+    {
+        // called between frames, the shaders that finished compiling take over the new modules and the old
+        // ones go through the deletion queue (when the new shaders are released), so the gpu is done with them
+        for (uint32_t i = 0; i < static_cast<uint32_t>(shaders.size()); i++)
+        {
+            shared_ptr<RHI_Shader>& shader_new = shaders_reloading[i];
+            if (!shader_new)
+                continue;
+
+            const RHI_ShaderCompilationState state = shader_new->GetCompilationState();
+            if (state == RHI_ShaderCompilationState::Idle || state == RHI_ShaderCompilationState::Compiling)
+                continue;
+
+            // a shader that failed to compile keeps its previous module
+            if (state == RHI_ShaderCompilationState::Succeeded && shaders[i])
+            {
+                shaders[i]->SwapResource(shader_new.get());
+            }
+
+            shader_new = nullptr;
+        }
+    }
+
     void Renderer::CreateFonts()
     {
         // get standard font directory
@@ -590,6 +646,7 @@ namespace spartan
     {
         render_targets.fill(nullptr);
         shaders.fill(nullptr);
+        shaders_reloading.fill(nullptr);
         samplers.fill(nullptr);
         standard_textures.fill(nullptr);
         standard_meshes.fill(nullptr);
@@ -0,0 +1,427 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//= INCLUDES ===========================
+#include "pch.h"
+#include "TextureStreaming.h"
+#include "Material.h"
+#include "../RHI/RHI_Texture.h"
+#include "../RHI/RHI_Device.h"
+#include "../Resource/ResourceCache.h"
+#include "../Core/ThreadPool.h"
+//======================================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    namespace
+    {
+        // bump when the texture container, the mip generation or the compression changes
+        const uint32_t cache_version = 2;
+
+        const uint32_t size_streamable_min      = 512; // smaller textures aren't worth streaming
+        const uint32_t size_mip_tail            = 128; // textures never stream out past the mip that fits in this size
+        const uint64_t frames_until_unused      = 120; // frames without any demand before a texture drops to its mip tail
+        const uint64_t frames_before_stream_out = 60;  // so that textures at the edge of the budget don't thrash
+        const uint32_t jobs_in_flight_max       = 2;
+        const float device_budget_share         = 0.5f;
+
+        struct Entry
+        {
+            uint64_t id                 = 0; // unique per registration, a texture that's freed and reallocated at the same address gets a new one
+            string file_path;
+            uint32_t width              = 0;
+            uint32_t height             = 0;
+            uint32_t mip_count          = 0;
+            uint32_t bits_per_channel   = 0;
+            uint32_t channel_count      = 0;
+            RHI_Format format           = RHI_Format::Max;
+            uint32_t mip_tail           = 0;
+            uint32_t mip_resident       = 0;
+            uint32_t mip_demand         = 0;
+            uint32_t mip_target         = 0;
+            float importance            = 0.0f;
+            uint64_t frame_requested    = 0;
+            uint64_t frame_changed      = 0;
+            bool in_flight              = false;
+        };
+
+        struct Completion
+        {
+            RHI_Texture* texture = nullptr; // only used as a key, it's never dereferenced unless the entry id still matches
+            shared_ptr<RHI_Texture> staging;
+            uint64_t id          = 0;
+        };
+
+        unordered_map<RHI_Texture*, Entry> entries;
+        mutex mutex_entries;
+        vector<Completion> completions;
+        mutex mutex_completions;
+        string directory;
+        atomic<uint64_t> frame          = 0;
+        atomic<uint64_t> id_next        = 0;
+        atomic<uint32_t> jobs_in_flight = 0;
+        atomic<uint64_t> resident_bytes = 0;
+        uint32_t budget_mb              = 0;
+
+        uint64_t compute_size(const Entry& entry, const uint32_t mip_top)
+        {
+            uint64_t size = 0;
+            for (uint32_t mip_index = mip_top; mip_index < entry.mip_count; mip_index++)
+            {
+                const uint32_t width  = max(1u, entry.width  >> mip_index);
+                const uint32_t height = max(1u, entry.height >> mip_index);
+                size += RHI_Texture::CalculateMipSize(width, height, 1, entry.format, entry.bits_per_channel, entry.channel_count);
+            }
+
+            return size;
+        }
+
+        string get_file_path(RHI_Texture* texture)
+        {
+            // engine textures already are a streamable container
+            const string& source = texture->GetResourceFilePath();
+            if (FileSystem::IsEngineTextureFile(source))
+                return source;
+
+            // anything else is written out once, after it has been prepared (mips and compression)
+            error_code error;
+            const auto source_time = filesystem::last_write_time(source, error);
+
+            uint64_t key = hash<string>{}(source);
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(error ? 0 : source_time.time_since_epoch().count()));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(texture->GetWidth()));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(texture->GetHeight()));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(texture->GetFormat()));
+            key          = rhi_hash_combine(key, static_cast<uint64_t>(cache_version));
+
+            char name[17];
+            snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+            return directory + name + EXTENSION_TEXTURE;
+        }
+
+        void clear()
+        {
+            lock_guard<mutex> lock(mutex_entries);
+            entries.clear();
+            resident_bytes = 0;
+        }
+
+        void stream(RHI_Texture* texture, Entry& entry)
+        {
+            entry.in_flight = true;
+            jobs_in_flight++;
+
+            ThreadPool::AddTask([texture, id = entry.id, file_path = entry.file_path, mip_index = entry.mip_target, name = texture->GetObjectName()]()
+            {
+                // the mips are read with positional reads from the container and uploaded as a new resource, which the texture takes over in Tick()
+                shared_ptr<RHI_Texture> staging = make_shared<RHI_Texture>();
+                if (staging->LoadMipsFromFile(file_path, mip_index))
+                {
+                    staging->SetObjectName(name);
+                    staging->SetFlag(RHI_Texture_DontPrepareForGpu, false);
+                    staging->SetFlag(RHI_Texture_KeepData, false);
+                    staging->PrepareForGpu();
+                }
+
+                {
+                    lock_guard<mutex> lock(mutex_completions);
+                    completions.push_back({ texture, staging, id });
+                }
+
+                jobs_in_flight--;
+            });
+        }
+    }
+
+    void TextureStreaming::Initialize()
+    {
+        directory = ResourceCache::GetResourceDirectory(ResourceDirectory::TextureCache) + "\\";
+        if (!FileSystem::Exists(directory))
+        {
+            FileSystem::CreateDirectory(directory);
+        }
+
+        // temporary files can only be leftovers from a crash in the middle of a write
+        error_code error;
+        for (filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+        {
+            error_code entry_error;
+            if (it->is_regular_file(entry_error) && it->path().extension().string().starts_with(".tmp"))
+            {
+                filesystem::remove(it->path(), entry_error);
+            }
+        }
+
+        SP_SUBSCRIBE_TO_EVENT(EventType::WorldClear, SP_EVENT_HANDLER_STATIC(clear));
+    }
+
+    void TextureStreaming::Shutdown()
+    {
+        while (jobs_in_flight > 0)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+
+        {
+            lock_guard<mutex> lock(mutex_completions);
+            completions.clear();
+        }
+
+        clear();
+    }
+
+    void TextureStreaming::Tick()
+    {
+        frame++;
+
+        // take over the resources of the textures that finished streaming
+        // note: completed is declared before the lock, so the staging textures (and the old resources) are released after it
+        vector<Completion> completed;
+        {
+            lock_guard<mutex> lock(mutex_completions);
+            completed.swap(completions);
+        }
+
+        lock_guard<mutex> lock(mutex_entries);
+
+        bool resources_changed = false;
+        for (Completion& completion : completed)
+        {
+            // the texture may have been unregistered, or freed and another one registered at the same address, since the job started
+            auto it = entries.find(completion.texture);
+            if (it == entries.end() || it->second.id != completion.id)
+                continue;
+
+            Entry& entry    = it->second;
+            entry.in_flight = false;
+
+            if (completion.staging->GetRhiResource() && completion.staging->GetFormat() == entry.format)
+            {
+                entry.mip_resident  = completion.staging->GetMipIndexTop();
+                entry.frame_changed = frame;
+                completion.texture->SwapResource(completion.staging.get());
+                resources_changed   = true;
+            }
+        }
+
+        if (resources_changed)
+        {
+            SP_FIRE_EVENT(EventType::MaterialOnChanged);
+        }
+
+        // target mips, what's visible asks for the mip that matches its screen size and what isn't drops to the mip tail
+        vector<pair<RHI_Texture*, Entry*>> sorted;
+        sorted.reserve(entries.size());
+        uint64_t size_target   = 0;
+        uint64_t size_resident = 0;
+        for (auto& [texture, entry] : entries)
+        {
+            const bool is_used = frame - entry.frame_requested <= frames_until_unused;
+            entry.mip_target   = is_used ? min(entry.mip_demand, entry.mip_tail) : entry.mip_tail;
+            entry.importance   = is_used ? entry.importance : 0.0f;
+            size_target       += compute_size(entry, entry.mip_target);
+            size_resident     += compute_size(entry, entry.mip_resident);
+            sorted.emplace_back(texture, &entry);
+        }
+        resident_bytes = size_resident;
+
+        // least important first
+        sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second->importance < b.second->importance; });
+
+        // over budget, drop one mip at a time starting from the least important textures
+        const uint64_t budget_bytes = static_cast<uint64_t>(GetBudgetMb()) * 1024 * 1024;
+        bool dropped = true;
+        while (size_target > budget_bytes && dropped)
+        {
+            dropped = false;
+            for (auto& [texture, entry] : sorted)
+            {
+                if (size_target <= budget_bytes)
+                    break;
+
+                if (entry->mip_target < entry->mip_tail)
+                {
+                    size_target -= compute_size(*entry, entry->mip_target) - compute_size(*entry, entry->mip_target + 1);
+                    entry->mip_target++;
+                    dropped = true;
+                }
+            }
+        }
+
+        // stream out first, so that memory is freed for what streams in, least important first
+        for (auto& [texture, entry] : sorted)
+        {
+            if (jobs_in_flight >= jobs_in_flight_max)
+                return;
+
+            if (!entry->in_flight && entry->mip_target > entry->mip_resident && frame - entry->frame_changed > frames_before_stream_out)
+            {
+                stream(texture, *entry);
+            }
+        }
+
+        // stream in, most important first
+        for (auto it = sorted.rbegin(); it != sorted.rend(); it++)
+        {
+            if (jobs_in_flight >= jobs_in_flight_max)
+                return;
+
+            if (!it->second->in_flight && it->second->mip_target < it->second->mip_resident)
+            {
+                stream(it->first, *it->second);
+            }
+        }
+    }
+
+    bool TextureStreaming::IsStreamable(RHI_Texture* texture)
+    {
+        if (!texture || directory.empty())
+            return false;
+
+        const uint32_t flags = texture->GetFlags();
+        if ((flags & RHI_Texture_Thumbnail) || (flags & RHI_Texture_KeepData) || texture->IsUav() || texture->IsRt())
+            return false;
+
+        if (texture->GetType() != RHI_Texture_Type::Type2D || texture->GetDepth() != 1 || texture->GetMipIndexTop() != 0)
+            return false;
+
+        if (max(texture->GetWidth(), texture->GetHeight()) < size_streamable_min)
+            return false;
+
+        return texture->IsMaterialTexture() || FileSystem::IsEngineTextureFile(texture->GetResourceFilePath());
+    }
+
+    void TextureStreaming::Register(RHI_Texture* texture)
+    {
+        SP_ASSERT(texture != nullptr);
+
+        // the data was only kept so that the full mip chain could be written to the drive
+        texture->SetFlag(RHI_Texture_KeepData, false);
+
+        Entry entry;
+        entry.id               = ++id_next;
+        entry.file_path        = get_file_path(texture);
+        entry.width            = texture->GetWidth();
+        entry.height           = texture->GetHeight();
+        entry.mip_count        = texture->GetMipCount();
+        entry.bits_per_channel = texture->GetBitsPerChannel();
+        entry.channel_count    = texture->GetChannelCount();
+        entry.format           = texture->GetFormat();
+        entry.frame_requested  = frame;
+        entry.frame_changed    = frame;
+
+        // the mip tail is the largest mip that fits in the tail size, it's always resident
+        while (entry.mip_tail + 1 < entry.mip_count && max(entry.width >> entry.mip_tail, entry.height >> entry.mip_tail) > size_mip_tail)
+        {
+            entry.mip_tail++;
+        }
+
+        // write the full chain out, to a temporary file first so that a crash can't leave a truncated one behind
+        // the name is unique per registration, so that two writers of the same texture can't clobber each other
+        if (!FileSystem::Exists(entry.file_path) && texture->HasData())
+        {
+            const string file_path_temp = entry.file_path + ".tmp" + to_string(entry.id);
+            texture->SaveToFile(file_path_temp);
+            if (!FileSystem::MoveFileFromTo(file_path_temp, entry.file_path))
+            {
+                FileSystem::Delete(file_path_temp);
+            }
+        }
+        texture->ClearData();
+
+        if (entry.mip_count <= 1 || !FileSystem::Exists(entry.file_path))
+            return;
+
+        lock_guard<mutex> lock(mutex_entries);
+        entries[texture] = entry;
+    }
+
+    void TextureStreaming::Unregister(RHI_Texture* texture)
+    {
+        // any job in flight for the texture is discarded when it completes, since the entry (and its id) is gone
+        lock_guard<mutex> lock(mutex_entries);
+        entries.erase(texture);
+    }
+
+    void TextureStreaming::Request(Material* material, const float screen_size, const float importance)
+    {
+        if (!material)
+            return;
+
+        // uvs are assumed to span the renderable once per tile, so tiling raises the texel density that's needed
+        const float tiling = max(max(fabs(material->GetProperty(MaterialProperty::TextureTilingX)), fabs(material->GetProperty(MaterialProperty::TextureTilingY))), 0.01f);
+
+        lock_guard<mutex> lock(mutex_entries);
+        if (entries.empty())
+            return;
+
+        for (uint32_t type = 0; type < static_cast<uint32_t>(MaterialTextureType::Max); type++)
+        {
+            for (uint8_t slot = 0; slot < Material::slots_per_texture_type; slot++)
+            {
+                RHI_Texture* texture = material->GetTexture(static_cast<MaterialTextureType>(type), slot);
+                if (!texture)
+                    continue;
+
+                auto it = entries.find(texture);
+                if (it == entries.end())
+                    continue;
+
+                // one texel per pixel
+                Entry& entry         = it->second;
+                const float texels   = static_cast<float>(max(entry.width, entry.height)) * tiling;
+                const float ratio    = texels / max(screen_size, 1.0f);
+                const uint32_t mip   = ratio > 1.0f ? min(static_cast<uint32_t>(log2(ratio)), entry.mip_count - 1) : 0;
+
+                if (entry.frame_requested != frame)
+                {
+                    entry.mip_demand      = mip;
+                    entry.importance      = importance;
+                    entry.frame_requested = frame;
+                }
+                else
+                {
+                    entry.mip_demand = min(entry.mip_demand, mip);
+                    entry.importance = max(entry.importance, importance);
+                }
+            }
+        }
+    }
+
+    void TextureStreaming::SetBudgetMb(const uint32_t budget)
+    {
+        budget_mb = budget;
+    }
+
+    uint32_t TextureStreaming::GetBudgetMb()
+    {
+        return budget_mb != 0 ? budget_mb : static_cast<uint32_t>(static_cast<float>(RHI_Device::MemoryGetBudgetMb()) * device_budget_share);
+    }
+
+    uint32_t TextureStreaming::GetResidentMb()
+    {
+        return static_cast<uint32_t>(resident_bytes / (1024 * 1024));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+//= INCLUDES ==========
+#include <cstdint>
+//=====================
+
+namespace spartan
+{
+    class RHI_Texture;
+    class Material;
+
+    // streams the mips of material textures in and out of gpu memory, the full mip chains live
+    // on the drive and residency follows the screen size of what's visible, within a memory budget
+    class TextureStreaming
+    {
+    public:
+        static void Initialize();
+        static void Shutdown();
+        static void Tick();
+
+        // registration, happens once a material texture is prepared and its full mip chain is still in memory
+        static bool IsStreamable(RHI_Texture* texture);
+        static void Register(RHI_Texture* texture);
+        static void Unregister(RHI_Texture* texture);
+
+        // demand, screen_size is the renderable's screen extent in pixels and importance its share of the screen
+        static void Request(Material* material, const float screen_size, const float importance);
+
+        // budget, zero means a share of the device's memory budget
+        static void SetBudgetMb(const uint32_t budget_mb);
+        static uint32_t GetBudgetMb();
+        static uint32_t GetResidentMb();
+    };
+}
@@ -0,0 +1,178 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+//= INCLUDES =======================
+#include "pch.h"
+#include "DerivedDataCache.h"
+#include "ResourceCache.h"
+#include "../IO/FileStream.h"
+#include "../IO/DiskCache.h"
+#include "../RHI/RHI_Definitions.h"
+//==================================
+
+//= NAMESPACES =====
+using namespace std;
+//==================
+
+namespace spartan
+{
+    namespace
+    {
+        // entries written by a different engine version are never found, they age out through eviction
+        const uint32_t engine_version = (sp_info::version_major << 16) | (sp_info::version_minor << 8) | sp_info::version_revision;
+        DiskCache cache(".ddc", 8192);
+
+
+        uint64_t hash_bytes(const byte* data, const uint64_t size)
+        {
+            const uint64_t prime_a = 0x9E3779B185EBCA87ull;
+            const uint64_t prime_b = 0xC2B2AE3D27D4EB4Full;
+
+            auto mix = [&](uint64_t lane, const uint64_t word)
+            {
+                lane ^= word * prime_b;
+                lane  = rotl(lane, 31);
+                return lane * prime_a;
+            };
+
+            auto read_word = [](const byte* bytes)
+            {
+                uint64_t word;
+                memcpy(&word, bytes, sizeof(word));
+                return word;
+            };
+
+            // four independent lanes so that the multiplications of consecutive words overlap
+            uint64_t lanes[4] = { prime_a, prime_b, prime_a ^ prime_b, ~prime_a };
+            uint64_t i        = 0;
+            for (; i + 32 <= size; i += 32)
+            {
+                lanes[0] = mix(lanes[0], read_word(data + i + 0));
+                lanes[1] = mix(lanes[1], read_word(data + i + 8));
+                lanes[2] = mix(lanes[2], read_word(data + i + 16));
+                lanes[3] = mix(lanes[3], read_word(data + i + 24));
+            }
+
+            uint64_t hash = size * prime_a;
+            for (uint64_t lane : lanes)
+            {
+                hash = mix(hash, lane);
+            }
+
+            // tail
+            for (; i + 8 <= size; i += 8)
+            {
+                hash = mix(hash, read_word(data + i));
+            }
+            for (; i < size; i++)
+            {
+                hash = mix(hash, static_cast<uint64_t>(data[i]));
+            }
+
+            // avalanche
+            hash ^= hash >> 33;
+            hash *= prime_b;
+            hash ^= hash >> 29;
+            hash *= prime_a;
+            hash ^= hash >> 32;
+
+            return hash;
+        }
+    }
+
+    void DerivedDataCache::Initialize()
+    {
+        cache.Initialize(ResourceCache::GetResourceDirectory(ResourceDirectory::DerivedData));
+    }
+
+    uint64_t DerivedDataCache::HashFile(const string& file_path)
+    {
+        FileStream file(file_path, FileStream_Read);
+        if (!file.IsOpen())
+            return 0;
+
+        // the file is mapped, so this hashes straight out of the page cache
+        span<const byte> bytes = file.ReadSpan(file.GetSize());
+        return hash_bytes(bytes.data(), bytes.size());
+    }
+
+    uint64_t DerivedDataCache::HashBytes(const void* data, const uint64_t size)
+    {
+        return hash_bytes(static_cast<const byte*>(data), size);
+    }
+
+    string DerivedDataCache::GetFilePath(const uint64_t key)
+    {
+        return cache.GetFilePath(rhi_hash_combine(key, engine_version));
+    }
+
+    bool DerivedDataCache::Exists(const uint64_t key)
+    {
+        if (!cache.IsInitialized() || key == 0)
+            return false;
+
+        const uint64_t key_versioned = rhi_hash_combine(key, engine_version);
+        if (!cache.Exists(key_versioned))
+            return false;
+
+        cache.Touch(key_versioned);
+
+        return true;
+    }
+
+    string DerivedDataCache::GetFilePathTemp(const uint64_t key)
+    {
+        return cache.GetFilePathTemp(rhi_hash_combine(key, engine_version));
+    }
+
+    bool DerivedDataCache::Commit(const uint64_t key, const string& file_path_temp)
+    {
+        if (!cache.IsInitialized() || key == 0)
+        {
+            FileSystem::Delete(file_path_temp);
+            return false;
+        }
+
+        return cache.Commit(rhi_hash_combine(key, engine_version), file_path_temp);
+    }
+
+    void DerivedDataCache::Invalidate(const uint64_t key)
+    {
+        SP_LOG_WARNING("Derived data entry %016llx is invalid, it will be rebuilt", static_cast<unsigned long long>(key));
+        cache.Remove(rhi_hash_combine(key, engine_version));
+    }
+
+    void DerivedDataCache::SetBudgetMb(const uint64_t budget_mb)
+    {
+        cache.SetBudgetMb(budget_mb);
+    }
+
+    uint64_t DerivedDataCache::GetBudgetMb()
+    {
+        return cache.GetBudgetMb();
+    }
+
+    uint64_t DerivedDataCache::GetSizeMb()
+    {
+        return cache.GetSizeMb();
+    }
+}
@@ -0,0 +1,61 @@
+/*
+Copyright(c) 2016-2025 Panos Karabelas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+//= INCLUDES =====
+#include <string>
+//================
+
+namespace spartan
+{
+    // content addressed on-disk cache of importer outputs (processed geometry, scene hierarchies, materials,
+    // decoded and prepared images), so that importing an unchanged asset again skips assimp and freeimage
+    class DerivedDataCache
+    {
+    public:
+        static void Initialize();
+
+        // hash of a file's content, importers combine it with whatever else affects their output to form a key
+        static uint64_t HashFile(const std::string& file_path);
+
+        // hash of data which doesn't come from a file (e.g. generated or already loaded geometry)
+        static uint64_t HashBytes(const void* data, const uint64_t size);
+
+        // the path of an entry, it exists only if the entry has been committed
+        static std::string GetFilePath(const uint64_t key);
+        static bool Exists(const uint64_t key);
+
+        // entries are written to a temporary file which is then renamed into place, so readers never see a partial entry,
+        // each call returns a unique temporary path which is passed back to commit (from any thread)
+        static std::string GetFilePathTemp(const uint64_t key);
+        static bool Commit(const uint64_t key, const std::string& file_path_temp);
+
+        // removes an entry which failed to load (truncated, or written by an older layout)
+        static void Invalidate(const uint64_t key);
+
+        // budget, the least recently used entries are evicted when exceeded
+        static void SetBudgetMb(const uint64_t budget_mb);
+        static uint64_t GetBudgetMb();
+        static uint64_t GetSizeMb();
+    };
+}
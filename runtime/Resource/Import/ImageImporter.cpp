@@ -23,6 +23,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pch.h"
 #include "ImageImporter.h"
 #include "../../RHI/RHI_Texture.h"
+#include "../../Core/ThreadPool.h"
 SP_WARNINGS_OFF
 #define FREEIMAGE_LIB
 #include <FreeImage/FreeImage.h>
@@ -88,44 +89,6 @@ namespace spartan
             return false;
         }
 
-        uint32_t get_bits_per_channel(FIBITMAP* bitmap)
-        {
-            SP_ASSERT(bitmap != nullptr);
-        
-            const FREE_IMAGE_TYPE type = FreeImage_GetImageType(bitmap);
-            uint32_t size = 0;
-        
-            if (type == FIT_BITMAP)
-            {
-                size = sizeof(BYTE);
-            }
-            else if (type == FIT_UINT16 || type == FIT_RGB16 || type == FIT_RGBA16)
-            {
-                size = sizeof(WORD);
-            }
-            else if (type == FIT_FLOAT || type == FIT_RGBF || type == FIT_RGBAF)
-            {
-                size = sizeof(float);
-            }
-
-            SP_ASSERT(size != 0);
-
-            return size * 8;
-        }
-
-        uint32_t get_channel_count(FIBITMAP* bitmap)
-        {
-            SP_ASSERT(bitmap != nullptr);
-
-            const uint32_t bits_per_pixel   = FreeImage_GetBPP(bitmap);
-            const uint32_t bits_per_channel = get_bits_per_channel(bitmap);
-            const uint32_t channel_count    = bits_per_pixel / bits_per_channel;
-
-            SP_ASSERT(channel_count != 0);
-        
-            return channel_count;
-        }
-
         RHI_Format get_rhi_format(const uint32_t bits_per_channel, const uint32_t channel_count)
         {
             SP_ASSERT(bits_per_channel != 0);
@@ -179,22 +142,6 @@ namespace spartan
             return format;
         }
 
-        // converts a bitmap to 8 bits. If the bitmap was a high-color bitmap (16, 24 or 32-bit) or
-        // if it was a monochrome or greyscale bitmap (1 or 4-bit), the end result will be a greyscale
-        // bitmap, otherwise (1 or 4-bit palletized bitmaps) it will be a palletized bitmap
-        FIBITMAP* convert_to_8bits(FIBITMAP* bitmap)
-        {
-            SP_ASSERT(bitmap != nullptr);
-
-            FIBITMAP* previous_bitmap = bitmap;
-            bitmap = FreeImage_ConvertTo8Bits(previous_bitmap);
-            FreeImage_Unload(previous_bitmap);
-
-            SP_ASSERT(bitmap != nullptr);
-
-            return bitmap;
-        }
-
         FIBITMAP* convert_to_32bits(FIBITMAP* bitmap)
         {
             SP_ASSERT(bitmap != nullptr);
@@ -227,63 +174,33 @@ namespace spartan
             return bitmap;
         }
 
+        // the layouts which the conversion kernels below read directly, anything else goes through freeimage first
         FIBITMAP* apply_bitmap_corrections(FIBITMAP* bitmap)
         {
             SP_ASSERT(bitmap != nullptr);
-        
-            // convert to a standard bitmap. FIT_UINT16 and FIT_RGBA16 are processed without errors
-            // but show up empty in the editor. For now, we convert everything to a standard bitmap
+
             const FREE_IMAGE_TYPE type = FreeImage_GetImageType(bitmap);
+            if (type == FIT_UINT16 || type == FIT_RGB16 || type == FIT_RGBA16 || type == FIT_RGBF || type == FIT_RGBAF)
+                return bitmap;
+
+            // greyscale float images, complex numbers etc. are converted to a standard bitmap
             if (type != FIT_BITMAP)
             {
-                // FreeImage can't convert FIT_RGBF
-                if (type != FIT_RGBF)
-                {
-                    const auto previous_bitmap = bitmap;
-                    bitmap = FreeImage_ConvertToType(bitmap, FIT_BITMAP);
-                    FreeImage_Unload(previous_bitmap);
-                }
-            }
+                FIBITMAP* previous_bitmap = bitmap;
+                bitmap = FreeImage_ConvertToType(previous_bitmap, FIT_BITMAP);
+                FreeImage_Unload(previous_bitmap);
 
-            // textures with few colors (typically less than 8 bits) and/or a palette color type, get converted to an R8G8B8A8
-            // this is because get_channel_count() returns a single channel, and from there many issues start to occur
-            if (FreeImage_GetColorsUsed(bitmap) <= 256 && FreeImage_GetColorType(bitmap) != FIC_RGB)
-            {
-                bitmap = convert_to_32bits(bitmap);
+                if (!bitmap)
+                    return nullptr;
             }
 
-            // textures with 3 channels and 8 bit per channel get converted to an R8G8B8A8 format
-            // this is because there is no such RHI_FORMAT format
-            if (get_channel_count(bitmap) == 3 && get_bits_per_channel(bitmap) == 8)
+            // palettized, greyscale and 16-bit bitmaps are expanded to 32 bits
+            const uint32_t bits_per_pixel = FreeImage_GetBPP(bitmap);
+            if (bits_per_pixel != 24 && bits_per_pixel != 32)
             {
                 bitmap = convert_to_32bits(bitmap);
             }
-        
-            // most GPUs can't use a 32 bit RGB texture as a color attachment
-            // vulkan tells you, your GPU doesn't support it
-            // So to prevent that, we maintain the 32 bits and convert to an RGBA format
-            if (get_channel_count(bitmap) == 3 && get_bits_per_channel(bitmap) == 32)
-            {
-                FIBITMAP* previous_bitmap = bitmap;
-                bitmap = FreeImage_ConvertToRGBAF(bitmap);
-                FreeImage_Unload(previous_bitmap);
-            }
-        
-            // Convert BGR to RGB (if needed)
-            if (FreeImage_GetBPP(bitmap) == 32)
-            {
-                if (FreeImage_GetRedMask(bitmap) == 0xff0000 && get_channel_count(bitmap) >= 2)
-                {
-                    if (!SwapRedBlue32(bitmap))
-                    {
-                        SP_LOG_ERROR("Failed to swap red with blue channel");
-                    }
-                }
-            }
 
-            // FreeImage loads images upside down, so flip it
-            FreeImage_FlipVertical(bitmap);
-        
             return bitmap;
         }
 
@@ -295,205 +212,459 @@ namespace spartan
             SP_LOG_ERROR("%s, Format: %s", text, format);
         };
 
-        bool has_transparent_pixels(FIBITMAP* bitmap)
+        // scanline conversion kernels, they write rgba8, rgba16 or rgba32f and return 255 if all alpha values are opaque,
+        // freeimage stores 24 and 32-bit bitmaps in the platform's byte order, which the FI_RGBA_* offsets describe
+        namespace conversion
         {
-            // Check if the bitmap supports alpha channel
-            FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(bitmap);
-            int bpp = FreeImage_GetBPP(bitmap);
-        
-            if (image_type == FIT_BITMAP && (bpp == 32 || bpp == 24)) 
+            uint8_t bgra8_to_rgba8(const uint8_t* source, uint8_t* destination, const uint32_t width)
             {
-                if (bpp == 32) // Direct check for alpha channel
+                uint8_t alpha = 255;
+                uint32_t x    = 0;
+
+                #if defined(__AVX2__)
+                const __m256i shuffle = _mm256_setr_epi8(
+                    FI_RGBA_RED,      FI_RGBA_GREEN,      FI_RGBA_BLUE,      FI_RGBA_ALPHA,
+                    FI_RGBA_RED + 4,  FI_RGBA_GREEN + 4,  FI_RGBA_BLUE + 4,  FI_RGBA_ALPHA + 4,
+                    FI_RGBA_RED + 8,  FI_RGBA_GREEN + 8,  FI_RGBA_BLUE + 8,  FI_RGBA_ALPHA + 8,
+                    FI_RGBA_RED + 12, FI_RGBA_GREEN + 12, FI_RGBA_BLUE + 12, FI_RGBA_ALPHA + 12,
+                    FI_RGBA_RED,      FI_RGBA_GREEN,      FI_RGBA_BLUE,      FI_RGBA_ALPHA,
+                    FI_RGBA_RED + 4,  FI_RGBA_GREEN + 4,  FI_RGBA_BLUE + 4,  FI_RGBA_ALPHA + 4,
+                    FI_RGBA_RED + 8,  FI_RGBA_GREEN + 8,  FI_RGBA_BLUE + 8,  FI_RGBA_ALPHA + 8,
+                    FI_RGBA_RED + 12, FI_RGBA_GREEN + 12, FI_RGBA_BLUE + 12, FI_RGBA_ALPHA + 12
+                );
+
+                __m256i texels_and = _mm256_set1_epi8(-1);
+                for (; x + 8 <= width; x += 8)
                 {
-                    for (unsigned y = 0; y < FreeImage_GetHeight(bitmap); ++y)
-                    {
-                        BYTE* bits = FreeImage_GetScanLine(bitmap, y);
-                        for (unsigned x = 0; x < FreeImage_GetWidth(bitmap); ++x)
-                        {
-                            BYTE alpha = bits[FI_RGBA_ALPHA];
-                            if (alpha != 255)
-                                return true;
-        
-                            bits += 4; // move to the next pixel (4 bytes per pixel for 32-bit)
-                        }
-                    }
+                    const __m256i texels = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * 4)), shuffle);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x * 4), texels);
+                    texels_and = _mm256_and_si256(texels_and, texels);
                 }
-                else if (bpp == 24) // For 24-bit, we need to check if there's a transparency mask
+
+                alignas(32) uint8_t lanes[32];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), texels_and);
+                for (uint32_t i = 3; i < 32; i += 4)
                 {
-                    // If there's a transparency mask, we'll check it
-                    if (FreeImage_GetTransparencyCount(bitmap) > 0)
-                    {
-                        for (unsigned i = 0; i < FreeImage_GetTransparencyCount(bitmap); ++i)
-                        {
-                            if (FreeImage_GetTransparencyTable(bitmap)[i] != 255)
-                                return true;
-                        }
-                    }
-                    // If no transparency mask, 24-bit images are assumed to be fully opaque
+                    alpha &= lanes[i];
+                }
+                #endif
+
+                for (; x < width; x++)
+                {
+                    const uint8_t* texel = source + x * 4;
+                    destination[x * 4 + 0] = texel[FI_RGBA_RED];
+                    destination[x * 4 + 1] = texel[FI_RGBA_GREEN];
+                    destination[x * 4 + 2] = texel[FI_RGBA_BLUE];
+                    destination[x * 4 + 3] = texel[FI_RGBA_ALPHA];
+                    alpha                 &= texel[FI_RGBA_ALPHA];
                 }
+
+                return alpha;
             }
-            else if (image_type == FIT_RGBA16) // 16-bit per channel, including alpha
+
+            uint8_t bgr8_to_rgba8(const uint8_t* source, uint8_t* destination, const uint32_t width)
             {
-                // For 64-bit or other formats with explicit alpha
-                for (unsigned y = 0; y < FreeImage_GetHeight(bitmap); ++y)
+                uint32_t x = 0;
+
+                #if defined(__AVX2__)
+                const __m128i shuffle = _mm_setr_epi8(
+                    FI_RGBA_RED,     FI_RGBA_GREEN,     FI_RGBA_BLUE,     -128,
+                    FI_RGBA_RED + 3, FI_RGBA_GREEN + 3, FI_RGBA_BLUE + 3, -128,
+                    FI_RGBA_RED + 6, FI_RGBA_GREEN + 6, FI_RGBA_BLUE + 6, -128,
+                    FI_RGBA_RED + 9, FI_RGBA_GREEN + 9, FI_RGBA_BLUE + 9, -128
+                );
+                const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(0xFF000000));
+
+                // 4 texels per iteration read 16 bytes of which 12 are used, so stop early enough to stay inside the scanline
+                for (; x + 6 <= width; x += 4)
                 {
-                    WORD* bits = (WORD*)FreeImage_GetScanLine(bitmap, y);
-                    for (unsigned x = 0; x < FreeImage_GetWidth(bitmap); ++x)
-                    {
-                        WORD alpha = bits[3]; // Assuming RGBA order, alpha at index 3
-                        if (alpha != 0xFFFF) // 16-bit alpha, 0xFFFF is fully opaque
-                            return true;
-        
-                        bits += 4; // move to next pixel (4 words for RGBA16)
-                    }
+                    const __m128i texels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 3)), shuffle);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4), _mm_or_si128(texels, alpha));
+                }
+                #endif
+
+                for (; x < width; x++)
+                {
+                    const uint8_t* texel = source + x * 3;
+                    destination[x * 4 + 0] = texel[FI_RGBA_RED];
+                    destination[x * 4 + 1] = texel[FI_RGBA_GREEN];
+                    destination[x * 4 + 2] = texel[FI_RGBA_BLUE];
+                    destination[x * 4 + 3] = 255;
                 }
+
+                return 255;
             }
-            // Other formats might not have transparency or are treated as fully opaque
-        
-            return false;
-        }
-    }
 
-    void ImageImporter::Initialize()
-    {
-        FreeImage_Initialise();
-        FreeImage_SetOutputMessage(free_image_error_handler);
-        Settings::RegisterThirdPartyLib("FreeImage", FreeImage_GetVersion(), "https://freeimage.sourceforge.io/");
-    }
+            // 16-bit color keeps its precision as rgba16, a quarter of the memory that floats would take
+            uint8_t rgba16_to_rgba16(const uint16_t* source, uint16_t* destination, const uint32_t width)
+            {
+                uint16_t alpha = 0xFFFF;
+                uint32_t x     = 0;
 
-    void ImageImporter::Shutdown()
-    {
-        FreeImage_DeInitialise();
-    }
+                #if defined(__AVX2__)
+                __m256i texels_and = _mm256_set1_epi16(-1);
+                for (; x + 4 <= width; x += 4)
+                {
+                    const __m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * 4));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x * 4), texels);
+                    texels_and = _mm256_and_si256(texels_and, texels);
+                }
 
-    void ImageImporter::Load(const string& file_path, const uint32_t slice_index, RHI_Texture* texture)
-    {
-        SP_ASSERT(texture != nullptr);
+                alignas(32) uint16_t lanes[16];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), texels_and);
+                for (uint32_t i = 3; i < 16; i += 4)
+                {
+                    alpha &= lanes[i];
+                }
+                #endif
 
-        if (!FileSystem::Exists(file_path))
-        {
-            SP_LOG_ERROR("Path \"%s\" is invalid.", file_path.c_str());
-            return;
-        }
+                for (; x < width; x++)
+                {
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        destination[x * 4 + c] = source[x * 4 + c];
+                    }
+                    alpha &= source[x * 4 + 3];
+                }
 
-        // acquire image format
-        FREE_IMAGE_FORMAT format = FIF_UNKNOWN;
-        {
-            format = FreeImage_GetFileType(file_path.c_str(), 0);
+                return alpha == 0xFFFF ? 255 : 0;
+            }
 
-            // if the format is unknown, try to work it out from the file path
-            if (format == FIF_UNKNOWN)
+            uint8_t rgb16_to_rgba16(const uint16_t* source, uint16_t* destination, const uint32_t width)
             {
-                format = FreeImage_GetFIFFromFilename(file_path.c_str());
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    destination[x * 4 + 0] = source[x * 3 + 0];
+                    destination[x * 4 + 1] = source[x * 3 + 1];
+                    destination[x * 4 + 2] = source[x * 3 + 2];
+                    destination[x * 4 + 3] = 0xFFFF;
+                }
+
+                return 255;
             }
 
-            // if the format is still unknown, give up
-            if (!FreeImage_FIFSupportsReading(format)) 
+            // 16-bit greyscale is height data more often than not, it's normalized to floats so that its precision survives
+            uint8_t grey16_to_rgba32f(const uint16_t* source, float* destination, const uint32_t width)
             {
-                SP_LOG_ERROR("Unsupported format");
-                return;
+                const float scale = 1.0f / 65535.0f;
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    const float value      = static_cast<float>(source[x]) * scale;
+                    destination[x * 4 + 0] = value;
+                    destination[x * 4 + 1] = value;
+                    destination[x * 4 + 2] = value;
+                    destination[x * 4 + 3] = 1.0f;
+                }
+
+                return 255;
+            }
+
+            // most gpus can't sample (or render to) 96-bit rgb, so float images get an alpha channel
+            void rgb32f_to_rgba32f(const float* source, float* destination, const uint32_t width)
+            {
+                uint32_t x = 0;
+
+                #if defined(__AVX2__)
+                const __m128 one = _mm_set1_ps(1.0f);
+
+                // a texel is read as 4 floats, so the last one is done by the scalar loop to stay inside the scanline
+                for (; x + 2 <= width; x++)
+                {
+                    _mm_storeu_ps(destination + x * 4, _mm_blend_ps(_mm_loadu_ps(source + x * 3), one, 0b1000));
+                }
+                #endif
+
+                for (; x < width; x++)
+                {
+                    destination[x * 4 + 0] = source[x * 3 + 0];
+                    destination[x * 4 + 1] = source[x * 3 + 1];
+                    destination[x * 4 + 2] = source[x * 3 + 2];
+                    destination[x * 4 + 3] = 1.0f;
+                }
             }
         }
 
-        uint32_t texture_flags = texture->GetFlags();
+        // an image decoded without touching the texture, so that several images can be decoded at the same time
+        struct DecodedImage
+        {
+            uint32_t width            = 0;
+            uint32_t height           = 0;
+            uint32_t bits_per_channel = 0;
+            uint32_t channel_count    = 0;
+            RHI_Format format         = RHI_Format::Max;
+            uint32_t flags            = 0; // greyscale, srgb and transparent
+            vector<vector<byte>> mips;
+        };
 
-        // freeimage partially supports dds, they are certain configurations that it can't load
-        // So in the case of a dds format in general, we don't rely on freeimage
-        if (format == FIF_DDS)
+        // freeimage partially supports dds, there are certain configurations that it can't load, so for dds we don't rely on it
+        bool decode_dds(const string& file_path, DecodedImage& image)
         {
-            // load
             tinyddsloader::DDSFile dds_file;
-            auto result = dds_file.Load(file_path.c_str());
-            if (result != tinyddsloader::Success)
+            if (dds_file.Load(file_path.c_str()) != tinyddsloader::Success)
             {
                 SP_LOG_ERROR("Failed to load DSS file");
-                return;
+                return false;
             }
 
             // get format
             auto format_dxgi = dds_file.GetFormat();
-            RHI_Format format = RHI_Format::Max;
             if (format_dxgi == tinyddsloader::DDSFile::DXGIFormat::BC1_UNorm)
             {
-                format = RHI_Format::BC1_Unorm;
+                image.format = RHI_Format::BC1_Unorm;
             }
             else if (format_dxgi == tinyddsloader::DDSFile::DXGIFormat::BC3_UNorm)
             {
-                format = RHI_Format::BC3_Unorm;
+                image.format = RHI_Format::BC3_Unorm;
             }
             else if (format_dxgi == tinyddsloader::DDSFile::DXGIFormat::BC5_UNorm)
             {
-                format = RHI_Format::BC5_Unorm;
+                image.format = RHI_Format::BC5_Unorm;
             }
             else if (format_dxgi == tinyddsloader::DDSFile::DXGIFormat::BC7_UNorm)
             {
-                format = RHI_Format::BC7_Unorm;
+                image.format = RHI_Format::BC7_Unorm;
             }
-            SP_ASSERT(format != RHI_Format::Max);
+            SP_ASSERT(image.format != RHI_Format::Max);
 
-            // set properties
-            texture->SetWidth(dds_file.GetWidth());
-            texture->SetHeight(dds_file.GetHeight());
-            texture->SetFormat(format);
+            image.width  = dds_file.GetWidth();
+            image.height = dds_file.GetHeight();
 
-            // set data
             for (uint32_t mip_index = 0; mip_index < dds_file.GetMipCount(); mip_index++)
             {
-                texture->AllocateMip();
-                RHI_Texture_Mip& mip = texture->GetMip(0, mip_index);
+                const uint32_t width  = max(1u, image.width >> mip_index);
+                const uint32_t height = max(1u, image.height >> mip_index);
 
-                const auto& data = dds_file.GetImageData(mip_index, 0);
-                memcpy(&mip.bytes[0], data->m_mem, mip.bytes.size());
+                vector<byte>& mip = image.mips.emplace_back(RHI_Texture::CalculateMipSize(width, height, 1, image.format, 0, 0));
+                memcpy(mip.data(), dds_file.GetImageData(mip_index, 0)->m_mem, mip.size());
             }
 
-            return;
+            return true;
         }
 
-        // load
-        FIBITMAP* bitmap = FreeImage_Load(format, file_path.c_str());
-        if (!bitmap)
+        // width and height are optional, if set (and different) the image is rescaled to them
+        // rows are only converted across the thread pool when the caller isn't already decoding several images in parallel
+        bool decode(const string& file_path, const uint32_t width, const uint32_t height, const bool convert_in_parallel, DecodedImage& image)
         {
-            SP_LOG_ERROR("Failed to load \"%s\"", file_path.c_str());
-            return;
+            if (!FileSystem::Exists(file_path))
+            {
+                SP_LOG_ERROR("Path \"%s\" is invalid.", file_path.c_str());
+                return false;
+            }
+
+            // acquire image format
+            FREE_IMAGE_FORMAT format = FreeImage_GetFileType(file_path.c_str(), 0);
+            {
+                // if the format is unknown, try to work it out from the file path
+                if (format == FIF_UNKNOWN)
+                {
+                    format = FreeImage_GetFIFFromFilename(file_path.c_str());
+                }
+
+                // if the format is still unknown, give up
+                if (!FreeImage_FIFSupportsReading(format))
+                {
+                    SP_LOG_ERROR("Unsupported format");
+                    return false;
+                }
+            }
+
+            if (format == FIF_DDS)
+                return decode_dds(file_path, image);
+
+            // load
+            FIBITMAP* bitmap = FreeImage_Load(format, file_path.c_str());
+            if (!bitmap)
+            {
+                SP_LOG_ERROR("Failed to load \"%s\"", file_path.c_str());
+                return false;
+            }
+
+            // deduce certain properties
+            // done before apply_bitmap_corrections(), as after that, results for grayscale seem to be always false
+            image.flags |= (FreeImage_GetColorType(bitmap) == FREE_IMAGE_COLOR_TYPE::FIC_MINISBLACK) ? RHI_Texture_Greyscale : 0;
+            image.flags |= get_is_srgb(bitmap) ? RHI_Texture_Srgb : 0;
+
+            // bring the image to a layout the conversion kernels can read
+            bitmap = apply_bitmap_corrections(bitmap);
+            if (!bitmap)
+            {
+                SP_LOG_ERROR("Failed to apply bitmap corrections");
+                return false;
+            }
+
+            // scale if needed
+            const bool user_define_dimensions = (width != 0 && height != 0);
+            const bool dimension_mismatch     = (FreeImage_GetWidth(bitmap) != width && FreeImage_GetHeight(bitmap) != height);
+            const bool scale                  = user_define_dimensions && dimension_mismatch;
+            bitmap                            = scale ? rescale(bitmap, width, height) : bitmap;
+
+            // set properties, everything ends up as rgba8, except for 16-bit color which is rgba16 and float and 16-bit greyscale images which are rgba32f
+            const FREE_IMAGE_TYPE type = FreeImage_GetImageType(bitmap);
+            const bool is_float        = type == FIT_RGBF || type == FIT_RGBAF || type == FIT_UINT16;
+            const bool is_16bit        = type == FIT_RGB16 || type == FIT_RGBA16;
+            image.width                = FreeImage_GetWidth(bitmap);
+            image.height               = FreeImage_GetHeight(bitmap);
+            image.bits_per_channel     = is_float ? 32 : (is_16bit ? 16 : 8);
+            image.channel_count        = 4;
+            image.format               = get_rhi_format(image.bits_per_channel, image.channel_count);
+
+            // convert, scanline by scanline, freeimage stores images bottom-up so rows are read in reverse to flip them
+            const uint32_t bits_per_pixel  = FreeImage_GetBPP(bitmap);
+            const size_t destination_pitch = static_cast<size_t>(image.width) * image.channel_count * (image.bits_per_channel / 8);
+            vector<byte>& destination      = image.mips.emplace_back(destination_pitch * image.height);
+            atomic<bool> is_transparent    = false;
+
+            auto convert_rows = [&](uint32_t row_start, uint32_t row_end)
+            {
+                uint8_t alpha = 255;
+                for (uint32_t y = row_start; y < row_end; y++)
+                {
+                    const BYTE* source = FreeImage_GetScanLine(bitmap, image.height - 1 - y);
+                    uint8_t* row       = reinterpret_cast<uint8_t*>(&destination[y * destination_pitch]);
+
+                    if (type == FIT_BITMAP && bits_per_pixel == 32)
+                    {
+                        alpha &= conversion::bgra8_to_rgba8(source, row, image.width);
+                    }
+                    else if (type == FIT_BITMAP)
+                    {
+                        alpha &= conversion::bgr8_to_rgba8(source, row, image.width);
+                    }
+                    else if (type == FIT_RGBA16)
+                    {
+                        alpha &= conversion::rgba16_to_rgba16(reinterpret_cast<const uint16_t*>(source), reinterpret_cast<uint16_t*>(row), image.width);
+                    }
+                    else if (type == FIT_RGB16)
+                    {
+                        alpha &= conversion::rgb16_to_rgba16(reinterpret_cast<const uint16_t*>(source), reinterpret_cast<uint16_t*>(row), image.width);
+                    }
+                    else if (type == FIT_UINT16)
+                    {
+                        alpha &= conversion::grey16_to_rgba32f(reinterpret_cast<const uint16_t*>(source), reinterpret_cast<float*>(row), image.width);
+                    }
+                    else if (type == FIT_RGBF)
+                    {
+                        conversion::rgb32f_to_rgba32f(reinterpret_cast<const float*>(source), reinterpret_cast<float*>(row), image.width);
+                    }
+                    else // FIT_RGBAF
+                    {
+                        memcpy(row, source, destination_pitch);
+                    }
+                }
+
+                if (alpha != 255)
+                {
+                    is_transparent = true;
+                }
+            };
+
+            // large images are converted across the thread pool
+            if (convert_in_parallel && image.height >= 256)
+            {
+                ThreadPool::ParallelLoop(convert_rows, image.height);
+            }
+            else
+            {
+                convert_rows(0, image.height);
+            }
+
+            image.flags |= is_transparent ? RHI_Texture_Transparent : 0;
+
+            FreeImage_Unload(bitmap);
+            return true;
         }
-        
-        // deduce certain properties
-        // done before ApplyBitmapCorrections(), as after that, results for grayscale seem to be always false
-        texture_flags |= (FreeImage_GetColorType(bitmap) == FREE_IMAGE_COLOR_TYPE::FIC_MINISBLACK) ? RHI_Texture_Greyscale : 0;
-        texture_flags |= get_is_srgb(bitmap) ? RHI_Texture_Srgb : 0;
-        texture->SetFlags(texture_flags);
-
-        // perform some corrections
-        bitmap = apply_bitmap_corrections(bitmap);
-        if (!bitmap)
+
+        void apply(DecodedImage& image, const uint32_t slice_index, RHI_Texture* texture)
         {
-            SP_LOG_ERROR("Failed to apply bitmap corrections");
+            // transparency is deduced from the data, so the first slice resets it and every slice can set it
+            uint32_t flags = texture->GetFlags();
+            if (slice_index == 0)
+            {
+                flags &= ~RHI_Texture_Transparent;
+            }
+            texture->SetFlags(flags | image.flags);
+
+            texture->SetWidth(image.width);
+            texture->SetHeight(image.height);
+            texture->SetFormat(image.format);
+            if (image.bits_per_channel != 0)
+            {
+                texture->SetBitsPerChannel(image.bits_per_channel);
+                texture->SetChannelCount(image.channel_count);
+            }
+
+            for (vector<byte>& mip : image.mips)
+            {
+                texture->AddMip(slice_index, move(mip));
+            }
+        }
+    }
+
+    void ImageImporter::Initialize()
+    {
+        FreeImage_Initialise();
+        FreeImage_SetOutputMessage(free_image_error_handler);
+        Settings::RegisterThirdPartyLib("FreeImage", FreeImage_GetVersion(), "https://freeimage.sourceforge.io/");
+    }
+
+    void ImageImporter::Shutdown()
+    {
+        FreeImage_DeInitialise();
+    }
+
+    void ImageImporter::Load(const string& file_path, const uint32_t slice_index, RHI_Texture* texture)
+    {
+        SP_ASSERT(texture != nullptr);
+
+        DecodedImage image;
+        if (decode(file_path, texture->GetWidth(), texture->GetHeight(), true, image))
+        {
+            apply(image, slice_index, texture);
+        }
+    }
+
+    void ImageImporter::Load(const vector<string>& file_paths, RHI_Texture* texture)
+    {
+        SP_ASSERT(texture != nullptr);
+
+        if (file_paths.size() == 1)
+        {
+            Load(file_paths[0], 0, texture);
             return;
         }
 
-        // scale if needed
-        const bool user_define_dimensions = (texture->GetWidth() != 0 && texture->GetHeight() != 0);
-        const bool dimension_mismatch     = (FreeImage_GetWidth(bitmap) != texture->GetWidth() && FreeImage_GetHeight(bitmap) != texture->GetHeight());
-        const bool scale                  = user_define_dimensions && dimension_mismatch;
-        bitmap                            = scale ? rescale(bitmap, texture->GetWidth(), texture->GetHeight()) : bitmap;
-
-        // set properties
-        texture->SetBitsPerChannel(get_bits_per_channel(bitmap));
-        texture->SetWidth(FreeImage_GetWidth(bitmap));
-        texture->SetHeight(FreeImage_GetHeight(bitmap));
-        texture->SetChannelCount(get_channel_count(bitmap));
-        texture->SetFormat(get_rhi_format(texture->GetBitsPerChannel(), texture->GetChannelCount()));
-        texture->SetFlag(RHI_Texture_Transparent, has_transparent_pixels(bitmap));
-
-        // copy data over
-        texture->AllocateMip();
-        RHI_Texture_Mip& mip = texture->GetMip(0, 0);
-        BYTE* bytes          = FreeImage_GetBits(bitmap);
-        size_t bytes_size    = FreeImage_GetPitch(bitmap) * FreeImage_GetHeight(bitmap);
-        mip.bytes.resize(bytes_size);
-        memcpy(&mip.bytes[0], bytes, bytes_size);
+        // decode in parallel, then hand the slices to the texture in order
+        const uint32_t width  = texture->GetWidth();
+        const uint32_t height = texture->GetHeight();
+        vector<DecodedImage> images(file_paths.size());
+        vector<uint8_t> decoded(file_paths.size(), 0);
+        ThreadPool::ParallelForEach([&](uint32_t i)
+        {
+            decoded[i] = decode(file_paths[i], width, height, false, images[i]) ? 1 : 0;
+        }, static_cast<uint32_t>(file_paths.size()));
 
-        FreeImage_Unload(bitmap);
+        for (uint32_t i = 0; i < static_cast<uint32_t>(images.size()); i++)
+        {
+            // slices have to match the first one, the rare image that doesn't is decoded again at that size
+            const bool is_mismatch = i > 0 && decoded[0] && decoded[i] && (images[i].width != images[0].width || images[i].height != images[0].height);
+            if (is_mismatch)
+            {
+                images[i]  = DecodedImage();
+                decoded[i] = decode(file_paths[i], images[0].width, images[0].height, true, images[i]) ? 1 : 0;
+            }
+
+            // a missing slice would shift the ones after it (or leave slice 0 empty), so the whole array fails
+            if (!decoded[i])
+            {
+                SP_LOG_ERROR("Failed to decode slice %u (\"%s\"), the texture array won't be loaded", i, file_paths[i].c_str());
+                return;
+            }
+        }
+
+        for (uint32_t i = 0; i < static_cast<uint32_t>(images.size()); i++)
+        {
+            apply(images[i], i, texture);
+        }
     }
 
     void ImageImporter::Save(const string& file_path, const uint32_t width, const uint32_t height, const uint32_t channel_count, const uint32_t bits_per_channel, void* data)
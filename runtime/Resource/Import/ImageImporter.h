@@ -23,6 +23,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 //= INCLUDES ====
 #include <string>
+#include <vector>
 //===============
 
 namespace spartan
@@ -35,6 +36,10 @@ namespace spartan
         static void Initialize();
         static void Shutdown();
         static void Load(const std::string& file_path, const uint32_t slice_index, RHI_Texture* texture);
+        static void Load(const std::vector<std::string>& file_paths, RHI_Texture* texture); // one slice per image, decoded in parallel
         static void Save(const std::string& file_path, const uint32_t width, const uint32_t height, const uint32_t channel_count, const uint32_t bits_per_channel, void* data);
+
+        // bump when the decoded output changes, it invalidates cached derived data
+        static const uint32_t version = 4;
     };
 }
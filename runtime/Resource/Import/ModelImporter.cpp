@@ -23,18 +23,23 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pch.h"
 #include "ModelImporter.h"
 #include "../../Core/ProgressTracker.h"
+#include "../../Core/ThreadPool.h"
 #include "../../RHI/RHI_Texture.h"
 #include "../../Rendering/Animation.h"
 #include "../../Rendering/Mesh.h"
 #include "../../World/World.h"
 #include "../../World/Entity.h"
 #include "../../World/Components/Light.h"
+#include "../../World/Components/Renderable.h"
 #include "../../Resource/ResourceCache.h"
+#include "../../Resource/DerivedDataCache.h"
+#include "../../IO/FileStream.h"
 SP_WARNINGS_OFF
 #include "assimp/scene.h"
 #include "assimp/ProgressHandler.hpp"
 #include "assimp/version.h"
 #include "assimp/Importer.hpp"
+#include "assimp/DefaultIOSystem.h"
 #include "assimp/postprocess.h"
 SP_WARNINGS_ON
 //=======================================
@@ -153,6 +158,27 @@ namespace spartan
             string m_file_name;
         };
 
+        // file system interface which records every file assimp opens (gltf buffers, obj material libraries, fbx externals, etc.)
+        class AssimpRecordingIOSystem : public DefaultIOSystem
+        {
+        public:
+            IOStream* Open(const char* file_path, const char* mode) override
+            {
+                IOStream* stream = DefaultIOSystem::Open(file_path, mode);
+                if (stream)
+                {
+                    m_file_paths.emplace_back(file_path);
+                }
+
+                return stream;
+            }
+
+            const vector<string>& GetFilePaths() const { return m_file_paths; }
+
+        private:
+            vector<string> m_file_paths;
+        };
+
         string texture_try_multiple_extensions(const string& file_path)
         {
             // Remove extension
@@ -213,33 +239,66 @@ namespace spartan
             return "";
         }
 
-        bool load_material_texture(
-            Mesh* mesh,
-            const string& file_path,
-            shared_ptr<Material> material,
-            const aiMaterial* material_assimp,
-            const MaterialTextureType texture_type,
-            const aiTextureType texture_type_assimp_pbr,
-            const aiTextureType texture_type_assimp_legacy
-        )
+        struct TextureMapping
+        {
+            MaterialTextureType type;
+            aiTextureType type_assimp_pbr;
+            aiTextureType type_assimp_legacy; // fallback
+        };
+
+        const TextureMapping texture_mappings[] =
+        {
+            { MaterialTextureType::Color,     aiTextureType_BASE_COLOR,        aiTextureType_DIFFUSE           },
+            { MaterialTextureType::Roughness, aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_SHININESS         }, // use specular as fallback
+            { MaterialTextureType::Metalness, aiTextureType_METALNESS,         aiTextureType_NONE              },
+            { MaterialTextureType::Normal,    aiTextureType_NORMAL_CAMERA,     aiTextureType_NORMALS           },
+            { MaterialTextureType::Occlusion, aiTextureType_AMBIENT_OCCLUSION, aiTextureType_LIGHTMAP          },
+            { MaterialTextureType::Emission,  aiTextureType_EMISSION_COLOR,    aiTextureType_EMISSIVE          },
+            { MaterialTextureType::Height,    aiTextureType_HEIGHT,            aiTextureType_NONE              },
+            { MaterialTextureType::AlphaMask, aiTextureType_OPACITY,           aiTextureType_NONE              }
+        };
+
+        aiTextureType get_texture_type(const aiMaterial* material_assimp, const TextureMapping& mapping)
         {
             // determine if this is a pbr material or not
             aiTextureType type_assimp = aiTextureType_NONE;
-            type_assimp = material_assimp->GetTextureCount(texture_type_assimp_pbr) > 0 ? texture_type_assimp_pbr : type_assimp;
-            type_assimp = (type_assimp == aiTextureType_NONE) ? (material_assimp->GetTextureCount(texture_type_assimp_legacy) > 0 ? texture_type_assimp_legacy : type_assimp) : type_assimp;
+            type_assimp = material_assimp->GetTextureCount(mapping.type_assimp_pbr) > 0 ? mapping.type_assimp_pbr : type_assimp;
+            type_assimp = (type_assimp == aiTextureType_NONE) ? (material_assimp->GetTextureCount(mapping.type_assimp_legacy) > 0 ? mapping.type_assimp_legacy : type_assimp) : type_assimp;
 
-            // check if the material has any textures
-            if (material_assimp->GetTextureCount(type_assimp) == 0)
-                return true;
+            return type_assimp;
+        }
 
+        string get_texture_path(const aiMaterial* material_assimp, const aiTextureType type_assimp, const string& file_path)
+        {
             // try to get the texture path
             aiString texture_path;
             if (material_assimp->GetTexture(type_assimp, 0, &texture_path) != AI_SUCCESS)
-                return false;
+                return "";
 
             // see if the texture type is supported by the engine
             const string deduced_path = texture_validate_path(texture_path.data, file_path);
             if (!FileSystem::IsSupportedImageFile(deduced_path))
+                return "";
+
+            return deduced_path;
+        }
+
+        bool load_material_texture(
+            const string& file_path,
+            shared_ptr<Material> material,
+            const aiMaterial* material_assimp,
+            const TextureMapping& mapping
+        )
+        {
+            const MaterialTextureType texture_type = mapping.type;
+            const aiTextureType type_assimp        = get_texture_type(material_assimp, mapping);
+
+            // check if the material has any textures
+            if (material_assimp->GetTextureCount(type_assimp) == 0)
+                return true;
+
+            const string deduced_path = get_texture_path(material_assimp, type_assimp, file_path);
+            if (deduced_path.empty())
                 return false;
 
             // load the texture and set it to the material
@@ -289,20 +348,15 @@ namespace spartan
             return true;
         }
 
-        shared_ptr<Material> load_material(Mesh* mesh, const string& file_path, const aiMaterial* material_assimp)
+        shared_ptr<Material> load_material(const string& file_path, const aiMaterial* material_assimp)
         {
             SP_ASSERT(material_assimp != nullptr);
             shared_ptr<Material> material = make_shared<Material>();
 
-            //                                                                         texture type,           texture type assimp (pbr),       texture type assimp (legacy/fallback)
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Color,      aiTextureType_BASE_COLOR,        aiTextureType_DIFFUSE);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Roughness,  aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_SHININESS); // use specular as fallback
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Metalness,  aiTextureType_METALNESS,         aiTextureType_NONE);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Normal,     aiTextureType_NORMAL_CAMERA,     aiTextureType_NORMALS);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Occlusion,  aiTextureType_AMBIENT_OCCLUSION, aiTextureType_LIGHTMAP);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Emission,   aiTextureType_EMISSION_COLOR,    aiTextureType_EMISSIVE);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::Height,     aiTextureType_HEIGHT,            aiTextureType_NONE);
-            load_material_texture(mesh, file_path, material, material_assimp, MaterialTextureType::AlphaMask,  aiTextureType_OPACITY,           aiTextureType_NONE);
+            for (const TextureMapping& mapping : texture_mappings)
+            {
+                load_material_texture(file_path, material, material_assimp, mapping);
+            }
 
             // gltf detection
             bool is_gltf = FileSystem::GetExtensionFromFilePath(file_path) == ".gltf";
@@ -402,6 +456,585 @@ namespace spartan
 
             return material;
         }
+
+        // meshes found while walking the nodes, they are converted and optimized in parallel once the walk is done
+        struct PendingMesh
+        {
+            aiMesh* assimp_mesh = nullptr;
+            shared_ptr<Entity> entity;
+            BoundingBox aabb;
+        };
+        vector<PendingMesh> pending_meshes;
+
+        void convert_mesh(const aiMesh* assimp_mesh, vector<RHI_Vertex_PosTexNorTan>& vertices, vector<uint32_t>& indices)
+        {
+            const uint32_t vertex_count = assimp_mesh->mNumVertices;
+            const uint32_t index_count  = assimp_mesh->mNumFaces * 3;
+
+            // vertices
+            vertices.resize(vertex_count);
+            {
+                for (uint32_t i = 0; i < vertex_count; i++)
+                {
+                    RHI_Vertex_PosTexNorTan& vertex = vertices[i];
+
+                    // position
+                    const aiVector3D& pos = assimp_mesh->mVertices[i];
+                    vertex.pos[0] = pos.x;
+                    vertex.pos[1] = pos.y;
+                    vertex.pos[2] = pos.z;
+
+                    // normal
+                    if (assimp_mesh->mNormals)
+                    {
+                        const aiVector3D& normal = assimp_mesh->mNormals[i];
+                        vertex.nor[0] = normal.x;
+                        vertex.nor[1] = normal.y;
+                        vertex.nor[2] = normal.z;
+                    }
+
+                    // tangent
+                    if (assimp_mesh->mTangents)
+                    {
+                        const aiVector3D& tangent = assimp_mesh->mTangents[i];
+                        vertex.tan[0] = tangent.x;
+                        vertex.tan[1] = tangent.y;
+                        vertex.tan[2] = tangent.z;
+                    }
+
+                    // texture coordinates
+                    const uint32_t uv_channel = 0;
+                    if (assimp_mesh->HasTextureCoords(uv_channel))
+                    {
+                        const auto& tex_coords = assimp_mesh->mTextureCoords[uv_channel][i];
+                        vertex.tex[0] = tex_coords.x;
+                        vertex.tex[1] = tex_coords.y;
+                    }
+                }
+            }
+
+            // indices
+            indices.resize(index_count);
+            {
+                // get indices by iterating through each face of the mesh.
+                for (uint32_t face_index = 0; face_index < assimp_mesh->mNumFaces; face_index++)
+                {
+                    // if (aiPrimitiveType_LINE | aiPrimitiveType_POINT) && aiProcess_Triangulate) then (face.mNumIndices == 3)
+                    const aiFace& face           = assimp_mesh->mFaces[face_index];
+                    const uint32_t indices_index = (face_index * 3);
+                    indices[indices_index + 0]   = face.mIndices[0];
+                    indices[indices_index + 1]   = face.mIndices[1];
+                    indices[indices_index + 2]   = face.mIndices[2];
+                }
+            }
+        }
+
+        void load_textures()
+        {
+            // gather the textures of the materials which are in use
+            vector<bool> material_used(scene->mNumMaterials, false);
+            for (const PendingMesh& pending : pending_meshes)
+            {
+                material_used[pending.assimp_mesh->mMaterialIndex] = true;
+            }
+
+            vector<string> file_paths;
+            unordered_set<string> file_paths_unique;
+            for (uint32_t i = 0; i < scene->mNumMaterials; i++)
+            {
+                if (!material_used[i])
+                    continue;
+
+                for (const TextureMapping& mapping : texture_mappings)
+                {
+                    const aiTextureType type_assimp = get_texture_type(scene->mMaterials[i], mapping);
+                    if (scene->mMaterials[i]->GetTextureCount(type_assimp) == 0)
+                        continue;
+
+                    string file_path = get_texture_path(scene->mMaterials[i], type_assimp, model_file_path);
+                    if (!file_path.empty() && !ResourceCache::GetByPath<RHI_Texture>(file_path) && file_paths_unique.insert(file_path).second)
+                    {
+                        file_paths.emplace_back(move(file_path));
+                    }
+                }
+            }
+
+            // decode, load_material() then finds them in the resource cache
+            ThreadPool::ParallelForEach([&file_paths](uint32_t i)
+            {
+                // same flags as Material::SetTexture()
+                ResourceCache::Load<RHI_Texture>(file_paths[i], RHI_Texture_Srv | RHI_Texture_Compress | RHI_Texture_DontPrepareForGpu);
+            }, static_cast<uint32_t>(file_paths.size()));
+        }
+
+        namespace derived_data
+        {
+            // an imported model is stored as its encoded geometry, the materials as they were before packing and the
+            // entity hierarchy, parents before children, replaying it gives the same entities without going through assimp
+            const uint32_t magic   = 0x4D445053; // "SPDM"
+            const uint32_t version = 1;
+
+            struct MaterialRecord
+            {
+                string file_path;
+                array<float, static_cast<uint32_t>(MaterialProperty::Max)> properties;
+                vector<pair<uint32_t, string>> textures; // texture array index (type * slots + slot), file path
+            };
+
+            struct EntityRecord
+            {
+                string name;
+                uint32_t parent_index = numeric_limits<uint32_t>::max();
+                Vector3 position;
+                Quaternion rotation;
+                Vector3 scale;
+
+                bool has_renderable     = false;
+                uint32_t index_offset   = 0;
+                uint32_t index_count    = 0;
+                uint32_t vertex_offset  = 0;
+                uint32_t vertex_count   = 0;
+                uint32_t material_index = numeric_limits<uint32_t>::max();
+
+                bool has_light        = false;
+                uint32_t light_type   = 0;
+                Color light_color;
+                float light_intensity = 0.0f;
+                float light_range     = 0.0f;
+            };
+
+            // materials as they come out of load_material(), keyed by their final file path (the one the resource cache sees)
+            unordered_map<string, MaterialRecord> materials;
+
+            MaterialRecord record_material(Material* material)
+            {
+                MaterialRecord record;
+                record.file_path = material->GetResourceFilePath();
+
+                for (uint32_t i = 0; i < static_cast<uint32_t>(MaterialProperty::Max); i++)
+                {
+                    record.properties[i] = material->GetProperty(static_cast<MaterialProperty>(i));
+                }
+
+                for (uint32_t type = 0; type < static_cast<uint32_t>(MaterialTextureType::Max); type++)
+                {
+                    for (uint32_t slot = 0; slot < Material::slots_per_texture_type; slot++)
+                    {
+                        if (RHI_Texture* texture = material->GetTexture(static_cast<MaterialTextureType>(type), slot))
+                        {
+                            record.textures.emplace_back(type * Material::slots_per_texture_type + slot, texture->GetResourceFilePath());
+                        }
+                    }
+                }
+
+                return record;
+            }
+
+            // the files assimp reads besides the model itself aren't known until it has run, so the first import stores them
+            // in a manifest keyed by the model alone, and the entry key covers the content of every one of them
+            const uint32_t manifest_magic = 0x4D4D5053; // "SPMM"
+
+            uint64_t compute_key_manifest(const string& file_path, const uint32_t mesh_flags)
+            {
+                uint64_t key = DerivedDataCache::HashFile(file_path);
+                if (key == 0)
+                    return 0;
+
+                key = rhi_hash_combine(key, mesh_flags);
+                key = rhi_hash_combine(key, ModelImporter::version);
+                key = rhi_hash_combine(key, (aiGetVersionMajor() << 16) | (aiGetVersionMinor() << 8) | aiGetVersionRevision());
+                key = rhi_hash_combine(key, manifest_magic);
+
+                return key;
+            }
+
+            uint64_t compute_key(const uint64_t key_manifest, const vector<string>& dependencies)
+            {
+                if (key_manifest == 0)
+                    return 0;
+
+                uint64_t key = rhi_hash_combine(key_manifest, version);
+                for (const string& path : dependencies)
+                {
+                    // a missing dependency hashes to 0, which gives a different key
+                    key = rhi_hash_combine(key, DerivedDataCache::HashFile(path));
+                }
+
+                return key;
+            }
+
+            bool load_manifest(const uint64_t key_manifest, vector<string>& dependencies)
+            {
+                if (!DerivedDataCache::Exists(key_manifest))
+                    return false;
+
+                FileStream file(DerivedDataCache::GetFilePath(key_manifest), FileStream_Read);
+                if (!file.IsOpen())
+                    return false;
+
+                if (file.ReadAs<uint32_t>() != manifest_magic || file.ReadAs<uint64_t>() != key_manifest)
+                    return false;
+
+                dependencies.resize(file.ReadAs<uint32_t>());
+                for (string& path : dependencies)
+                {
+                    file.Read(&path);
+                }
+
+                return file.ReadAs<uint32_t>() == manifest_magic;
+            }
+
+            void save_manifest(const uint64_t key_manifest, const vector<string>& dependencies)
+            {
+                if (key_manifest == 0)
+                    return;
+
+                const string file_path_temp = DerivedDataCache::GetFilePathTemp(key_manifest);
+                {
+                    FileStream file(file_path_temp, FileStream_Write);
+                    if (!file.IsOpen())
+                        return;
+
+                    file.Write(manifest_magic);
+                    file.Write(key_manifest);
+                    file.Write(static_cast<uint32_t>(dependencies.size()));
+                    for (const string& path : dependencies)
+                    {
+                        file.Write(path);
+                    }
+                    file.Write(manifest_magic);
+                }
+
+                DerivedDataCache::Commit(key_manifest, file_path_temp);
+            }
+
+            vector<string> get_dependencies(const string& file_path, const vector<string>& file_paths_read)
+            {
+                // the model itself is part of the manifest key, everything else it pulled in is a dependency
+                const string model = FileSystem::GetRelativePath(file_path);
+
+                vector<string> dependencies;
+                for (const string& path : file_paths_read)
+                {
+                    if (FileSystem::GetRelativePath(path) != model)
+                    {
+                        dependencies.emplace_back(path);
+                    }
+                }
+                sort(dependencies.begin(), dependencies.end());
+                dependencies.erase(unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+                return dependencies;
+            }
+
+            bool save(const uint64_t key)
+            {
+                shared_ptr<Entity> root = mesh->GetRootEntity().lock();
+                if (key == 0 || !root)
+                    return false;
+
+                // flatten the hierarchy, breadth first so that parents always come before their children
+                vector<Entity*> entities = { root.get() };
+                vector<uint32_t> parents = { numeric_limits<uint32_t>::max() };
+                for (uint32_t i = 0; i < static_cast<uint32_t>(entities.size()); i++)
+                {
+                    for (Entity* child : entities[i]->GetChildren())
+                    {
+                        entities.emplace_back(child);
+                        parents.emplace_back(i);
+                    }
+                }
+
+                // gather the materials the renderables ended up with
+                vector<const MaterialRecord*> material_table;
+                unordered_map<string, uint32_t> material_indices;
+                vector<EntityRecord> records(entities.size());
+                for (uint32_t i = 0; i < static_cast<uint32_t>(entities.size()); i++)
+                {
+                    Entity* entity       = entities[i];
+                    EntityRecord& record = records[i];
+                    record.name          = entity->GetObjectName();
+                    record.parent_index  = parents[i];
+                    record.position      = entity->GetPositionLocal();
+                    record.rotation      = entity->GetRotationLocal();
+                    record.scale         = entity->GetScaleLocal();
+
+                    shared_ptr<Renderable> renderable = entity->GetComponent<Renderable>();
+                    if (renderable && renderable->GetMesh() == mesh)
+                    {
+                        record.has_renderable = true;
+                        record.index_offset   = renderable->GetIndexOffset();
+                        record.index_count    = renderable->GetIndexCount();
+                        record.vertex_offset  = renderable->GetVertexOffset();
+                        record.vertex_count   = renderable->GetVertexCount();
+
+                        if (Material* material = renderable->GetMaterial())
+                        {
+                            auto it = materials.find(material->GetResourceFilePath());
+                            if (it != materials.end())
+                            {
+                                auto [it_index, inserted] = material_indices.emplace(it->first, static_cast<uint32_t>(material_table.size()));
+                                if (inserted)
+                                {
+                                    material_table.emplace_back(&it->second);
+                                }
+                                record.material_index = it_index->second;
+                            }
+                        }
+                    }
+
+                    if (shared_ptr<Light> light = entity->GetComponent<Light>())
+                    {
+                        record.has_light       = true;
+                        record.light_type      = static_cast<uint32_t>(light->GetLightType());
+                        record.light_color     = light->GetColor();
+                        record.light_intensity = light->GetIntensityLumens();
+                        record.light_range     = light->GetRange();
+                    }
+                }
+
+                const string file_path_temp = DerivedDataCache::GetFilePathTemp(key);
+                {
+                    FileStream file(file_path_temp, FileStream_Write);
+                    if (!file.IsOpen())
+                        return false;
+
+                    file.Write(magic);
+                    file.Write(version);
+                    file.Write(key);
+
+                    // geometry
+                    mesh->SaveToFileEncoded(&file);
+
+                    // materials
+                    file.Write(static_cast<uint32_t>(material_table.size()));
+                    for (const MaterialRecord* material : material_table)
+                    {
+                        file.Write(material->file_path);
+                        file.Write(material->properties.data(), sizeof(material->properties));
+                        file.Write(static_cast<uint32_t>(material->textures.size()));
+                        for (const auto& [index, path] : material->textures)
+                        {
+                            file.Write(index);
+                            file.Write(path);
+                        }
+                    }
+
+                    // entities
+                    file.Write(static_cast<uint32_t>(records.size()));
+                    for (const EntityRecord& record : records)
+                    {
+                        file.Write(record.name);
+                        file.Write(record.parent_index);
+                        file.Write(record.position);
+                        file.Write(record.rotation);
+                        file.Write(record.scale);
+
+                        file.Write(record.has_renderable);
+                        if (record.has_renderable)
+                        {
+                            file.Write(record.index_offset);
+                            file.Write(record.index_count);
+                            file.Write(record.vertex_offset);
+                            file.Write(record.vertex_count);
+                            file.Write(record.material_index);
+                        }
+
+                        file.Write(record.has_light);
+                        if (record.has_light)
+                        {
+                            file.Write(record.light_type);
+                            file.Write(record.light_color);
+                            file.Write(record.light_intensity);
+                            file.Write(record.light_range);
+                        }
+                    }
+
+                    // the trailing magic guards against truncated files
+                    file.Write(magic);
+                }
+
+                return DerivedDataCache::Commit(key, file_path_temp);
+            }
+
+            bool load(const uint64_t key)
+            {
+                vector<MaterialRecord> material_table;
+                vector<EntityRecord> records;
+
+                // read and validate everything before anything is created, a bad entry leaves the world untouched
+                {
+                    FileStream file(DerivedDataCache::GetFilePath(key), FileStream_Read);
+                    if (!file.IsOpen())
+                        return false;
+
+                    if (file.ReadAs<uint32_t>() != magic || file.ReadAs<uint32_t>() != version || file.ReadAs<uint64_t>() != key)
+                        return false;
+
+                    // geometry
+                    if (!mesh->LoadFromFileEncoded(&file))
+                        return false;
+
+                    // materials
+                    material_table.resize(file.ReadAs<uint32_t>());
+                    for (MaterialRecord& material : material_table)
+                    {
+                        file.Read(&material.file_path);
+                        file.Read(material.properties.data(), sizeof(material.properties));
+                        material.textures.resize(file.ReadAs<uint32_t>());
+                        for (auto& [index, path] : material.textures)
+                        {
+                            file.Read(&index);
+                            file.Read(&path);
+
+                            if (index >= static_cast<uint32_t>(MaterialTextureType::Max) * Material::slots_per_texture_type)
+                                return false;
+                        }
+                    }
+
+                    // entities
+                    records.resize(file.ReadAs<uint32_t>());
+                    for (uint32_t i = 0; i < static_cast<uint32_t>(records.size()); i++)
+                    {
+                        EntityRecord& record = records[i];
+                        file.Read(&record.name);
+                        file.Read(&record.parent_index);
+                        file.Read(&record.position);
+                        file.Read(&record.rotation);
+                        file.Read(&record.scale);
+
+                        file.Read(&record.has_renderable);
+                        if (record.has_renderable)
+                        {
+                            file.Read(&record.index_offset);
+                            file.Read(&record.index_count);
+                            file.Read(&record.vertex_offset);
+                            file.Read(&record.vertex_count);
+                            file.Read(&record.material_index);
+
+                            bool in_range = static_cast<uint64_t>(record.index_offset)  + record.index_count  <= mesh->GetIndexCount() &&
+                                            static_cast<uint64_t>(record.vertex_offset) + record.vertex_count <= mesh->GetVertexCount() &&
+                                            (record.material_index < material_table.size() || record.material_index == numeric_limits<uint32_t>::max());
+                            if (!in_range)
+                                return false;
+                        }
+
+                        file.Read(&record.has_light);
+                        if (record.has_light)
+                        {
+                            file.Read(&record.light_type);
+                            file.Read(&record.light_color);
+                            file.Read(&record.light_intensity);
+                            file.Read(&record.light_range);
+                        }
+
+                        // the root has no parent, everything else has one that came before it
+                        bool parent_valid = (i == 0) ? record.parent_index == numeric_limits<uint32_t>::max() : record.parent_index < i;
+                        if (!parent_valid)
+                            return false;
+                    }
+
+                    if (records.empty() || file.ReadAs<uint32_t>() != magic)
+                        return false;
+                }
+
+                // materials, created on first use so that unused ones don't load their textures
+                vector<shared_ptr<Material>> materials_loaded(material_table.size());
+                auto get_material = [&](const uint32_t index)
+                {
+                    shared_ptr<Material>& material = materials_loaded[index];
+                    if (!material)
+                    {
+                        const MaterialRecord& record = material_table[index];
+
+                        material = make_shared<Material>();
+                        material->SetResourceFilePath(record.file_path);
+                        for (uint32_t i = 0; i < static_cast<uint32_t>(MaterialProperty::Max); i++)
+                        {
+                            material->SetProperty(static_cast<MaterialProperty>(i), record.properties[i]);
+                        }
+
+                        for (const auto& [texture_index, path] : record.textures)
+                        {
+                            const MaterialTextureType type = static_cast<MaterialTextureType>(texture_index / Material::slots_per_texture_type);
+                            const uint8_t slot             = static_cast<uint8_t>(texture_index % Material::slots_per_texture_type);
+
+                            if (shared_ptr<RHI_Texture> texture = ResourceCache::GetByPath<RHI_Texture>(path))
+                            {
+                                material->SetTexture(type, texture, slot);
+                            }
+                            else if (FileSystem::Exists(path))
+                            {
+                                material->SetTexture(type, path, slot);
+                            }
+                        }
+                    }
+
+                    return material;
+                };
+
+                // entities
+                vector<shared_ptr<Entity>> entities(records.size());
+                for (uint32_t i = 0; i < static_cast<uint32_t>(records.size()); i++)
+                {
+                    const EntityRecord& record = records[i];
+
+                    shared_ptr<Entity> entity = World::CreateEntity();
+                    entities[i]               = entity;
+
+                    if (i == 0)
+                    {
+                        mesh->SetRootEntity(entity);
+
+                        // the root entity is created as inactive for thread-safety.
+                        entity->SetActive(false);
+                    }
+                    else
+                    {
+                        entity->SetParent(entities[record.parent_index]);
+                    }
+
+                    entity->SetObjectName(record.name);
+                    entity->SetPositionLocal(record.position);
+                    entity->SetRotationLocal(record.rotation);
+                    entity->SetScaleLocal(record.scale);
+
+                    if (record.has_renderable)
+                    {
+                        const BoundingBox aabb = BoundingBox(mesh->GetVertices().data() + record.vertex_offset, record.vertex_count);
+                        entity->AddComponent<Renderable>()->SetGeometry(
+                            mesh,
+                            aabb,
+                            record.index_offset,
+                            record.index_count,
+                            record.vertex_offset,
+                            record.vertex_count
+                        );
+
+                        if (record.material_index != numeric_limits<uint32_t>::max())
+                        {
+                            shared_ptr<Material> material = get_material(record.material_index);
+                            mesh->SetMaterial(material, entity.get());
+                        }
+                    }
+
+                    if (record.has_light)
+                    {
+                        // same setup as ParseNodeLight(), the transform is already on the entity
+                        shared_ptr<Light> light = entity->AddComponent<Light>();
+                        light->SetFlag(LightFlags::Shadows, false);
+                        light->SetFlag(LightFlags::ShadowsTransparent, false);
+                        light->SetFlag(LightFlags::Volumetric, false);
+                        light->SetLightType(static_cast<LightType>(record.light_type));
+                        light->SetColor(record.light_color);
+                        light->SetIntensity(record.light_intensity);
+                        light->SetRange(record.light_range);
+                    }
+                }
+
+                return true;
+            }
+        }
     }
 
     void ModelImporter::Initialize()
@@ -428,6 +1061,37 @@ namespace spartan
         mesh            = mesh_in;
         mesh->SetObjectName(model_name);
 
+        // an unchanged model, imported with the same flags, is replayed from derived data without going through assimp
+        const Stopwatch timer;
+        const uint64_t key_manifest = derived_data::compute_key_manifest(file_path, mesh->GetFlags());
+        uint64_t key                = 0;
+        vector<string> dependencies;
+        if (derived_data::load_manifest(key_manifest, dependencies))
+        {
+            key = derived_data::compute_key(key_manifest, dependencies);
+        }
+
+        if (DerivedDataCache::Exists(key))
+        {
+            ProgressTracker::GetProgress(ProgressType::ModelImporter).Start(1, "Loading model from derived data...");
+            const bool loaded = derived_data::load(key);
+            ProgressTracker::GetProgress(ProgressType::ModelImporter).JobDone();
+
+            if (loaded)
+            {
+                mesh->PostProcess();
+                mesh->GetRootEntity().lock()->SetActive(true);
+                World::Resolve();
+
+                SP_LOG_INFO("Imported \"%s\" from derived data in %.1f ms (warm)", model_name.c_str(), timer.GetElapsedTimeMs());
+                mesh = nullptr;
+                return true;
+            }
+
+            DerivedDataCache::Invalidate(key);
+            mesh->Clear();
+        }
+
         // set up the importer
         Importer importer;
         {
@@ -440,6 +1104,9 @@ namespace spartan
             // enable progress tracking
             importer.SetPropertyBool(AI_CONFIG_GLOB_MEASURE_TIME, true);
             importer.SetProgressHandler(new AssimpProgress(file_path));
+
+            // record the files assimp reads, they are dependencies of the derived data entry
+            importer.SetIOHandler(new AssimpRecordingIOSystem());
         }
 
         // import flags
@@ -484,14 +1151,15 @@ namespace spartan
         if (scene = importer.ReadFile(file_path, import_flags))
         {
             // update progress tracking
-            uint32_t job_count = 0;
+            uint32_t job_count = 1; // the meshes, processed after the nodes
             compute_node_count(scene->mRootNode, &job_count);
             ProgressTracker::GetProgress(ProgressType::ModelImporter).Start(job_count, "Parsing model...");
 
             model_has_animation = scene->mNumAnimations != 0;
 
-            // recursively parse nodes
+            // recursively parse nodes, then the meshes they reference
             ParseNode(scene->mRootNode);
+            ParseMeshes();
 
             // update model geometry
             {
@@ -507,6 +1175,14 @@ namespace spartan
             // make the root entity active since it's now thread-safe
             mesh->GetRootEntity().lock()->SetActive(true);
             World::Resolve();
+
+            SP_LOG_INFO("Imported \"%s\" with assimp in %.1f ms (cold)", model_name.c_str(), timer.GetElapsedTimeMs());
+
+            // store the result so that the next import skips assimp
+            const AssimpRecordingIOSystem* io_system = static_cast<const AssimpRecordingIOSystem*>(importer.GetIOHandler());
+            dependencies                             = derived_data::get_dependencies(file_path, io_system->GetFilePaths());
+            derived_data::save_manifest(key_manifest, dependencies);
+            derived_data::save(derived_data::compute_key(key_manifest, dependencies));
         }
         else
         {
@@ -515,6 +1191,7 @@ namespace spartan
         }
 
         importer.FreeScene();
+        derived_data::materials.clear();
         mesh = nullptr;
 
         return scene != nullptr;
@@ -599,8 +1276,8 @@ namespace spartan
             // set entity name
             entity->SetObjectName(node_name);
             
-            // load the mesh onto the entity (via a Renderable component)
-            ParseMesh(node_mesh, entity);
+            // the mesh is loaded onto the entity (via a Renderable component) once all the nodes have been walked
+            pending_meshes.push_back({ node_mesh, entity });
         }
     }
 
@@ -649,106 +1326,80 @@ namespace spartan
         }
     }
 
-    void ModelImporter::ParseMesh(aiMesh* assimp_mesh, shared_ptr<Entity> entity_parent)
+    void ModelImporter::ParseMeshes()
     {
-        SP_ASSERT(assimp_mesh != nullptr);
-        SP_ASSERT(entity_parent != nullptr);
+        const Stopwatch timer;
+        const uint32_t count = static_cast<uint32_t>(pending_meshes.size());
+        ProgressTracker::GetProgress(ProgressType::ModelImporter).SetText("Processing " + to_string(count) + " meshes...");
 
-        const uint32_t vertex_count = assimp_mesh->mNumVertices;
-        const uint32_t index_count  = assimp_mesh->mNumFaces * 3;
+        // textures are the slowest part of material setup, so they are all decoded up front, in parallel
+        if (scene->HasMaterials())
+        {
+            load_textures();
+        }
 
-        // vertices
-        vector<RHI_Vertex_PosTexNorTan> vertices(vertex_count);
+        // convert
+        vector<vector<RHI_Vertex_PosTexNorTan>> vertices(count);
+        vector<vector<uint32_t>> indices(count);
+        ThreadPool::ParallelForEach([&](uint32_t i)
         {
-            for (uint32_t i = 0; i < vertex_count; i++)
-            {
-                RHI_Vertex_PosTexNorTan& vertex = vertices[i];
+            convert_mesh(pending_meshes[i].assimp_mesh, vertices[i], indices[i]);
 
-                // position
-                const aiVector3D& pos = assimp_mesh->mVertices[i];
-                vertex.pos[0] = pos.x;
-                vertex.pos[1] = pos.y;
-                vertex.pos[2] = pos.z;
+            // compute AABB (before optimization reorders the vertices)
+            pending_meshes[i].aabb = BoundingBox(vertices[i].data(), static_cast<uint32_t>(vertices[i].size()));
+        }, count);
 
-                // normal
-                if (assimp_mesh->mNormals)
-                {
-                    const aiVector3D& normal = assimp_mesh->mNormals[i];
-                    vertex.nor[0] = normal.x;
-                    vertex.nor[1] = normal.y;
-                    vertex.nor[2] = normal.z;
-                }
+        // optimize and add to the mesh, laid out in the order the nodes were walked
+        vector<SubMesh> sub_meshes;
+        mesh->AddGeometry(vertices, indices, &sub_meshes);
+
+        // renderables and materials, entities and components are created on this thread
+        vector<shared_ptr<Material>> materials(scene->mNumMaterials);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const PendingMesh& pending = pending_meshes[i];
+            const SubMesh& sub_mesh    = sub_meshes[i];
+
+            // add a renderable component to this entity
+            shared_ptr<Renderable> renderable = pending.entity->AddComponent<Renderable>();
+
+            // set the geometry
+            renderable->SetGeometry(
+                mesh,
+                pending.aabb,
+                sub_mesh.index_offset,
+                sub_mesh.index_count,
+                sub_mesh.vertex_offset,
+                sub_mesh.vertex_count
+            );
 
-                // tangent
-                if (assimp_mesh->mTangents)
+            // material, converted once per assimp material and shared by all the meshes that use it
+            if (scene->HasMaterials())
+            {
+                shared_ptr<Material>& material = materials[pending.assimp_mesh->mMaterialIndex];
+                if (!material)
                 {
-                    const aiVector3D& tangent = assimp_mesh->mTangents[i];
-                    vertex.tan[0] = tangent.x;
-                    vertex.tan[1] = tangent.y;
-                    vertex.tan[2] = tangent.z;
-                }
+                    material = load_material(model_file_path, scene->mMaterials[pending.assimp_mesh->mMaterialIndex]);
 
-                // texture coordinates
-                const uint32_t uv_channel = 0;
-                if (assimp_mesh->HasTextureCoords(uv_channel))
+                    // recorded before preparation packs its textures, this is what the derived data replays
+                    derived_data::MaterialRecord record = derived_data::record_material(material.get());
+                    mesh->SetMaterial(material, pending.entity.get());
+                    derived_data::materials.emplace(material->GetResourceFilePath(), move(record));
+                }
+                else
                 {
-                    const auto& tex_coords = assimp_mesh->mTextureCoords[uv_channel][i];
-                    vertex.tex[0] = tex_coords.x;
-                    vertex.tex[1] = tex_coords.y;
+                    mesh->SetMaterial(material, pending.entity.get());
                 }
             }
-        }
 
-        // indices
-        vector<uint32_t> indices(index_count);
-        {
-            // get indices by iterating through each face of the mesh.
-            for (uint32_t face_index = 0; face_index < assimp_mesh->mNumFaces; face_index++)
-            {
-                // if (aiPrimitiveType_LINE | aiPrimitiveType_POINT) && aiProcess_Triangulate) then (face.mNumIndices == 3)
-                const aiFace& face           = assimp_mesh->mFaces[face_index];
-                const uint32_t indices_index = (face_index * 3);
-                indices[indices_index + 0]   = face.mIndices[0];
-                indices[indices_index + 1]   = face.mIndices[1];
-                indices[indices_index + 2]   = face.mIndices[2];
-            }
+            // bones
+            ParseNodes(pending.assimp_mesh);
         }
 
-        // compute AABB (before doing move operation on vertices)
-        const BoundingBox aabb = BoundingBox(vertices.data(), static_cast<uint32_t>(vertices.size()));
-
-        // add vertex and index data to the mesh
-        uint32_t index_offset  = 0;
-        uint32_t vertex_offset = 0;
-        mesh->AddGeometry(vertices, indices, &vertex_offset, &index_offset);
-
-        // add a renderable component to this entity
-        shared_ptr<Renderable> renderable = entity_parent->AddComponent<Renderable>();
+        SP_LOG_INFO("Processed %u meshes on %u threads in %.1f ms", count, ThreadPool::GetThreadCount(), timer.GetElapsedTimeMs());
 
-        // set the geometry
-        renderable->SetGeometry(
-            mesh,
-            aabb,
-            index_offset,
-            static_cast<uint32_t>(indices.size()),
-            vertex_offset,
-            static_cast<uint32_t>(vertices.size())
-        );
-
-        // material
-        if (scene->HasMaterials())
-        {
-            // get aiMaterial
-            const aiMaterial* assimp_material = scene->mMaterials[assimp_mesh->mMaterialIndex];
-
-            // convert it and add it to the model
-            shared_ptr<Material> material = load_material(mesh, model_file_path, assimp_material);
-
-            mesh->SetMaterial(material, entity_parent.get());
-        }
-
-        // Bones
-        ParseNodes(assimp_mesh);
+        pending_meshes.clear();
+        ProgressTracker::GetProgress(ProgressType::ModelImporter).JobDone();
     }
 
     void ModelImporter::ParseAnimations()
@@ -39,12 +39,15 @@ namespace spartan
         static void Initialize();
         static bool Load(Mesh* mesh, const std::string& file_path);
 
+        // bump when the imported output changes, it invalidates cached derived data
+        static const uint32_t version = 1;
+
     private:
         static void ParseNode(const aiNode* node, std::shared_ptr<Entity> parent_entity = nullptr);
         static void ParseNodeMeshes(const aiNode* node, std::shared_ptr<Entity> new_entity);
         static void ParseNodeLight(const aiNode* node, std::shared_ptr<Entity> new_entity);
         static void ParseAnimations();
-        static void ParseMesh(aiMesh* mesh, std::shared_ptr<Entity> entity_parent);
+        static void ParseMeshes();
         static void ParseNodes(const aiMesh* mesh);
     };
 }
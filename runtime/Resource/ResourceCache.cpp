@@ -22,11 +22,17 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES =======================
 #include "pch.h"
 #include "ResourceCache.h"
+#include "DerivedDataCache.h"
 #include "../World/World.h"
 #include "../IO/FileStream.h"
 #include "../RHI/RHI_Texture.h"
 #include "../Audio/AudioClip.h"
 #include "../Rendering/Mesh.h"
+#include "../Rendering/Material.h"
+#include "../World/Entity.h"
+#include "../World/Components/Renderable.h"
+#include "../World/Components/Terrain.h"
+#include "../RHI/RHI_Device.h"
 #include "../Core/ProgressTracker.h"
 //==================================
 
@@ -39,11 +45,182 @@ namespace spartan
 {
     namespace
     {
-        array<string, 6> m_standard_resource_directories;
+        array<string, 9> m_standard_resource_directories;
         string m_project_directory;
         vector<shared_ptr<IResource>> m_resources;
         mutex m_mutex;
         bool use_root_shader_directory = false;
+
+        struct Record
+        {
+            size_t position   = 0;
+            uint64_t last_use = 0;
+            uint64_t key_path = 0; // the keys the resource was indexed with, its path and name can change after it's cached
+            uint64_t key_name = 0;
+        };
+
+        // eviction
+        uint64_t use_counter                   = 0; // guarded by m_mutex, orders resources by their last lookup
+        uint64_t budget_cpu_mb                 = 0; // zero means automatic
+        uint64_t budget_gpu_mb                 = 0; // zero means automatic
+        const uint64_t budget_cpu_mb_automatic = 4096;
+        const float budget_gpu_device_share    = 0.75f;
+        const float eviction_interval_sec      = 2.0f;
+        float time_since_eviction_sec          = 0.0f;
+
+        // indices, all guarded by m_mutex
+        unordered_map<uint64_t, IResource*> index_path; // (type, path) -> resource
+        unordered_map<uint64_t, vector<IResource*>> index_name; // (type, name) -> resources in caching order, the first one wins
+        unordered_map<uint64_t, IResource*> index_id;   // object id   -> resource
+        unordered_map<IResource*, Record> records;      // resource    -> position in m_resources and last use
+
+        uint64_t compute_key(const ResourceType type, const string& value)
+        {
+            // the type is part of the key, so that resources of different types can share a path or a name
+            const uint64_t hash = std::hash<string>{}(value);
+            return hash ^ (static_cast<uint64_t>(type) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+        }
+
+        IResource* find(const unordered_map<uint64_t, IResource*>& index, const uint64_t key)
+        {
+            auto it = index.find(key);
+            return it != index.end() ? it->second : nullptr;
+        }
+
+        IResource* find_by_path(const string& path, const ResourceType type)
+        {
+            IResource* resource = find(index_path, compute_key(type, path));
+
+            // a hash collision, or a resource that has been renamed since it was cached
+            if (resource && (resource->GetResourceType() != type || resource->GetResourceFilePath() != path))
+                return nullptr;
+
+            return resource;
+        }
+
+        void index_add(IResource* resource, const size_t position)
+        {
+            const uint64_t key_path = compute_key(resource->GetResourceType(), resource->GetResourceFilePath());
+            const uint64_t key_name = compute_key(resource->GetResourceType(), resource->GetObjectName());
+
+            records[resource] = { position, ++use_counter, key_path, key_name };
+            index_path[key_path] = resource;
+            index_name[key_name].push_back(resource);
+            index_id[resource->GetObjectId()] = resource;
+        }
+
+        bool is_gpu_resource(const IResource* resource)
+        {
+            return resource->GetResourceType() == ResourceType::Texture || resource->GetResourceType() == ResourceType::Cubemap;
+        }
+
+        uint64_t get_size(IResource* resource)
+        {
+            SpartanObject* object = dynamic_cast<SpartanObject*>(resource);
+            return object ? object->GetObjectSize() : 0;
+        }
+
+        void add_material_references(Material* material, unordered_set<IResource*>& references)
+        {
+            for (uint32_t type = 0; type < static_cast<uint32_t>(MaterialTextureType::Max); type++)
+            {
+                for (uint8_t slot = 0; slot < Material::slots_per_texture_type; slot++)
+                {
+                    if (RHI_Texture* texture = material->GetTexture(static_cast<MaterialTextureType>(type), slot))
+                    {
+                        references.insert(texture);
+                    }
+                }
+            }
+        }
+
+        unordered_set<IResource*> get_world_references()
+        {
+            // renderables, materials and terrains hold raw pointers, so the reference count alone can't tell if a resource is in use
+            // the entities are a snapshot, so a world that's being built on another thread can't invalidate the iteration
+            unordered_set<IResource*> references;
+            for (const shared_ptr<Entity>& entity : World::GetEntities())
+            {
+                if (shared_ptr<Terrain> terrain = entity->GetComponent<Terrain>())
+                {
+                    if (RHI_Texture* height_map = terrain->GetHeightMap())
+                    {
+                        references.insert(height_map);
+                    }
+                }
+
+                shared_ptr<Renderable> renderable = entity->GetComponent<Renderable>();
+                if (!renderable)
+                    continue;
+
+                if (Mesh* mesh = renderable->GetMesh())
+                {
+                    references.insert(mesh);
+                }
+
+                if (Material* material = renderable->GetMaterial())
+                {
+                    references.insert(material);
+                    add_material_references(material, references);
+                }
+            }
+
+            return references;
+        }
+
+        shared_ptr<IResource> touch(IResource* resource)
+        {
+            Record& record  = records[resource];
+            record.last_use = ++use_counter;
+            return m_resources[record.position];
+        }
+
+        void index_remove(const uint64_t key, unordered_map<uint64_t, IResource*>& index, IResource* resource)
+        {
+            auto it = index.find(key);
+            if (it != index.end() && it->second == resource)
+            {
+                index.erase(it);
+            }
+        }
+
+        shared_ptr<IResource> remove(IResource* resource)
+        {
+            auto it = records.find(resource);
+            if (it == records.end())
+                return nullptr;
+
+            // swap with the last resource and pop, so that removal is O(1) as well
+            const size_t position         = it->second.position;
+            const uint64_t key_path       = it->second.key_path;
+            const uint64_t key_name       = it->second.key_name;
+            shared_ptr<IResource> removed = move(m_resources[position]);
+            records.erase(it);
+            if (position != m_resources.size() - 1)
+            {
+                m_resources[position]                         = move(m_resources.back());
+                records[m_resources[position].get()].position = position;
+            }
+            m_resources.pop_back();
+
+            // erase by the keys the resource was indexed with, not by its current path and name, which may have been renamed since
+            index_remove(key_path, index_path, resource);
+            index_remove(resource->GetObjectId(), index_id, resource);
+
+            // a bucket only holds the resources that share a name, so the next one in line takes over without a scan
+            auto it_name = index_name.find(key_name);
+            if (it_name != index_name.end())
+            {
+                vector<IResource*>& bucket = it_name->second;
+                bucket.erase(remove_if(bucket.begin(), bucket.end(), [resource](IResource* other) { return other == resource; }), bucket.end());
+                if (bucket.empty())
+                {
+                    index_name.erase(it_name);
+                }
+            }
+
+            return removed;
+        }
     }
 
     void ResourceCache::Initialize()
@@ -53,12 +230,18 @@ namespace spartan
 
         // add engine standard resource directories
         const string data_dir = "data\\";
+        AddResourceDirectory(ResourceDirectory::DerivedData,    m_project_directory + "derived_data");
         AddResourceDirectory(ResourceDirectory::Environment,    m_project_directory + "environment");
         AddResourceDirectory(ResourceDirectory::Fonts,          data_dir + "fonts");
         AddResourceDirectory(ResourceDirectory::Icons,          data_dir + "icons");
         AddResourceDirectory(ResourceDirectory::ShaderCompiler, data_dir + "shader_compiler");
         AddResourceDirectory(ResourceDirectory::Shaders,        data_dir + "shaders");
         AddResourceDirectory(ResourceDirectory::Textures,       data_dir + "textures");
+        AddResourceDirectory(ResourceDirectory::ShaderCache,    m_project_directory + "shader_cache");
+        AddResourceDirectory(ResourceDirectory::TextureCache,   m_project_directory + "texture_cache");
+
+        // importer outputs, keyed by the content of their source files
+        DerivedDataCache::Initialize();
 
         // subscribe to events
         SP_SUBSCRIBE_TO_EVENT(EventType::WorldSaveStart, SP_EVENT_HANDLER_STATIC(Serialize));
@@ -66,49 +249,70 @@ namespace spartan
         SP_SUBSCRIBE_TO_EVENT(EventType::WorldClear,     SP_EVENT_HANDLER_STATIC(Shutdown));
     }
 
-    bool ResourceCache::IsCached(const string& file_path, const ResourceType resource_type)
+    shared_ptr<IResource> ResourceCache::CacheResource(const shared_ptr<IResource>& resource)
     {
-        SP_ASSERT(!file_path.empty());
+        SP_ASSERT(!resource->GetResourceFilePath().empty());
 
+        // the lookup and the insertion happen under the same lock, so two threads can't cache the same path twice
         lock_guard<mutex> guard(m_mutex);
 
-        for (shared_ptr<IResource>& resource : m_resources)
-        {
-            if (resource->GetResourceType() != resource_type)
-                continue;
+        // if cached, return the cached resource
+        if (IResource* cached = find_by_path(resource->GetResourceFilePath(), resource->GetResourceType()))
+            return touch(cached);
 
-            if (file_path == resource->GetResourceFilePath())
-                return true;
-        }
+        // if not, cache it and return the cached resource
+        index_add(resource.get(), m_resources.size());
+        return m_resources.emplace_back(resource);
+    }
 
-        return false;
+    void ResourceCache::RemoveResource(IResource* resource)
+    {
+        // keeps the resource alive until the indices are updated, and releases it outside of the lock
+        shared_ptr<IResource> removed;
+
+        lock_guard<mutex> guard(m_mutex);
+        removed = remove(resource);
     }
 
-    bool ResourceCache::IsCached(const uint64_t resource_id)
+    shared_ptr<IResource> ResourceCache::GetByName(const string& name, const ResourceType type)
     {
         lock_guard<mutex> guard(m_mutex);
 
-        for (shared_ptr<IResource>& resource : m_resources)
+        auto it = index_name.find(compute_key(type, name));
+        if (it == index_name.end())
+            return nullptr;
+
+        // skip hash collisions and resources that have been renamed since they were cached
+        for (IResource* resource : it->second)
         {
-            if (resource_id == resource->GetObjectId())
-                return true;
+            if (resource->GetObjectName() == name)
+                return touch(resource);
         }
 
-        return false;
+        return nullptr;
     }
-    
-	shared_ptr<IResource>& ResourceCache::GetByName(const string& name, const ResourceType type)
+
+    shared_ptr<IResource> ResourceCache::GetByPath(const string& path, const ResourceType type)
     {
+        const string path_relative = FileSystem::GetRelativePath(path);
+
         lock_guard<mutex> guard(m_mutex);
 
-        for (shared_ptr<IResource>& resource : m_resources)
-        {
-            if (name == resource->GetObjectName())
-                return resource;
-        }
+        if (IResource* resource = find_by_path(path_relative, type))
+            return touch(resource);
 
-        static shared_ptr<IResource> empty;
-        return empty;
+        return nullptr;
+    }
+
+    shared_ptr<IResource> ResourceCache::GetById(const uint64_t id)
+    {
+        lock_guard<mutex> guard(m_mutex);
+
+        IResource* resource = find(index_id, id);
+        if (resource && resource->GetObjectId() == id)
+            return touch(resource);
+
+        return nullptr;
     }
 
     vector<shared_ptr<IResource>> ResourceCache::GetByType(const ResourceType type /*= ResourceType::Unknown*/)
@@ -146,6 +350,133 @@ namespace spartan
         return size;
     }
 
+    void ResourceCache::Tick()
+    {
+        time_since_eviction_sec += static_cast<float>(Timer::GetDeltaTimeSec());
+        if (time_since_eviction_sec < eviction_interval_sec)
+            return;
+
+        time_since_eviction_sec = 0.0f;
+        Evict();
+    }
+
+    void ResourceCache::Evict()
+    {
+        // while a world loads, its resources are cached before the entities that reference them exist
+        if (ProgressTracker::IsLoading())
+            return;
+
+        const uint64_t budget_cpu = GetMemoryBudgetCpuMb() * 1024 * 1024;
+        const uint64_t budget_gpu = GetMemoryBudgetGpuMb() * 1024 * 1024;
+
+        uint64_t usage_cpu = 0;
+        uint64_t usage_gpu = 0;
+        {
+            lock_guard<mutex> guard(m_mutex);
+            for (shared_ptr<IResource>& resource : m_resources)
+            {
+                (is_gpu_resource(resource.get()) ? usage_gpu : usage_cpu) += get_size(resource.get());
+            }
+        }
+
+        if (usage_cpu <= budget_cpu && usage_gpu <= budget_gpu)
+            return;
+
+        unordered_set<IResource*> references = get_world_references();
+
+        struct Candidate
+        {
+            IResource* resource = nullptr;
+            uint64_t last_use   = 0;
+            uint64_t size       = 0;
+        };
+
+        // candidates are resources which only the cache owns, which nothing in the world points to and which can be reloaded
+        vector<Candidate> candidates;
+        {
+            lock_guard<mutex> guard(m_mutex);
+
+            // a cached material keeps its textures alive, even when no renderable uses it right now
+            for (shared_ptr<IResource>& resource : m_resources)
+            {
+                if (resource->GetResourceType() == ResourceType::Material)
+                {
+                    add_material_references(static_cast<Material*>(resource.get()), references);
+                }
+            }
+
+            for (shared_ptr<IResource>& resource : m_resources)
+            {
+                if (resource.use_count() > 1 || references.count(resource.get()) != 0)
+                    continue;
+
+                const ResourceState state = resource->GetResourceState();
+                if (state == ResourceState::LoadingFromDrive || state == ResourceState::PreparingForGpu)
+                    continue;
+
+                if (!FileSystem::IsFile(resource->GetResourceFilePath()))
+                    continue;
+
+                candidates.push_back({ resource.get(), records[resource.get()].last_use, get_size(resource.get()) });
+            }
+        }
+
+        // least recently used first
+        sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.last_use < b.last_use; });
+
+        // evicted resources are released outside of the lock
+        vector<shared_ptr<IResource>> evicted;
+        uint64_t evicted_bytes = 0;
+        {
+            lock_guard<mutex> guard(m_mutex);
+            for (const Candidate& candidate : candidates)
+            {
+                const bool is_gpu = is_gpu_resource(candidate.resource);
+                uint64_t& usage   = is_gpu ? usage_gpu : usage_cpu;
+                if (usage <= (is_gpu ? budget_gpu : budget_cpu))
+                    continue;
+
+                // skip it if it was looked up or removed since the candidates were gathered
+                auto it = records.find(candidate.resource);
+                if (it == records.end() || it->second.last_use != candidate.last_use || m_resources[it->second.position].use_count() > 1)
+                    continue;
+
+                evicted.emplace_back(remove(candidate.resource));
+                usage         -= min(usage, candidate.size);
+                evicted_bytes += candidate.size;
+            }
+        }
+
+        if (!evicted.empty())
+        {
+            SP_LOG_INFO("Evicted %u resources (%.1f MB), cpu: %.1f/%.1f MB, gpu: %.1f/%.1f MB",
+                static_cast<uint32_t>(evicted.size()),
+                static_cast<float>(evicted_bytes) / (1024.0f * 1024.0f),
+                static_cast<float>(usage_cpu)     / (1024.0f * 1024.0f), static_cast<float>(budget_cpu) / (1024.0f * 1024.0f),
+                static_cast<float>(usage_gpu)     / (1024.0f * 1024.0f), static_cast<float>(budget_gpu) / (1024.0f * 1024.0f)
+            );
+
+            // the renderer rebuilds its bindless texture array, in case an evicted texture was still in it
+            SP_FIRE_EVENT(EventType::MaterialOnChanged);
+        }
+    }
+
+    void ResourceCache::SetMemoryBudgetMb(const uint64_t cpu_mb, const uint64_t gpu_mb)
+    {
+        budget_cpu_mb = cpu_mb;
+        budget_gpu_mb = gpu_mb;
+    }
+
+    uint64_t ResourceCache::GetMemoryBudgetCpuMb()
+    {
+        return budget_cpu_mb != 0 ? budget_cpu_mb : budget_cpu_mb_automatic;
+    }
+
+    uint64_t ResourceCache::GetMemoryBudgetGpuMb()
+    {
+        return budget_gpu_mb != 0 ? budget_gpu_mb : static_cast<uint64_t>(static_cast<float>(RHI_Device::MemoryGetBudgetMb()) * budget_gpu_device_share);
+    }
+
     void ResourceCache::Serialize()
     {
         // todo: since we won't be using custom file formats, we just need to save the resource paths, simple and reliable
@@ -158,8 +489,19 @@ namespace spartan
 
     void ResourceCache::Shutdown()
     {
-        uint32_t resource_count = static_cast<uint32_t>(m_resources.size());
-        m_resources.clear();
+        // the resources are released outside of the lock, in case their destructors reach back into the cache
+        vector<shared_ptr<IResource>> resources;
+        {
+            lock_guard<mutex> guard(m_mutex);
+            index_path.clear();
+            index_name.clear();
+            index_id.clear();
+            records.clear();
+            resources.swap(m_resources);
+        }
+
+        uint32_t resource_count = static_cast<uint32_t>(resources.size());
+        resources.clear();
         SP_LOG_INFO("%d resources have been cleared", resource_count);
     }
 
@@ -213,7 +555,7 @@ namespace spartan
         return "Data";
     }
 
-    vector<shared_ptr<IResource>>& ResourceCache::GetResources()
+    const vector<shared_ptr<IResource>>& ResourceCache::GetResources()
     {
         return m_resources;
     }
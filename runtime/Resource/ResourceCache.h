@@ -31,12 +31,15 @@ namespace spartan
 {
     enum class ResourceDirectory
     {
+        DerivedData,
         Environment,
         Fonts,
         Icons,
         ShaderCompiler,
         Shaders,
-        Textures
+        Textures,
+        ShaderCache,
+        TextureCache
     };
 
     class ResourceCache
@@ -46,7 +49,7 @@ namespace spartan
         static void Shutdown();
 
         // get by name
-        static std::shared_ptr<IResource>& GetByName(const std::string& name, ResourceType type);
+        static std::shared_ptr<IResource> GetByName(const std::string& name, ResourceType type);
         template <class T> 
         static std::shared_ptr<T> GetByName(const std::string& name) 
         { 
@@ -57,18 +60,16 @@ namespace spartan
         static std::vector<std::shared_ptr<IResource>> GetByType(ResourceType type = ResourceType::Max);
 
         // get by path
+        static std::shared_ptr<IResource> GetByPath(const std::string& path, ResourceType type);
         template <class T>
         static std::shared_ptr<T> GetByPath(const std::string& path)
         {
-            for (std::shared_ptr<IResource>& resource : GetResources())
-            {
-                if (path == resource->GetResourceFilePath())
-                    return std::static_pointer_cast<T>(resource);
-            }
-
-            return nullptr;
+            return std::static_pointer_cast<T>(GetByPath(path, IResource::TypeToEnum<T>()));
         }
 
+        // get by id
+        static std::shared_ptr<IResource> GetById(const uint64_t id);
+
         // caches resource, or replaces with existing cached resource
         template <class T>
         static std::shared_ptr<T> Cache(const std::shared_ptr<T> resource)
@@ -76,13 +77,7 @@ namespace spartan
             if (!resource)
                 return nullptr;
 
-            // if cached, return the cached resource
-            if (IsCached(resource->GetResourceFilePath(), resource->GetResourceType()))
-                return GetByPath<T>(resource->GetResourceFilePath());
-
-            // if not, cache it and return the cached resource
-            std::lock_guard<std::mutex> guard(GetMutex());
-            return std::static_pointer_cast<T>(GetResources().emplace_back(resource));
+            return std::static_pointer_cast<T>(CacheResource(resource));
         }
 
         // loads a resource and adds it to the resource cache
@@ -96,9 +91,8 @@ namespace spartan
             }
 
             // check if the resource is already loaded
-            const std::string name = FileSystem::GetFileNameWithoutExtensionFromFilePath(file_path);
-            if (IsCached(name, IResource::TypeToEnum<T>()))
-                return GetByName<T>(name);
+            if (std::shared_ptr<T> resource = GetByPath<T>(file_path))
+                return resource;
 
             // create new resource
             std::shared_ptr<T> resource = std::make_shared<T>();
@@ -124,25 +118,21 @@ namespace spartan
             if (!resource)
                 return;
 
-            if (!IsCached(resource->GetObjectName(), resource->GetResourceType()))
-                return;
-
-            GetResources().erase
-            (
-                std::remove_if
-                (
-                    GetResources().begin(),
-                    GetResources().end(),
-                    [](std::shared_ptr<IResource> resource) { return dynamic_cast<SpartanObject*>(resource.get())->GetObjectId() == resource->GetObjectId(); }
-                ),
-                GetResources().end()
-            );
+            RemoveResource(resource.get());
         }
 
         // memory
         static uint64_t GetMemoryUsage(ResourceType type = ResourceType::Max);
         static uint32_t GetResourceCount(ResourceType type = ResourceType::Max);
 
+        // eviction of least recently used resources which nothing references, they are reloaded on demand
+        // textures count against the gpu budget and everything else against the cpu budget, zero means automatic
+        static void Tick();
+        static void Evict();
+        static void SetMemoryBudgetMb(const uint64_t cpu_mb, const uint64_t gpu_mb);
+        static uint64_t GetMemoryBudgetCpuMb();
+        static uint64_t GetMemoryBudgetGpuMb();
+
         // directories
         static void AddResourceDirectory(ResourceDirectory type, const std::string& directory);
         static std::string GetResourceDirectory(ResourceDirectory type);
@@ -152,14 +142,15 @@ namespace spartan
         static std::string GetDataDirectory();
 
         // misc
-        static std::vector<std::shared_ptr<IResource>>& GetResources();
+        static const std::vector<std::shared_ptr<IResource>>& GetResources();
         static std::mutex& GetMutex();
         static bool GetUseRootShaderDirectory();
         static void SetUseRootShaderDirectory(const bool use_root_shader_directory);
 
     private:
-        static bool IsCached(const uint64_t resource_id);
-        static bool IsCached(const std::string& file_path, const ResourceType resource_type);
+        // paths and names are indexed when a resource is cached, so they should be set before that
+        static std::shared_ptr<IResource> CacheResource(const std::shared_ptr<IResource>& resource);
+        static void RemoveResource(IResource* resource);
 
         // event handlers
         static void Serialize();
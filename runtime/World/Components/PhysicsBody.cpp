@@ -32,6 +32,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../Game/Car.h"
 #include "../../Physics/Physics.h"
 #include "../../Physics/BulletPhysicsHelper.h"
+#include "../../Physics/PhysicsShapeCache.h"
 #include "../Rendering/Renderer.h"
 #include "ProgressTracker.h"
 SP_WARNINGS_OFF
@@ -42,8 +43,8 @@ SP_WARNINGS_OFF
 #include <BulletCollision/CollisionShapes/btCapsuleShape.h>
 #include <BulletCollision/CollisionShapes/btConeShape.h>
 #include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
-#include <BulletCollision/CollisionShapes/btTriangleMesh.h>
 #include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btConvexHullShape.h>
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
@@ -86,7 +87,7 @@ namespace spartan
             return transform;
         }
 
-        bool can_player_fit(Entity* entity, const vector<RHI_Vertex_PosTexNorTan>& vertices, const Vector3& scale)
+        bool can_player_fit(Entity* entity, span<const RHI_Vertex_PosTexNorTan> vertices, const Vector3& scale)
         {
             const BoundingBox& bounding_box = entity->GetComponent<Renderable>()->GetBoundingBox(BoundingBoxType::Transformed);
         
@@ -124,7 +125,12 @@ namespace spartan
     class MotionState : public btMotionState
     {
     public:
-        MotionState(PhysicsBody* rigid_body_) { m_rigid_body = rigid_body_; }
+        MotionState(PhysicsBody* rigid_body_)
+        {
+            m_rigid_body = rigid_body_;
+            getWorldTransform(m_transform_current);
+            m_transform_previous = m_transform_current;
+        }
 
         // engine -> bullet
         void getWorldTransform(btTransform& transform) const override
@@ -136,17 +142,49 @@ namespace spartan
             transform.setRotation(quaternion_to_bt(last_rotation));
         }
 
-        // bullet -> engine
+        // bullet -> engine, called after every substep, the entity is updated once per frame by Apply()
         void setWorldTransform(const btTransform& transform) override
         {
-            const Quaternion new_rotation = bt_to_quaternion(transform.getRotation());
-            const Vector3 new_position    = bt_to_vector(transform.getOrigin()) - new_rotation * m_rigid_body->GetCenterOfMass();
+            m_transform_previous = m_transform_current;
+            m_transform_current  = transform;
+            m_dirty              = true;
+        }
+
+        // forget the previous state, for teleports and bodies that went to sleep
+        void Reset(const btTransform& transform)
+        {
+            if (m_transform_previous == transform && m_transform_current == transform)
+                return;
+
+            m_transform_previous = transform;
+            m_transform_current  = transform;
+            m_dirty              = true;
+        }
+
+        // moves the entity between the last two physics states, so it doesn't snap to the 200 Hz steps
+        void Apply(const float alpha)
+        {
+            if (!m_dirty)
+                return;
+
+            const btQuaternion rotation = m_transform_previous.getRotation().slerp(m_transform_current.getRotation(), alpha);
+            const btVector3 origin      = m_transform_previous.getOrigin().lerp(m_transform_current.getOrigin(), alpha);
+
+            const Quaternion new_rotation = bt_to_quaternion(rotation);
+            const Vector3 new_position    = bt_to_vector(origin) - new_rotation * m_rigid_body->GetCenterOfMass();
 
             m_rigid_body->GetEntity()->SetPosition(new_position);
             m_rigid_body->GetEntity()->SetRotation(new_rotation);
+
+            // once both states agree there is nothing left to interpolate
+            m_dirty = !(m_transform_previous == m_transform_current);
         }
+
     private:
         PhysicsBody* m_rigid_body;
+        btTransform m_transform_previous;
+        btTransform m_transform_current;
+        bool m_dirty = true;
     };
 
     PhysicsBody::PhysicsBody(Entity* entity) : Component(entity)
@@ -184,6 +222,7 @@ namespace spartan
 
         delete static_cast<btCollisionShape*>(m_shape);
         m_shape = nullptr;
+        m_shape_shared.reset();
     }
 
     void PhysicsBody::OnStart()
@@ -210,6 +249,18 @@ namespace spartan
                 SetAngularVelocity(Vector3::Zero, false);
             }
         }
+        else if (m_rigid_body && !rigid_body->isStaticOrKinematicObject())
+        {
+            MotionState* motion_state = static_cast<MotionState*>(rigid_body->getMotionState());
+
+            // bullet stops updating sleeping bodies, so settle them on their last state
+            if (!rigid_body->isActive())
+            {
+                motion_state->Reset(rigid_body->getWorldTransform());
+            }
+
+            motion_state->Apply(Physics::GetInterpolationAlpha());
+        }
 
         if (m_body_type == PhysicsBodyType::Vehicle)
         {
@@ -470,6 +521,12 @@ namespace spartan
         transform_world_interpolated.setOrigin(transform_world.getOrigin());
         rigid_body->setInterpolationWorldTransform(transform_world_interpolated);
 
+        // a teleport, don't interpolate from the old position
+        if (btMotionState* motion_state = rigid_body->getMotionState())
+        {
+            static_cast<MotionState*>(motion_state)->Reset(transform_world);
+        }
+
         if (activate)
         {
             Activate();
@@ -505,6 +562,12 @@ namespace spartan
         }
         rigid_body->setInterpolationWorldTransform(interpTrans);
 
+        // a teleport, don't interpolate from the old rotation
+        if (btMotionState* motion_state = rigid_body->getMotionState())
+        {
+            static_cast<MotionState*>(motion_state)->Reset(transform_world);
+        }
+
         rigid_body->updateInertiaTensor();
 
         if (activate)
@@ -730,16 +793,29 @@ namespace spartan
         Vector3 ray_start = bt_to_vector(rigid_body->getWorldTransform().getOrigin());
         ray_start.y       = min_y + 0.1f; // offset of 0.1f to avoid starting inside/at the ground
 
-        // return the first hit
-        vector<btRigidBody*> hit_bodies = Physics::RayCast(ray_start, ray_start - Vector3(0.0f, 0.2f, 0.0f));
-        for (btRigidBody* hit_body : hit_bodies)
+        // one ray down the middle and one at each side of the footprint, so that standing on an edge counts
+        const float footprint_x = (aabb_max.x() - aabb_min.x()) * 0.25f;
+        const float footprint_z = (aabb_max.z() - aabb_min.z()) * 0.25f;
+        const array<Vector3, 5> offsets =
+        {
+            Vector3::Zero,
+            Vector3(footprint_x, 0.0f, 0.0f), Vector3(-footprint_x, 0.0f, 0.0f),
+            Vector3(0.0f, 0.0f, footprint_z), Vector3(0.0f, 0.0f, -footprint_z)
+        };
+
+        // any hit, other than ourselves
+        array<PhysicsQuery, 5> queries;
+        for (uint32_t i = 0; i < queries.size(); i++)
         {
-            // ensure we are not hitting ourselves
-            if (hit_body != rigid_body)
-                return true;
+            queries[i].start  = ray_start + offsets[i];
+            queries[i].end    = queries[i].start - Vector3(0.0f, 0.2f, 0.0f);
+            queries[i].ignore = rigid_body;
         }
 
-        return false;
+        array<PhysicsHit, 5> hits;
+        Physics::Query(queries.data(), hits.data(), static_cast<uint32_t>(queries.size()));
+
+        return any_of(hits.begin(), hits.end(), [](const PhysicsHit& hit) { return hit.body != nullptr; });
     }
 
     Vector3 PhysicsBody::RayTraceIsNearStairStep(const Vector3& forward) const
@@ -764,7 +840,14 @@ namespace spartan
 
         Renderer::DrawDirectionalArrow(ray_start, ray_end, 0.1f);
 
-        Vector3 hit_position = Physics::RayCastFirstHitPosition(ray_start, ray_end);
+        PhysicsQuery query;
+        query.start  = ray_start;
+        query.end    = ray_end;
+        query.ignore = rigid_body;
+
+        PhysicsHit hit;
+        Physics::Query(&query, &hit, 1);
+        const Vector3& hit_position = hit.position;
 
         bool is_scalable = helper::Abs(hit_position.y - min_y) <= max_scalable_height;
         bool is_above    = hit_position.y > min_y;
@@ -809,6 +892,7 @@ namespace spartan
             delete shape;
             m_shape = nullptr;
         }
+        m_shape_shared.reset();
 
         Vector3 size = m_size * GetEntity()->GetScale();
 
@@ -879,79 +963,77 @@ namespace spartan
 
             case PhysicsShape::Mesh:
             {
-                // get common prerequisites for certain shapes
-                vector<uint32_t> indices;
-                vector<RHI_Vertex_PosTexNorTan> vertices;
                 shared_ptr<Renderable> renderable = GetEntity()->GetComponent<Renderable>();
             
                 // get renderable
-                if (!renderable)
+                if (!renderable || !renderable->HasMesh())
                 {
                     SP_LOG_WARNING("PhysicsShape::Mesh requires a renderable component to be present");
                     return;
                 }
 
-                // get geometry
-                renderable->GetGeometry(&indices, &vertices);
-                if (vertices.empty())
+                // get geometry, it's read in place, shapes are built from it only once per unique mesh range
+                SubMesh range;
+                range.vertex_offset = renderable->GetVertexOffset();
+                range.vertex_count  = renderable->GetVertexCount();
+                range.index_offset  = renderable->GetIndexOffset();
+                range.index_count   = renderable->GetIndexCount();
+                if (range.vertex_count == 0 || range.index_count == 0)
                 {
                     SP_LOG_WARNING("PhysicsShape::Mesh requires the renderable component to contain vertices");
                     return;
                 }
+                Mesh* mesh = renderable->GetMesh();
+                span<const RHI_Vertex_PosTexNorTan> vertices(mesh->GetVertices().data() + range.vertex_offset, range.vertex_count);
 
                 // determine how much detail is needed for this shape
                 const bool is_enterable = can_player_fit(GetEntity(), vertices, size);
-                const bool convex_hull  = !is_enterable;
+                const bool is_dynamic   = m_mass > 0.0f && !m_is_kinematic;
 
-                if (convex_hull)
+                // the shared shape goes into a compound of the body's own, once per instance, compounds don't own their children
+                auto add_to_compound = [&](btCollisionShape* shape_shared)
                 {
-                    // create
-                    btConvexHullShape* shape_convex = new btConvexHullShape(
-                        reinterpret_cast<btScalar*>(&vertices[0]),
-                        static_cast<uint32_t>(vertices.size()),
-                        static_cast<uint32_t>(sizeof(RHI_Vertex_PosTexNorTan))
-                    );
-                    shape_convex->optimizeConvexHull();
-                    
-                    // add to compound
                     btCompoundShape* shape_compound = new btCompoundShape();
                     if (renderable->HasInstancing())
                     {
                         for (uint32_t instance_index = 0; instance_index < renderable->GetInstanceCount(); instance_index++)
                         {
                             Matrix world_transform = renderable->GetInstanceTransform(instance_index);
-                            shape_compound->addChildShape(compute_transform(world_transform.GetTranslation(), world_transform.GetRotation(), world_transform.GetScale()), shape_convex);
+                            shape_compound->addChildShape(compute_transform(world_transform.GetTranslation(), world_transform.GetRotation(), world_transform.GetScale()), shape_shared);
                         }
                     }
                     else
                     {
-                        shape_compound->addChildShape(compute_transform(Vector3::Zero, Quaternion::Identity, size), shape_convex);
+                        shape_compound->addChildShape(compute_transform(Vector3::Zero, Quaternion::Identity, size), shape_shared);
                     }
                     
                     m_shape = shape_compound;
+                };
+
+                if (!is_enterable)
+                {
+                    shared_ptr<btConvexHullShape> shape_convex = PhysicsShapeCache::GetConvexHull(mesh, range);
+                    add_to_compound(shape_convex.get());
+                    m_shape_shared = shape_convex;
+                }
+                else if (is_dynamic)
+                {
+                    // concave and dynamic, convex parts collide cheaply and keep the body simulated
+                    shared_ptr<btCompoundShape> shape_parts = PhysicsShapeCache::GetConvexDecomposition(mesh, range);
+                    add_to_compound(shape_parts.get());
+                    m_shape_shared = shape_parts;
                 }
                 else
                 {
-                    // create
-                    btTriangleMesh* mesh = new btTriangleMesh();
-                    for (uint32_t i = 0; i < static_cast<uint32_t>(indices.size()); i += 3)
-                    {
-                        btVector3 vertex0(vertices[indices[i]].pos[0],     vertices[indices[i]].pos[1],     vertices[indices[i]].pos[2]);
-                        btVector3 vertex1(vertices[indices[i + 1]].pos[0], vertices[indices[i + 1]].pos[1], vertices[indices[i + 1]].pos[2]);
-                        btVector3 vertex2(vertices[indices[i + 2]].pos[0], vertices[indices[i + 2]].pos[1], vertices[indices[i + 2]].pos[2]);
-
-                        mesh->addTriangle(vertex0, vertex1, vertex2);
-                    }
-
-                    // convert to btBvhTriangleMeshShape
-                    btBvhTriangleMeshShape* shape_triangle_mesh = new btBvhTriangleMeshShape(mesh, true);
-                    shape_triangle_mesh->setLocalScaling(vector_to_bt(size));
+                    // get the shared bvh, the scale is applied by a wrapper so that bodies of any scale can share it
+                    shared_ptr<btBvhTriangleMeshShape> shape_triangle_mesh = PhysicsShapeCache::GetTriangleMesh(mesh, range);
 
                     // btBvhTriangleMeshShape is static and expensive to collide with
                     m_is_kinematic = true;
                     m_mass         = 0.0f;
 
-                    m_shape = shape_triangle_mesh;
+                    m_shape        = new btScaledBvhTriangleMeshShape(shape_triangle_mesh.get(), vector_to_bt(size));
+                    m_shape_shared = shape_triangle_mesh;
                 }
 
                 break;
@@ -182,6 +182,7 @@ namespace spartan
         uint32_t terrain_width         = 0;
         uint32_t terrain_length        = 0;
         void* m_shape                  = nullptr;
+        std::shared_ptr<void> m_shape_shared; // geometry shared with other bodies, m_shape wraps it
         void* m_rigid_body             = nullptr;
         std::shared_ptr<Car> m_car     = nullptr;
         std::vector<Constraint*> m_constraints;
@@ -91,6 +91,7 @@ namespace spartan
         RHI_Buffer* GetIndexBuffer() const;
         RHI_Buffer* GetVertexBuffer() const;
         const std::string& GetMeshName() const;
+        Mesh* GetMesh() const { return m_mesh; }
 
         // instancing
         bool HasInstancing() const                              { return !m_instances.empty(); }
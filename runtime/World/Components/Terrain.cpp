@@ -31,6 +31,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "../../Rendering/Mesh.h"
 #include "../../Core/ThreadPool.h"
 #include "../../Core/ProgressTracker.h"
+#include "../../Core/Stopwatch.h"
+#include "../../Rendering/Renderer.h"
+#include "Camera.h"
 //=======================================
 
 //= NAMESPACES ===============
@@ -42,469 +45,586 @@ namespace spartan
 {
     namespace
     {
-        const uint32_t smoothing_iterations = 1; // the number of height map neighboring pixel averaging
-        const uint32_t tile_count           = 8; // the number of tiles in each dimension to split the terrain into
+        const uint32_t smoothing_iterations = 1;    // the number of height map neighboring pixel averaging
+        const uint32_t patch_quads          = 32;   // quads per side of the grid that every quadtree node draws, must match the terrain vertex shader
+        const float lod_range               = 5.0f; // a level is drawn up to this many node sizes away from the camera, enough for neighbors to never be more than a level apart
+
+        // splits rows across the thread pool, small jobs stay on the calling thread
+        void for_each_row(const uint32_t row_count, const function<void(uint32_t row_start, uint32_t row_end)>& task)
+        {
+            if (row_count >= 64)
+            {
+                ThreadPool::ParallelLoop([&task](uint32_t row_start, uint32_t row_end) { task(row_start, row_end); }, row_count);
+            }
+            else
+            {
+                task(0, row_count);
+            }
+        }
+
+        // a 3x3 box filter as two 3 tap passes, edge pixels average only the neighbors they have, like before
+        void smooth(vector<float>& heights, const uint32_t width, const uint32_t height)
+        {
+            // sums along x
+            vector<float> sums(heights.size());
+            for_each_row(height, [&](uint32_t row_start, uint32_t row_end)
+            {
+                for (uint32_t y = row_start; y < row_end; y++)
+                {
+                    const float* in = &heights[y * width];
+                    float* out      = &sums[y * width];
+
+                    if (width == 1)
+                    {
+                        out[0] = in[0];
+                        continue;
+                    }
+
+                    out[0]         = in[0] + in[1];
+                    out[width - 1] = in[width - 2] + in[width - 1];
+
+                    uint32_t x = 1;
+                #if defined(__AVX2__)
+                    for (; x + 8 < width; x += 8)
+                    {
+                        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(in + x - 1), _mm256_loadu_ps(in + x));
+                        _mm256_storeu_ps(out + x, _mm256_add_ps(sum, _mm256_loadu_ps(in + x + 1)));
+                    }
+                #endif
+                    for (; x + 1 < width; x++)
+                    {
+                        out[x] = in[x - 1] + in[x] + in[x + 1];
+                    }
+                }
+            });
+
+            // the neighbor count of each column, the rows multiply theirs in
+            vector<float> column_weights(width, 1.0f / 3.0f);
+            column_weights[0]         = width > 1 ? 0.5f : 1.0f;
+            column_weights[width - 1] = width > 1 ? 0.5f : 1.0f;
+
+            // sums along y, then the average
+            for_each_row(height, [&](uint32_t row_start, uint32_t row_end)
+            {
+                for (uint32_t y = row_start; y < row_end; y++)
+                {
+                    const float* above = &sums[(y > 0 ? y - 1 : y) * width];
+                    const float* row   = &sums[y * width];
+                    const float* below = &sums[(y + 1 < height ? y + 1 : y) * width];
+                    float* out         = &heights[y * width];
+
+                    // at the edges the missing row is replaced by zeros
+                    const float weight_above = y > 0 ? 1.0f : 0.0f;
+                    const float weight_below = y + 1 < height ? 1.0f : 0.0f;
+                    const float row_weight   = 1.0f / (1.0f + weight_above + weight_below);
+
+                    uint32_t x = 0;
+                #if defined(__AVX2__)
+                    const __m256 v_weight_above = _mm256_set1_ps(weight_above);
+                    const __m256 v_weight_below = _mm256_set1_ps(weight_below);
+                    const __m256 v_row_weight   = _mm256_set1_ps(row_weight);
+                    for (; x + 8 <= width; x += 8)
+                    {
+                        __m256 sum = _mm256_loadu_ps(row + x);
+                        sum        = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(above + x), v_weight_above));
+                        sum        = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(below + x), v_weight_below));
+                        sum        = _mm256_mul_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(&column_weights[x]), v_row_weight));
+                        _mm256_storeu_ps(out + x, sum);
+                    }
+                #endif
+                    for (; x < width; x++)
+                    {
+                        const float sum = row[x] + above[x] * weight_above + below[x] * weight_below;
+                        out[x]          = sum * column_weights[x] * row_weight;
+                    }
+                }
+            });
+        }
 
         bool generate_height_points_from_height_map(vector<float>& height_data_out, RHI_Texture* height_texture, float min_y, float max_y)
         {
-            vector<byte> height_data = height_texture->GetMip(0, 0).bytes;
+            const vector<byte>& height_data = height_texture->GetMip(0, 0).bytes;
             SP_ASSERT(height_data.size() > 0);
 
+            const uint32_t width  = height_texture->GetWidth();
+            const uint32_t height = height_texture->GetHeight();
+
             // read from the red channel and save a normalized height value
             {
                 // bytes per pixel
                 uint32_t bytes_per_pixel = (height_texture->GetChannelCount() * height_texture->GetBitsPerChannel()) / 8;
 
-                // normalize and scale height data
+                // normalize and scale height data, greyscale 16-bit height maps are imported as normalized floats and color ones as rgba16
                 height_data_out.resize(height_data.size() / bytes_per_pixel);
-                for (uint32_t i = 0; i < height_data.size(); i += bytes_per_pixel)
+                const uint32_t bits = height_texture->GetBitsPerChannel();
+                const float scale   = (max_y - min_y) / (bits == 32 ? 1.0f : (bits == 16 ? 65535.0f : 255.0f));
+                for_each_row(height, [&](uint32_t row_start, uint32_t row_end)
                 {
-                    // assuming the height is stored in the red channel (first channel)
-                    height_data_out[i / bytes_per_pixel] = min_y + (static_cast<float>(height_data[i]) / 255.0f) * (max_y - min_y);
-                }
-            }
-
-            // smooth out the height map values, this will reduce hard terrain edges
-            {
-                const uint32_t width  = height_texture->GetWidth();
-                const uint32_t height = height_texture->GetHeight();
-
-                for (uint32_t iteration = 0; iteration < smoothing_iterations; iteration++)
-                {
-                    vector<float> smoothed_height_data = height_data_out; // create a copy to store the smoothed data
-
-                    for (uint32_t y = 0; y < height; y++)
+                    for (uint32_t i = row_start * width; i < row_end * width; i++)
                     {
-                        for (uint32_t x = 0; x < width; x++)
+                        // assuming the height is stored in the red channel (first channel)
+                        float value = 0.0f;
+                        if (bits == 32)
                         {
-                            float sum      = height_data_out[y * width + x];
-                            uint32_t count = 1;
-
-                            // iterate over neighboring pixels
-                            for (int ny = -1; ny <= 1; ++ny)
-                            {
-                                for (int nx = -1; nx <= 1; ++nx)
-                                {
-                                    // skip self/center pixel
-                                    if (nx == 0 && ny == 0)
-                                        continue;
-
-                                    uint32_t neighbor_x = x + nx;
-                                    uint32_t neighbor_y = y + ny;
-
-                                    // check boundaries
-                                    if (neighbor_x >= 0 && neighbor_x < width && neighbor_y >= 0 && neighbor_y < height)
-                                    {
-                                        sum += height_data_out[neighbor_y * width + neighbor_x];
-                                        count++;
-                                    }
-                                }
-                            }
-
-                            // average the sum
-                            smoothed_height_data[y * width + x] = sum / static_cast<float>(count);
+                            memcpy(&value, &height_data[i * bytes_per_pixel], sizeof(float));
+                        }
+                        else if (bits == 16)
+                        {
+                            uint16_t value_16 = 0;
+                            memcpy(&value_16, &height_data[i * bytes_per_pixel], sizeof(uint16_t));
+                            value = static_cast<float>(value_16);
+                        }
+                        else
+                        {
+                            value = static_cast<float>(height_data[i * bytes_per_pixel]);
                         }
-                    }
 
-                    height_data_out = smoothed_height_data;
-                }
+                        height_data_out[i] = min_y + value * scale;
+                    }
+                });
+            }
 
+            // smooth out the height map values, this will reduce hard terrain edges
+            for (uint32_t iteration = 0; iteration < smoothing_iterations; iteration++)
+            {
+                smooth(height_data_out, width, height);
             }
 
             return true;
         }
 
-        void generate_positions(vector<Vector3>& positions, const vector<float>& height_map, const uint32_t width, const uint32_t height)
+        // two triangles per quad, each row of quads writes its own range
+        void generate_indices(vector<uint32_t>& indices, const uint32_t width, const uint32_t height)
         {
-            SP_ASSERT_MSG(!height_map.empty(), "Height map is empty");
-
-            for (uint32_t y = 0; y < height; y++)
+            for_each_row(height - 1, [&](uint32_t row_start, uint32_t row_end)
             {
-                for (uint32_t x = 0; x < width; x++)
+                for (uint32_t y = row_start; y < row_end; y++)
                 {
-                    uint32_t index = y * width + x;
+                    uint32_t k = y * (width - 1) * 6;
+                    for (uint32_t x = 0; x < width - 1; x++)
+                    {
+                        const uint32_t index_bottom_left  = y * width + x;
+                        const uint32_t index_bottom_right = y * width + x + 1;
+                        const uint32_t index_top_left     = (y + 1) * width + x;
+                        const uint32_t index_top_right    = (y + 1) * width + x + 1;
+
+                        indices[k + 0] = index_bottom_right;
+                        indices[k + 1] = index_bottom_left;
+                        indices[k + 2] = index_top_left;
+                        indices[k + 3] = index_bottom_right;
+                        indices[k + 4] = index_top_left;
+                        indices[k + 5] = index_top_right;
+
+                        k += 6; // next quad
+                    }
+                }
+            });
+        }
 
-                    // center on the X and Z axis
-                    float centered_x = static_cast<float>(x) - width * 0.5f;
-                    float centered_z = static_cast<float>(y) - height * 0.5f;
+        // small and fast, one per task, seeded from the terrain seed and the task so that results don't depend on thread scheduling
+        struct random_generator
+        {
+            random_generator(const uint64_t seed, const uint64_t stream)
+            {
+                // splitmix64, spreads nearby seeds apart
+                state = seed ^ (stream * 0x9E3779B97F4A7C15ull);
+                for (uint32_t i = 0; i < 2; i++)
+                {
+                    state += 0x9E3779B97F4A7C15ull;
+                    uint64_t z = state;
+                    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                    state = z ^ (z >> 31);
+                }
+                state |= 1; // xorshift can't recover from zero
+            }
 
-                    // get height from height_map
-                    float height_value = height_map[index]; 
+            uint32_t next()
+            {
+                // xorshift64*
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                return static_cast<uint32_t>((state * 0x2545F4914F6CDD1Dull) >> 32);
+            }
 
-                    positions[index] = Vector3(centered_x, height_value, centered_z);
-                }
+            float next_float(const float from = 0.0f, const float to = 1.0f)
+            {
+                return from + (to - from) * static_cast<float>(next() >> 8) * (1.0f / 16777216.0f);
             }
-        }
 
-        void generate_vertices_and_indices(vector<RHI_Vertex_PosTexNorTan>& vertices, vector<uint32_t>& indices, const vector<Vector3>& positions, const uint32_t width, const uint32_t height)
+            uint64_t state = 0;
+        };
+
+        // a quad of the height map is suitable when all of its corners are above the shore and it's not too steep
+        void compute_scatter_mask(const vector<float>& height_map, const uint32_t width, const uint32_t height, const float max_slope_radians, vector<uint8_t>& mask, uint64_t& valid_quads)
         {
-            SP_ASSERT_MSG(!positions.empty(), "Positions are empty");
+            const uint32_t quads_x     = width - 1;
+            const uint32_t quads_z     = height - 1;
+            const float sea_level      = 0.0f;             // this is a fact across the engine
+            const float min_height     = sea_level + 4.0f; // don't want things to grow too close to see level (where sand could be)
+            const float min_normal_y   = cos(max_slope_radians);
 
-            Vector3 offset = Vector3::Zero;
-            {
-                // calculate offsets to center the terrain
-                float offset_x   = -static_cast<float>(width) * 0.5f;
-                float offset_z   = -static_cast<float>(height) * 0.5f;
-                float min_height = FLT_MAX;
+            mask.resize(static_cast<size_t>(quads_x) * quads_z);
+            vector<uint32_t> valid_per_row(quads_z, 0);
 
-                // find the minimum height to align the lower part of the terrain at y = 0
-                for (const Vector3& pos : positions)
+            for_each_row(quads_z, [&](uint32_t row_start, uint32_t row_end)
+            {
+                for (uint32_t z = row_start; z < row_end; z++)
                 {
-                    if (pos.y < min_height)
+                    uint32_t valid = 0;
+                    for (uint32_t x = 0; x < quads_x; x++)
                     {
-                        min_height = pos.y;
+                        const float h00 = height_map[z * width + x];
+                        const float h10 = height_map[z * width + x + 1];
+                        const float h01 = height_map[(z + 1) * width + x];
+                        const float h11 = height_map[(z + 1) * width + x + 1];
+
+                        // the normal of a unit quad from its diagonals
+                        const float slope_x = ((h10 - h00) + (h11 - h01)) * 0.5f;
+                        const float slope_z = ((h01 - h00) + (h11 - h10)) * 0.5f;
+                        const float normal_y = 1.0f / sqrt(slope_x * slope_x + 1.0f + slope_z * slope_z);
+
+                        const bool is_valid = min(min(h00, h10), min(h01, h11)) >= min_height && normal_y >= min_normal_y;
+                        mask[z * quads_x + x] = is_valid ? 1 : 0;
+                        valid += is_valid ? 1 : 0;
                     }
+                    valid_per_row[z] = valid;
                 }
+            });
 
-                offset = Vector3(offset_x, -min_height, offset_z);
-            }
-
-            uint32_t index = 0;
-            uint32_t k     = 0;
-            for (uint32_t y = 0; y < height - 1; y++)
+            valid_quads = 0;
+            for (uint32_t valid : valid_per_row)
             {
-                for (uint32_t x = 0; x < width - 1; x++)
-                {
-                    Vector3 position = positions[index] + offset;
-
-                    float u = static_cast<float>(x) / static_cast<float>(width - 1);
-                    float v = static_cast<float>(y) / static_cast<float>(height - 1);
-
-                    const uint32_t index_bottom_left  = y * width + x;
-                    const uint32_t index_bottom_right = y * width + x + 1;
-                    const uint32_t index_top_left     = (y + 1) * width + x;
-                    const uint32_t index_top_right    = (y + 1) * width + x + 1;
-
-                    // bottom right of quad
-                    index           = index_bottom_right;
-                    indices[k]      = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u + 1.0f / (width - 1), v + 1.0f / (height - 1)));
-
-                    // bottom left of quad
-                    index           = index_bottom_left;
-                    indices[k + 1]  = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u, v + 1.0f / (height - 1)));
-
-                    // top left of quad
-                    index           = index_top_left;
-                    indices[k + 2]  = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u, v));
-
-                    // bottom right of quad
-                    index           = index_bottom_right;
-                    indices[k + 3]  = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u + 1.0f / (width - 1), v + 1.0f / (height - 1)));
-
-                    // top left of quad
-                    index           = index_top_left;
-                    indices[k + 4]  = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u, v));
-
-                    // top right of quad
-                    index           = index_top_right;
-                    indices[k + 5]  = index;
-                    vertices[index] = RHI_Vertex_PosTexNorTan(positions[index], Vector2(u + 1.0f / (width - 1), v));
-
-                    k += 6; // next quad
-                }
+                valid_quads += valid;
             }
         }
 
-        void generate_normals(const vector<uint32_t>& indices, vector<RHI_Vertex_PosTexNorTan>& vertices)
+        struct scatter_point
+        {
+            Vector2 position; // in height map space
+            uint32_t rank;    // random, the lowest ranks are kept when there are more points than requested
+            float rotation;   // degrees around the up axis
+            float scale;
+        };
+
+        // poisson disk dart throwing over a grid of r/sqrt(2) cells, each cell holds at most one point
+        // the cells are grouped into tiles which are processed in four passes, so that tiles running at the same
+        // time are never adjacent, a tile only reads the cells of its neighbors, which makes the result independent of thread timing
+        void scatter_poisson_disk(const vector<uint8_t>& mask, const uint32_t quads_x, const uint32_t quads_z, const float radius, const uint64_t seed, vector<scatter_point>& points)
         {
-            SP_ASSERT_MSG(!indices.empty(), "Indices are empty");
-            SP_ASSERT_MSG(!vertices.empty(), "Vertices are empty");
+            const uint32_t tile_cells     = 32; // a tile is far wider than the radius, so only adjacent tiles can conflict
+            const uint32_t darts_per_cell = 8;
+            const float cell_size         = radius / sqrt(2.0f);
+            const uint32_t cells_x        = static_cast<uint32_t>(ceil(quads_x / cell_size));
+            const uint32_t cells_z        = static_cast<uint32_t>(ceil(quads_z / cell_size));
+            const uint32_t tiles_x        = (cells_x + tile_cells - 1) / tile_cells;
+            const uint32_t tiles_z        = (cells_z + tile_cells - 1) / tile_cells;
+            const float radius_squared    = radius * radius;
+
+            vector<Vector2> grid(static_cast<size_t>(cells_x) * cells_z, Vector2(-1.0f, -1.0f)); // negative means empty
+            vector<vector<scatter_point>> tile_points(static_cast<size_t>(tiles_x) * tiles_z);
+
+            for (uint32_t pass = 0; pass < 4; pass++)
+            {
+                // tiles of this pass, every other tile in both dimensions
+                const uint32_t offset_x    = pass & 1;
+                const uint32_t offset_z    = pass >> 1;
+                const uint32_t pass_tiles_x = (tiles_x - offset_x + 1) / 2;
+                const uint32_t pass_tiles_z = (tiles_z - offset_z + 1) / 2;
+                if (pass_tiles_x == 0 || pass_tiles_z == 0)
+                    continue;
+
+                ThreadPool::ParallelForEach([&](uint32_t pass_tile_index)
+                {
+                    const uint32_t tile_x     = offset_x + (pass_tile_index % pass_tiles_x) * 2;
+                    const uint32_t tile_z     = offset_z + (pass_tile_index / pass_tiles_x) * 2;
+                    const uint32_t tile_index = tile_z * tiles_x + tile_x;
+                    const uint32_t cell_x0    = tile_x * tile_cells;
+                    const uint32_t cell_z0    = tile_z * tile_cells;
+                    const uint32_t cell_x1    = min(cell_x0 + tile_cells, cells_x);
+                    const uint32_t cell_z1    = min(cell_z0 + tile_cells, cells_z);
+                    const float x_min         = cell_x0 * cell_size;
+                    const float z_min         = cell_z0 * cell_size;
+                    const float x_max         = min(cell_x1 * cell_size, static_cast<float>(quads_x));
+                    const float z_max         = min(cell_z1 * cell_size, static_cast<float>(quads_z));
+
+                    random_generator random(seed, tile_index);
+                    vector<scatter_point>& accepted = tile_points[tile_index];
+
+                    const uint32_t dart_count = (cell_x1 - cell_x0) * (cell_z1 - cell_z0) * darts_per_cell;
+                    for (uint32_t dart = 0; dart < dart_count; dart++)
+                    {
+                        const Vector2 position = Vector2(random.next_float(x_min, x_max), random.next_float(z_min, z_max));
+
+                        // masked out
+                        const uint32_t quad_x = min(static_cast<uint32_t>(position.x), quads_x - 1);
+                        const uint32_t quad_z = min(static_cast<uint32_t>(position.y), quads_z - 1);
+                        if (!mask[quad_z * quads_x + quad_x])
+                            continue;
+
+                        // occupied
+                        const uint32_t cell_x = min(static_cast<uint32_t>(position.x / cell_size), cells_x - 1);
+                        const uint32_t cell_z = min(static_cast<uint32_t>(position.y / cell_size), cells_z - 1);
+                        if (grid[cell_z * cells_x + cell_x].x >= 0.0f)
+                            continue;
+
+                        // too close to a neighbor, they can be at most two cells away
+                        bool is_too_close = false;
+                        for (uint32_t z = cell_z > 2 ? cell_z - 2 : 0; z <= min(cell_z + 2, cells_z - 1) && !is_too_close; z++)
+                        {
+                            for (uint32_t x = cell_x > 2 ? cell_x - 2 : 0; x <= min(cell_x + 2, cells_x - 1); x++)
+                            {
+                                const Vector2& neighbor = grid[z * cells_x + x];
+                                if (neighbor.x >= 0.0f && (neighbor - position).LengthSquared() < radius_squared)
+                                {
+                                    is_too_close = true;
+                                    break;
+                                }
+                            }
+                        }
 
-            uint32_t triangle_count = static_cast<uint32_t>(indices.size()) / 3;
-            vector<Vector3> face_normals(triangle_count);
-            vector<Vector3> face_tangents(triangle_count);
-            vector<vector<uint32_t>> vertex_to_triangle_map(vertices.size());
-            Vector3 edge_a, edge_b;
+                        if (is_too_close)
+                            continue;
 
-            for (uint32_t i = 0; i < triangle_count; ++i)
-            {
-                uint32_t index_a = indices[i * 3];
-                uint32_t index_b = indices[i * 3 + 1];
-                uint32_t index_c = indices[i * 3 + 2];
+                        grid[cell_z * cells_x + cell_x] = position;
+                        accepted.push_back({ position, random.next(), random.next_float(0.0f, 360.0f), random.next_float(0.5f, 1.5f) });
+                    }
+                }, pass_tiles_x * pass_tiles_z);
+            }
 
-                vertex_to_triangle_map[index_a].push_back(i);
-                vertex_to_triangle_map[index_b].push_back(i);
-                vertex_to_triangle_map[index_c].push_back(i);
+            // gather in tile order, so that the result only depends on the seed
+            points.clear();
+            for (const vector<scatter_point>& tile : tile_points)
+            {
+                points.insert(points.end(), tile.begin(), tile.end());
+            }
+        }
 
-                edge_a.x = vertices[index_a].pos[0] - vertices[index_b].pos[0];
-                edge_a.y = vertices[index_a].pos[1] - vertices[index_b].pos[1];
-                edge_a.z = vertices[index_a].pos[2] - vertices[index_b].pos[2];
+        vector<Matrix> generate_transforms(const vector<float>& height_map, const uint32_t width, const uint32_t height, const uint32_t count, const uint64_t seed,
+            const float max_slope_radians, const bool rotate_to_match_surface_normal, const float terrain_offset)
+        {
+            vector<Matrix> transforms;
+            if (count == 0 || width < 2 || height < 2)
+                return transforms;
 
-                edge_b.x = vertices[index_b].pos[0] - vertices[index_c].pos[0];
-                edge_b.y = vertices[index_b].pos[1] - vertices[index_c].pos[1];
-                edge_b.z = vertices[index_b].pos[2] - vertices[index_c].pos[2];
+            const uint32_t quads_x = width - 1;
+            const uint32_t quads_z = height - 1;
 
-                face_normals[i] = Vector3::Cross(edge_a, edge_b);
+            // evaluate where things can grow once, instead of rejecting them after they have been placed
+            vector<uint8_t> mask;
+            uint64_t valid_quads = 0;
+            compute_scatter_mask(height_map, width, height, max_slope_radians, mask, valid_quads);
+            if (valid_quads == 0)
+            {
+                SP_LOG_WARNING("There is no terrain area suitable for placing props");
+                return transforms;
+            }
 
-                const float tc_u1 = vertices[index_a].tex[0] - vertices[index_b].tex[0];
-                const float tc_v1 = vertices[index_a].tex[1] - vertices[index_b].tex[1];
-                const float tc_u2 = vertices[index_b].tex[0] - vertices[index_c].tex[0];
-                const float tc_v2 = vertices[index_b].tex[1] - vertices[index_c].tex[1];
+            // dart throwing fills about half of the densest packing, so aim for a radius that yields some extra
+            // points and keep a random subset of them, shrink the radius in the rare case that it's not enough
+            float radius = sqrt(0.4f * static_cast<float>(valid_quads) / static_cast<float>(count));
+            vector<scatter_point> points;
+            for (uint32_t attempt = 0; attempt < 4; attempt++)
+            {
+                scatter_poisson_disk(mask, quads_x, quads_z, radius, seed, points);
+                if (points.size() >= count)
+                    break;
 
-                float coef = 1.0f / (tc_u1 * tc_v2 - tc_u2 * tc_v1);
-                face_tangents[i] = coef * (tc_v2 * edge_a - tc_v1 * edge_b);
+                radius *= 0.75f;
             }
 
-            auto compute_vertex_normals_tangents = [&vertices, &vertex_to_triangle_map, &face_normals, &face_tangents](uint32_t start_index, uint32_t end_index)
+            if (points.size() > count)
             {
-                for (uint32_t i = start_index; i < end_index; i++)
+                nth_element(points.begin(), points.begin() + count, points.end(), [](const scatter_point& a, const scatter_point& b)
                 {
-                    Vector3 normal_average  = Vector3::Zero;
-                    Vector3 tangent_average = Vector3::Zero;
-                    float face_usage_count  = 0;
+                    return a.rank < b.rank || (a.rank == b.rank && (a.position.y < b.position.y || (a.position.y == b.position.y && a.position.x < b.position.x)));
+                });
+                points.resize(count);
+            }
+            else if (points.size() < count)
+            {
+                SP_LOG_WARNING("Only %u out of %u props fit on the terrain", static_cast<uint32_t>(points.size()), count);
+            }
 
-                    for (uint32_t j : vertex_to_triangle_map[i])
+            // place the points on the surface, the height is interpolated the same way the renderer interpolates the height map
+            const Vector2 half_size = Vector2(width * 0.5f, height * 0.5f);
+            transforms.resize(points.size());
+            for_each_row(static_cast<uint32_t>(points.size()), [&](uint32_t start, uint32_t end)
+            {
+                for (uint32_t i = start; i < end; i++)
+                {
+                    const scatter_point& point = points[i];
+                    const uint32_t x = min(static_cast<uint32_t>(point.position.x), quads_x - 1);
+                    const uint32_t z = min(static_cast<uint32_t>(point.position.y), quads_z - 1);
+                    const float fx   = point.position.x - x;
+                    const float fz   = point.position.y - z;
+
+                    const float h00 = height_map[z * width + x];
+                    const float h10 = height_map[z * width + x + 1];
+                    const float h01 = height_map[(z + 1) * width + x];
+                    const float h11 = height_map[(z + 1) * width + x + 1];
+                    const float h   = helper::Lerp(helper::Lerp(h00, h10, fx), helper::Lerp(h01, h11, fx), fz);
+
+                    // a terrain_offset avoids floating objects
+                    const Vector3 position = Vector3(point.position.x - half_size.x, h + terrain_offset, point.position.y - half_size.y);
+
+                    // rotation is a random rotation around the Y axis, and then rotated to match the normal of the surface
+                    Quaternion rotate_to_normal = Quaternion::Identity;
+                    if (rotate_to_match_surface_normal)
                     {
-                        normal_average  += face_normals[j];
-                        tangent_average += face_tangents[j];
-                        face_usage_count++;
+                        const float slope_x  = helper::Lerp(h10 - h00, h11 - h01, fz);
+                        const float slope_z  = helper::Lerp(h01 - h00, h11 - h10, fx);
+                        rotate_to_normal     = Quaternion::FromToRotation(Vector3::Up, Vector3(-slope_x, 1.0f, -slope_z).Normalized());
                     }
+                    Quaternion rotation = rotate_to_normal * Quaternion::FromEulerAngles(0.0f, point.rotation, 0.0f);
 
-                    if (face_usage_count > 0)
-                    {
-                        normal_average  /= face_usage_count;
-                        tangent_average /= face_usage_count;
-
-                        normal_average.Normalize();
-                        tangent_average.Normalize();
-
-                        vertices[i].nor[0] = normal_average.x;
-                        vertices[i].nor[1] = normal_average.y;
-                        vertices[i].nor[2] = normal_average.z;
-
-                        vertices[i].tan[0] = tangent_average.x;
-                        vertices[i].tan[1] = tangent_average.y;
-                        vertices[i].tan[2] = tangent_average.z;
-                    }
+                    transforms[i] = Matrix(position, rotation, Vector3(point.scale));
                 }
-            };
+            });
 
-            uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
-            ThreadPool::ParallelLoop(compute_vertex_normals_tangents, vertex_count);
+            return transforms;
         }
 
-        float get_random_float(float x, float y)
+        uint32_t get_nodes_per_side(const uint32_t lod_count, const uint32_t level)
         {
-            random_device rd;                        // obtain a random number from hardware
-            mt19937 gen(rd());                       // seed the generator
-            uniform_real_distribution<> distr(x, y); // define the distribution
-
-            return static_cast<float>(distr(gen));
+            return 1 << (lod_count - 1 - level);
         }
 
-        vector<Matrix> generate_transforms(const vector<RHI_Vertex_PosTexNorTan>& vertices, const vector<uint32_t>& indices,
-            uint32_t tree_count, float max_slope_radians, bool rotate_to_match_surface_normal,float terrain_offset)
+        // the min and max height of every quadtree node, leaves scan their texels and every level above merges its children
+        // nodes that fall outside of the height map are left with a min that is larger than their max
+        void compute_node_heights(const vector<float>& height_map, const uint32_t width, const uint32_t height, const uint32_t lod_count, vector<vector<Vector2>>& node_heights)
         {
-            vector<Matrix> transforms;
-            random_device seed;
-            mt19937 generator(seed());
-            uniform_int_distribution<> distribution(0, static_cast<int>(indices.size() / 3 - 1));
-
-            for (uint32_t i = 0; i < tree_count; ++i)
+            node_heights.resize(lod_count);
+            for (uint32_t level = 0; level < lod_count; level++)
             {
-                // randomly select a triangle from the mesh
-                uint32_t triangle_index = distribution(generator) * 3;
-
-                // get the vertices of the triangle
-                Vector3 v0 = Vector3(vertices[indices[triangle_index]].pos[0],     vertices[indices[triangle_index]].pos[1],     vertices[indices[triangle_index]].pos[2]);
-                Vector3 v1 = Vector3(vertices[indices[triangle_index + 1]].pos[0], vertices[indices[triangle_index + 1]].pos[1], vertices[indices[triangle_index + 1]].pos[2]);
-                Vector3 v2 = Vector3(vertices[indices[triangle_index + 2]].pos[0], vertices[indices[triangle_index + 2]].pos[1], vertices[indices[triangle_index + 2]].pos[2]);
-
-                // compute the slope of the triangle
-                Vector3 normal          = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
-                float slope_radians     = acos(Vector3::Dot(normal, Vector3::Up));
-                bool is_relatively_flat = slope_radians <= max_slope_radians;
-
-                // compute height threshold
-                float sea_level                = 0.0f;             // this is a fact across the engine
-                float height_threshold         = sea_level + 4.0f; // don't want things to grow too close to see level (where sand could be)
-                bool is_above_height_threshold = v0.y >= height_threshold && v1.y >= height_threshold && v2.y >= height_threshold;
+                const uint32_t nodes_per_side = get_nodes_per_side(lod_count, level);
+                node_heights[level].assign(nodes_per_side * nodes_per_side, Vector2(numeric_limits<float>::max(), numeric_limits<float>::lowest()));
+            }
 
-                if (is_relatively_flat && is_above_height_threshold)
+            const uint32_t leaves_per_side = get_nodes_per_side(lod_count, 0);
+            for_each_row(leaves_per_side, [&](uint32_t row_start, uint32_t row_end)
+            {
+                for (uint32_t node_z = row_start; node_z < row_end; node_z++)
                 {
-                    // generate barycentric coordinates
-                    float u = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                    float v = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                    if (u + v > 1.0f)
+                    for (uint32_t node_x = 0; node_x < leaves_per_side; node_x++)
                     {
-                        u = 1.0f - u;
-                        v = 1.0f - v;
-                    }
-
-                    // scale is a random value between 0.5 and 1.5
-                    Vector3 scale = Vector3(get_random_float(0.5f, 1.5f));
+                        const uint32_t x_start = node_x * patch_quads;
+                        const uint32_t z_start = node_z * patch_quads;
+                        if (x_start >= width - 1 || z_start >= height - 1)
+                            continue;
 
-                    // position is the barycentric coordinates multiplied by the vertices of the triangle, plus a terrain_offset to avoid floating object
-                    Vector3 position = v0 + (u * (v1 - v0) + terrain_offset) + v * (v2 - v0);
+                        const uint32_t x_end = min(x_start + patch_quads, width - 1);
+                        const uint32_t z_end = min(z_start + patch_quads, height - 1);
 
-                    // rotation is a random rotation around the Y axis, and then rotated to match the normal of the triangle
-                    Quaternion rotate_to_normal = rotate_to_match_surface_normal ? Quaternion::FromToRotation(Vector3::Up, normal) : Quaternion::Identity;
-                    Quaternion rotation         = rotate_to_normal * Quaternion::FromEulerAngles(0.0f, get_random_float(0.0f, 360.0f), 0.0f);
-
-                    transforms.emplace_back(position, rotation, scale);
+                        Vector2& heights = node_heights[0][node_z * leaves_per_side + node_x];
+                        for (uint32_t z = z_start; z <= z_end; z++)
+                        {
+                            for (uint32_t x = x_start; x <= x_end; x++)
+                            {
+                                heights.x = min(heights.x, height_map[z * width + x]);
+                                heights.y = max(heights.y, height_map[z * width + x]);
+                            }
+                        }
+                    }
                 }
-                else
+            });
+
+            for (uint32_t level = 1; level < lod_count; level++)
+            {
+                const uint32_t nodes_per_side    = get_nodes_per_side(lod_count, level);
+                const uint32_t children_per_side = nodes_per_side * 2;
+                for (uint32_t node_z = 0; node_z < nodes_per_side; node_z++)
                 {
-                    // if the slope is too steep or the object is underwater, try again
-                    --i;
+                    for (uint32_t node_x = 0; node_x < nodes_per_side; node_x++)
+                    {
+                        Vector2& heights = node_heights[level][node_z * nodes_per_side + node_x];
+                        for (uint32_t child = 0; child < 4; child++)
+                        {
+                            const uint32_t child_x        = node_x * 2 + (child & 1);
+                            const uint32_t child_z        = node_z * 2 + (child >> 1);
+                            const Vector2& child_heights = node_heights[level - 1][child_z * children_per_side + child_x];
+                            heights.x = min(heights.x, child_heights.x);
+                            heights.y = max(heights.y, child_heights.y);
+                        }
+                    }
                 }
             }
-
-            return transforms;
         }
 
-        void split_terrain_into_tiles(
-            const vector<RHI_Vertex_PosTexNorTan>& vertices, const vector<uint32_t>& indices,
-            vector<vector<RHI_Vertex_PosTexNorTan>>& tiled_vertices, vector<vector<uint32_t>>& tiled_indices)
+        bool intersects_sphere(const Vector3& box_min, const Vector3& box_max, const Vector3& center, const float radius)
         {
-            // initialize min and max values for terrain bounds
-            float min_x = numeric_limits<float>::max();
-            float max_x = numeric_limits<float>::lowest();
-            float min_z = numeric_limits<float>::max();
-            float max_z = numeric_limits<float>::lowest();
-
-            // iterate over all vertices to find the minimum and maximum x and z values
-            for (const RHI_Vertex_PosTexNorTan& vertex : vertices)
-            {
-                // compare and store the minimum and maximum x coordinates
-                if (vertex.pos[0] < min_x) min_x = vertex.pos[0];
-                if (vertex.pos[0] > max_x) max_x = vertex.pos[0];
+            const Vector3 closest = Vector3(clamp(center.x, box_min.x, box_max.x), clamp(center.y, box_min.y, box_max.y), clamp(center.z, box_min.z, box_max.z));
+            return (closest - center).LengthSquared() <= radius * radius;
+        }
 
-                // compare and store the minimum and maximum z coordinates
-                if (vertex.pos[2] < min_z) min_z = vertex.pos[2];
-                if (vertex.pos[2] > max_z) max_z = vertex.pos[2];
-            }
+        // a patch is the shared grid, scaled by the cell size of its level and moved to the corner of its node
+        void add_patch(const uint32_t level, const uint32_t node_x, const uint32_t node_z, const Vector2& half_size, vector<Matrix>& patches)
+        {
+            const float cell_size = static_cast<float>(1 << level);
+            const float node_size = patch_quads * cell_size;
+            const Vector3 origin  = Vector3(node_x * node_size - half_size.x, 0.0f, node_z * node_size - half_size.y);
+            patches.emplace_back(origin, Quaternion::Identity, Vector3(cell_size, 1.0f, cell_size));
+        }
 
-            // calculate dimensions
-            float terrain_width = max_x - min_x;
-            float terrain_depth = max_z - min_z;
-            float tile_width    = terrain_width / static_cast<float>(tile_count);
-            float tile_depth    = terrain_depth / static_cast<float>(tile_count);
+        // continuous distance based lod, a node is drawn at its level once the range of the level below no longer reaches it, the vertex
+        // shader morphs the vertices of a level into the grid of the next coarser one as they approach the end of the level's range
+        // returns false when the node is beyond its own range, so that the parent draws it instead
+        bool select_node(const vector<vector<Vector2>>& node_heights, const uint32_t lod_count, const uint32_t level, const uint32_t node_x, const uint32_t node_z,
+            const Vector2& half_size, const Vector3& camera_position, vector<Matrix>& patches)
+        {
+            const Vector2& heights = node_heights[level][node_z * get_nodes_per_side(lod_count, level) + node_x];
+            if (heights.x > heights.y)
+                return true; // outside of the height map, nothing to draw
 
-            // initialize tiled vertices and indices
-            tiled_vertices.resize(tile_count * tile_count);
-            tiled_indices.resize(tile_count * tile_count);
+            const float node_size = patch_quads * static_cast<float>(1 << level);
+            const Vector3 box_min = Vector3(node_x * node_size - half_size.x, heights.x, node_z * node_size - half_size.y);
+            const Vector3 box_max = Vector3(box_min.x + node_size, heights.y, box_min.z + node_size);
 
-            // create a mapping for each tile to track vertex global indices to their new local indices
-            vector<unordered_map<uint32_t, uint32_t>> global_to_local_indices(tile_count * tile_count);
+            if (!intersects_sphere(box_min, box_max, camera_position, lod_range * node_size))
+                return false;
 
-            // assign vertices to tiles and track their indices
-            for (uint32_t global_index = 0; global_index < vertices.size(); ++global_index)
+            if (level == 0 || !intersects_sphere(box_min, box_max, camera_position, lod_range * node_size * 0.5f))
             {
-                const RHI_Vertex_PosTexNorTan& vertex = vertices[global_index];
-
-                uint32_t tile_x = static_cast<uint32_t>((vertex.pos[0] - min_x) / tile_width);
-                uint32_t tile_z = static_cast<uint32_t>((vertex.pos[2] - min_z) / tile_depth);
-                tile_x          = min(tile_x, tile_count - 1);
-                tile_z          = min(tile_z, tile_count - 1);
-
-                // convert the 2D tile coordinates into a single index for the 1D output array
-                uint32_t tile_index = tile_z * tile_count + tile_x;
-
-                // add vertex to the appropriate tile
-                tiled_vertices[tile_index].push_back(vertex);
-
-                // track the local index of this vertex in the tile
-                uint32_t local_index = static_cast<uint32_t>(tiled_vertices[tile_index].size() - 1);
-                global_to_local_indices[tile_index][global_index] = local_index;
+                add_patch(level, node_x, node_z, half_size, patches);
+                return true;
             }
 
-            auto add_shared_vertex = [](
-                uint32_t tile_x, uint32_t tile_z, uint32_t global_index,
-                const vector<RHI_Vertex_PosTexNorTan>&vertices, vector<vector<RHI_Vertex_PosTexNorTan>>&tiled_vertices,
-                vector<unordered_map<uint32_t, uint32_t>>&global_to_local_indices, vector<vector<uint32_t>>&tiled_indices)
+            // children beyond their range are still drawn at their level, their vertices are fully morphed so they match this one
+            for (uint32_t child = 0; child < 4; child++)
             {
-                // check if tile_x and tile_z are within the valid range
-                if (tile_x >= tile_count || tile_z >= tile_count)
-                    return; // out of valid tile range, do nothing
-
-                uint32_t tile_count = static_cast<uint32_t>(sqrt(tiled_vertices.size())); // assuming square number of tiles
-                uint32_t tile_index = tile_z * tile_count + tile_x;
-                const RHI_Vertex_PosTexNorTan& vertex = vertices[global_index];
-
-                // add the vertex if it doesn't exist in the tile
-                if (global_to_local_indices[tile_index].find(global_index) == global_to_local_indices[tile_index].end())
+                const uint32_t child_x = node_x * 2 + (child & 1);
+                const uint32_t child_z = node_z * 2 + (child >> 1);
+                if (!select_node(node_heights, lod_count, level - 1, child_x, child_z, half_size, camera_position, patches))
                 {
-                    tiled_vertices[tile_index].push_back(vertex);
-                    uint32_t local_index = static_cast<uint32_t>(tiled_vertices[tile_index].size() - 1);
-                    global_to_local_indices[tile_index][global_index] = local_index;
+                    add_patch(level - 1, child_x, child_z, half_size, patches);
                 }
-            };
+            }
 
-            // adjust and assign indices to tiles
-            for (uint32_t global_index = 0; global_index < indices.size(); global_index += 3)
-            {
-                // find the tile for the first vertex of the triangle
-                const RHI_Vertex_PosTexNorTan& vertex = vertices[indices[global_index]];
-                uint32_t tile_x                       = static_cast<uint32_t>((vertex.pos[0] - min_x) / tile_width);
-                uint32_t tile_z                       = static_cast<uint32_t>((vertex.pos[2] - min_z) / tile_depth);
-                tile_x                                = min(tile_x, tile_count - 1);
-                tile_z                                = min(tile_z, tile_count - 1);
-                uint32_t tile_index                   = tile_z * tile_count + tile_x;
-
-                // add all vertices of the triangle to the current tile
-                for (uint32_t j = 0; j < 3; ++j)
-                {
-                    uint32_t current_global_index = indices[global_index + j];
-                    const RHI_Vertex_PosTexNorTan& current_vertex = vertices[current_global_index];
-                    uint32_t local_index;
+            return true;
+        }
 
-                    // check if the vertex index already exists in the local index map for the current tile
-                    auto it = global_to_local_indices[tile_index].find(current_global_index);
-                    if (it != global_to_local_indices[tile_index].end())
-                    {
-                        local_index = it->second;
-                    }
-                    else
-                    {
-                        // If the vertex is not already in the tile, add it and update the index map
-                        tiled_vertices[tile_index].push_back(current_vertex);
-                        local_index = static_cast<uint32_t>(tiled_vertices[tile_index].size() - 1);
-                        global_to_local_indices[tile_index][current_global_index] = local_index;
-                    }
-                    tiled_indices[tile_index].push_back(local_index);
-                }
+        // the grid that every node draws, the vertex shader reads the heights, normals and uvs from the height map
+        void generate_patch_geometry(vector<RHI_Vertex_PosTexNorTan>& vertices, vector<uint32_t>& indices)
+        {
+            const uint32_t vertices_per_side = patch_quads + 1;
 
-                // check for shared edges and corners
-                for (uint32_t j = 0; j < 3; ++j)
+            vertices.resize(vertices_per_side * vertices_per_side);
+            for (uint32_t z = 0; z < vertices_per_side; z++)
+            {
+                for (uint32_t x = 0; x < vertices_per_side; x++)
                 {
-                    // for each vertex of the triangle, check if it's on a shared edge
-                    uint32_t current_global_index = indices[global_index + j];
-                    const RHI_Vertex_PosTexNorTan& current_vertex = vertices[current_global_index];
-
-                    // calculate the local tile coordinates again
-                    tile_x = static_cast<uint32_t>((current_vertex.pos[0] - min_x) / tile_width);
-                    tile_z = static_cast<uint32_t>((current_vertex.pos[2] - min_z) / tile_depth);
-
-                    // determine if the vertex is on an edge or corner
-                    bool is_on_horizontal_edge = fmod(current_vertex.pos[0] - min_x, tile_width) <= numeric_limits<float>::epsilon() && tile_x > 0;
-                    bool is_on_vertical_edge   = fmod(current_vertex.pos[2] - min_z, tile_depth) <= numeric_limits<float>::epsilon() && tile_z > 0;
-
-                    // add the vertex to the shared edges/corners tiles if needed
-                    if (is_on_horizontal_edge)
-                    {
-                        // add to tile on the left
-                        add_shared_vertex(tile_x - 1, tile_z, current_global_index, vertices, tiled_vertices, global_to_local_indices, tiled_indices);
-                    }
-
-                    if (is_on_vertical_edge)
-                    {
-                        // add to tile below
-                        add_shared_vertex(tile_x, tile_z - 1, current_global_index, vertices, tiled_vertices, global_to_local_indices, tiled_indices);
-                    }
-
-                    if (is_on_horizontal_edge && is_on_vertical_edge)
-                    {
-                        // add to the diagonal tile (bottom left)
-                        add_shared_vertex(tile_x - 1, tile_z - 1, current_global_index, vertices, tiled_vertices, global_to_local_indices, tiled_indices);
-                    }
+                    vertices[z * vertices_per_side + x] = RHI_Vertex_PosTexNorTan(
+                        Vector3(static_cast<float>(x), 0.0f, static_cast<float>(z)),
+                        Vector2(static_cast<float>(x) / patch_quads, static_cast<float>(z) / patch_quads),
+                        Vector3::Up,
+                        Vector3::Right
+                    );
                 }
             }
+
+            indices.resize(patch_quads * patch_quads * 6);
+            generate_indices(indices, vertices_per_side, vertices_per_side);
         }
     }
 
@@ -512,6 +632,7 @@ namespace spartan
     {
         m_material = make_shared<Material>();
         m_material->SetObjectName("terrain");
+        m_material->SetProperty(MaterialProperty::IsTerrain, 1.0f);
     }
 
     Terrain::~Terrain()
@@ -519,6 +640,66 @@ namespace spartan
         m_height_texture = nullptr;
     }
 
+    void Terrain::OnTick()
+    {
+        // take over what generation produced, between frames, so that the renderer never sees it change mid-frame
+        shared_ptr<Entity> entity_patches;
+        {
+            lock_guard<mutex> lock(m_mutex_pending);
+
+            entity_patches = m_entity_patches.lock();
+            if (m_pending)
+            {
+                m_lod_count = m_pending_lod_count;
+                m_node_heights.swap(m_pending_node_heights);
+                m_pending_node_heights.clear();
+                if (m_pending_height_texture_gpu)
+                {
+                    m_height_texture_gpu = move(m_pending_height_texture_gpu);
+                }
+                m_patches.clear(); // forces the instances to be set below
+                m_pending = false;
+
+                if (entity_patches)
+                {
+                    // a cleared terrain has no heights, its patches stop rendering until something is generated again
+                    entity_patches->SetActive(!m_node_heights.empty());
+
+                    if (!m_node_heights.empty())
+                    {
+                        // the grid is flat, the bounds have to account for the heights the vertex shader will displace it to
+                        const Vector2& heights = m_node_heights[m_lod_count - 1][0];
+                        const BoundingBox aabb = BoundingBox(Vector3(0.0f, heights.x, 0.0f), Vector3(static_cast<float>(patch_quads), heights.y, static_cast<float>(patch_quads)));
+                        shared_ptr<Renderable> renderable = entity_patches->GetComponent<Renderable>();
+                        renderable->SetGeometry(m_patch_mesh.get(), aabb);
+                        renderable->SetMaterial(m_material);
+                    }
+                }
+            }
+        }
+
+        shared_ptr<Camera> camera = Renderer::GetCamera();
+        if (m_node_heights.empty() || !m_height_texture_gpu || !entity_patches || !camera)
+            return;
+
+        // select in the terrain's space, so that the node bounds don't need to be transformed
+        const Vector3 camera_position = m_entity_ptr->GetMatrix().Inverted() * camera->GetEntity()->GetPosition();
+        const Vector2 half_size       = Vector2(m_height_texture_gpu->GetWidth() * 0.5f, m_height_texture_gpu->GetHeight() * 0.5f);
+
+        m_patches_selected.clear();
+        if (!select_node(m_node_heights, m_lod_count, m_lod_count - 1, 0, 0, half_size, camera_position, m_patches_selected))
+        {
+            add_patch(m_lod_count - 1, 0, 0, half_size, m_patches_selected); // the camera is far away, draw the root
+        }
+
+        // the instance buffer is only rebuilt when the selection changes, which is rare compared to the frame rate
+        if (m_patches_selected != m_patches)
+        {
+            swap(m_patches, m_patches_selected);
+            entity_patches->GetComponent<Renderable>()->SetInstances(m_patches);
+        }
+    }
+
     void Terrain::Serialize(FileStream* stream)
     {
         SP_LOG_WARNING("Not implemented");
@@ -529,7 +710,7 @@ namespace spartan
         SP_LOG_WARNING("Not implemented");
     }
 
-    void Terrain::GenerateTransforms(vector<Matrix>* transforms, const uint32_t count, const TerrainProp terrain_prop)
+    void Terrain::GenerateTransforms(vector<Matrix>* transforms, const uint32_t count, const TerrainProp terrain_prop, const uint64_t seed)
 	{
         bool rotate_match_surface_normal = false;
         float max_slope                  = 0.0f;
@@ -556,7 +737,12 @@ namespace spartan
             terrain_offset              = -0.9f;
         }
 
-        *transforms = generate_transforms(m_vertices, m_indices, count, max_slope, rotate_match_surface_normal, terrain_offset);
+        // each prop type gets its own sequence, so that they don't land on the same spots
+        const uint64_t prop_seed = seed * 31 + static_cast<uint64_t>(terrain_prop);
+
+        const uint32_t width  = m_height_texture->GetWidth();
+        const uint32_t height = m_height_texture->GetHeight();
+        *transforms = generate_transforms(m_height_data, width, height, count, prop_seed, max_slope, rotate_match_surface_normal, terrain_offset);
 	}
 
     void Terrain::Generate()
@@ -578,12 +764,17 @@ namespace spartan
         m_is_generating = true;
 
         // star progress tracking
-        uint32_t job_count = 6;
+        uint32_t job_count = 3;
         ProgressTracker::GetProgress(ProgressType::Terrain).Start(job_count, "Generating terrain...");
 
-        uint32_t width  = 0;
-        uint32_t height = 0;
-        vector<Vector3> positions;
+        uint32_t width     = 0;
+        uint32_t height    = 0;
+        uint32_t lod_count = 0;
+        vector<vector<Vector2>> node_heights;
+
+        // the profiler is not thread safe and this runs on a worker thread, so the stages time themselves
+        Stopwatch stopwatch;
+        array<float, 3> stage_durations = {};
 
         // 1. process height map
         {
@@ -595,125 +786,110 @@ namespace spartan
                 return;
             }
 
-            // deduce some stuff
+            // deduce some stuff, the counts are those of the full resolution surface, which is never built as a mesh
             width            = m_height_texture->GetWidth();
             height           = m_height_texture->GetHeight();
             m_height_samples = width * height;
             m_vertex_count   = m_height_samples;
-            m_index_count    = m_vertex_count * 6;
+            m_index_count    = (width - 1) * (height - 1) * 6;
             m_triangle_count = m_index_count / 3;
 
-            // allocate memory for the calculations that follow
-            positions  = vector<Vector3>(m_height_samples);
-            m_vertices = vector<RHI_Vertex_PosTexNorTan>(m_vertex_count);
-            m_indices  = vector<uint32_t>(m_index_count);
-
+            stage_durations[0] = stopwatch.GetElapsedTimeMs();
             ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
         }
 
-        // 2. compute positions
+        // 2. build the quadtree, its leaves are the tiles, each computed straight from its rectangle of the height map
         {
-            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Generating positions...");
-            generate_positions(positions, m_height_data, width, height);
-            ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
-        }
+            stopwatch.Start();
+            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Building quadtree...");
 
-        // 3. compute vertices and indices
-        {
-            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Generating vertices and indices...");
-            generate_vertices_and_indices(m_vertices, m_indices, positions, width, height);
-            ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
-        }
-
-        // 4. compute normals and tangents
-        {
-            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Generating normals...");
-            generate_normals(m_indices, m_vertices);
-            ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
-        }
+            // enough levels for the root to cover the height map
+            lod_count = 1;
+            while ((patch_quads << (lod_count - 1)) < max(width, height) - 1)
+            {
+                lod_count++;
+            }
 
-        // 5. split into tiles
-        {
-            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Splitting into tiles...");
-            split_terrain_into_tiles(m_vertices, m_indices, m_tile_vertices, m_tile_indices);
+            compute_node_heights(m_height_data, width, height, lod_count, node_heights);
+            stage_durations[1] = stopwatch.GetElapsedTimeMs();
             ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
         }
 
-        // 6. create a mesh for each tile
+        // 3. upload the height map and create the patches
         {
-            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Creating tile meshes");
-
-            for (uint32_t tile_index = 0; tile_index < static_cast<uint32_t>(m_tile_vertices.size()); tile_index++)
-            {
-                UpdateMesh(tile_index);
-            }
-
+            stopwatch.Start();
+            ProgressTracker::GetProgress(ProgressType::Terrain).SetText("Creating patches...");
+            CreatePatches(lod_count, node_heights);
+            stage_durations[2] = stopwatch.GetElapsedTimeMs();
             ProgressTracker::GetProgress(ProgressType::Terrain).JobDone();
         }
 
-        // todo: we don't free vertices and indices, we should
+        SP_LOG_INFO("Terrain %ux%u generated, height map: %.1f ms, quadtree: %.1f ms, patches: %.1f ms",
+            width, height, stage_durations[0], stage_durations[1], stage_durations[2]);
 
         m_is_generating = false;
     }
     
-    void Terrain::UpdateMesh(const uint32_t tile_index)
+    void Terrain::CreatePatches(const uint32_t lod_count, vector<vector<Vector2>>& node_heights)
     {
-        string name = "tile_" + to_string(tile_index);
+        const uint32_t width  = m_height_texture->GetWidth();
+        const uint32_t height = m_height_texture->GetHeight();
 
-        // create mesh if it doesn't exist
-        if (m_tile_meshes.size() <= tile_index)
+        // the vertex shader reads the processed heights, so that it matches physics and prop placement exactly
+        shared_ptr<RHI_Texture> height_texture_gpu;
         {
-            shared_ptr<Mesh>& mesh = m_tile_meshes.emplace_back(make_shared<Mesh>());
-            mesh->SetObjectName(name);
+            vector<RHI_Texture_Slice> data(1);
+            data[0].mips.resize(1);
+            data[0].mips[0].bytes.resize(m_height_data.size() * sizeof(float));
+            memcpy(data[0].mips[0].bytes.data(), m_height_data.data(), data[0].mips[0].bytes.size());
+
+            height_texture_gpu = make_shared<RHI_Texture>(RHI_Texture_Type::Type2D, width, height, 1, 1, RHI_Format::R32_Float, RHI_Texture_Srv, "terrain_height", data);
         }
 
-        // update with geometry
-        shared_ptr<Mesh>& mesh = m_tile_meshes[tile_index];
-        mesh->Clear();
-        mesh->AddGeometry(m_tile_vertices[tile_index], m_tile_indices[tile_index]);
-        mesh->PostProcess();
+        // one grid shared by all nodes
+        if (!m_patch_mesh)
+        {
+            vector<RHI_Vertex_PosTexNorTan> vertices;
+            vector<uint32_t> indices;
+            generate_patch_geometry(vertices, indices);
+
+            m_patch_mesh = make_shared<Mesh>();
+            m_patch_mesh->SetObjectName("terrain_patch");
+            m_patch_mesh->AddGeometry(vertices, indices);
+            m_patch_mesh->PostProcess();
+        }
 
-        // create a child entity, add a renderable, and this mesh tile to it
+        // a child entity draws every selected node as an instance of the grid
+        shared_ptr<Entity> entity;
         {
-            shared_ptr<Entity> entity = World::CreateEntity();
-            entity->SetObjectName(name);
+            lock_guard<mutex> lock(m_mutex_pending);
+            entity = m_entity_patches.lock();
+        }
+        if (!entity)
+        {
+            entity = World::CreateEntity();
+            entity->SetObjectName("patches");
             entity->SetParent(World::GetEntityById(m_entity_ptr->GetObjectId()));
-
-            if (shared_ptr<Renderable> renderable = entity->AddComponent<Renderable>())
-            {
-                renderable->SetGeometry(
-                    mesh.get(),
-                    mesh->GetAabb(),
-                    0,                     // index offset
-                    mesh->GetIndexCount(), // index count
-                    0,                     // vertex offset
-                    mesh->GetVertexCount() // vertex count
-                );
-
-                renderable->SetMaterial(m_material);
-            }
+            entity->AddComponent<Renderable>();
         }
+
+        // the geometry, the bounds and the instances are set by the next tick, which publishes everything at once
+        lock_guard<mutex> lock(m_mutex_pending);
+        m_entity_patches             = entity;
+        m_pending_lod_count          = lod_count;
+        m_pending_node_heights       = move(node_heights);
+        m_pending_height_texture_gpu = move(height_texture_gpu);
+        m_pending                    = true;
     }
 
     void Terrain::Clear()
     {
-        m_vertices.clear();
-        m_indices.clear();
-        m_tile_meshes.clear();
-        m_tile_vertices.clear();
-        m_tile_indices.clear();
-
-        for (auto& mesh : m_tile_meshes)
-        {
-            ResourceCache::Remove(mesh);
-        }
-
-        for (Entity* child : m_entity_ptr->GetChildren())
-        {
-            if (shared_ptr<Renderable> renderable = child->AddComponent<Renderable>())
-            {
-                renderable->SetGeometry(nullptr);
-            }
-        }
+        // the patch entity, its mesh and the height texture are kept, they are replaced once
+        // generation completes so that the renderer never sees them disappear mid-frame
+        lock_guard<mutex> lock(m_mutex_pending);
+        m_pending_lod_count = 0;
+        m_pending_node_heights.clear();
+        m_pending_height_texture_gpu = nullptr;
+        m_pending                    = true;
     }
 }
@@ -24,6 +24,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //= INCLUDES =========================
 #include "Component.h"
 #include <atomic>
+#include <mutex>
 #include "../../RHI/RHI_Definitions.h"
 //====================================
 
@@ -52,10 +53,12 @@ namespace spartan
         //= Component ================================
         void Serialize(FileStream* stream) override;
         void Deserialize(FileStream* stream) override;
+        void OnTick() override;
         //============================================
 
         RHI_Texture* GetHeightMap() const          { return m_height_texture; }
         void SetHeightMap(RHI_Texture* height_map) { m_height_texture = height_map;}
+        RHI_Texture* GetHeightMapGpu() const       { return m_height_texture_gpu.get(); }
 
         float GetMinY() const     { return m_min_y; }
         void SetMinY(float min_z) { m_min_y = min_z; }
@@ -64,7 +67,8 @@ namespace spartan
         void SetMaxY(float max_z) { m_max_y = max_z; }
 
         void Generate();
-        void GenerateTransforms(std::vector<math::Matrix>* transforms, const uint32_t count, const TerrainProp terrain_prop);
+        // deterministic for a given seed
+        void GenerateTransforms(std::vector<math::Matrix>* transforms, const uint32_t count, const TerrainProp terrain_prop, const uint64_t seed = 0);
 
         uint32_t GetVertexCount() const         { return m_vertex_count; }
         uint32_t GetIndexCount() const          { return m_index_count; }
@@ -73,7 +77,7 @@ namespace spartan
         std::shared_ptr<Material> GetMaterial() { return m_material; }
  
     private:
-        void UpdateMesh(const uint32_t tile_index);
+        void CreatePatches(const uint32_t lod_count, std::vector<std::vector<math::Vector2>>& node_heights);
         void Clear();
 
         float m_min_y                     = -5.0f; // everything below 0.0 is assumed to be below sea level
@@ -86,11 +90,22 @@ namespace spartan
         uint32_t m_triangle_count         = 0;
         RHI_Texture* m_height_texture     = nullptr;
         std::vector<float> m_height_data;
-        std::vector<std::vector<RHI_Vertex_PosTexNorTan>> m_tile_vertices;
-        std::vector<RHI_Vertex_PosTexNorTan> m_vertices;
-        std::vector<uint32_t> m_indices;
-        std::vector<std::vector<uint32_t>> m_tile_indices;
-        std::vector<std::shared_ptr<Mesh>> m_tile_meshes;
         std::shared_ptr<Material> m_material;
+
+        // quadtree lod, only touched by the thread that ticks the world
+        uint32_t m_lod_count = 0;
+        std::vector<std::vector<math::Vector2>> m_node_heights; // min/max height per node, per level
+        std::vector<math::Matrix> m_patches;                    // the selected nodes, as instances of the patch mesh
+        std::vector<math::Matrix> m_patches_selected;           // scratch, avoids an allocation per tick
+        std::shared_ptr<Mesh> m_patch_mesh;
+        std::shared_ptr<RHI_Texture> m_height_texture_gpu;
+        std::weak_ptr<Entity> m_entity_patches;
+
+        // generation runs on a worker and builds into these, the next tick publishes them under the mutex
+        uint32_t m_pending_lod_count = 0;
+        std::vector<std::vector<math::Vector2>> m_pending_node_heights;
+        std::shared_ptr<RHI_Texture> m_pending_height_texture_gpu; // null keeps the current one
+        bool m_pending                                           = false;
+        std::mutex m_mutex_pending;
     };
 }
@@ -330,6 +330,20 @@ namespace spartan
         return entities;
     }
 
+    vector<shared_ptr<Entity>> World::GetEntities()
+    {
+        lock_guard<mutex> lock(entity_access_mutex);
+
+        vector<shared_ptr<Entity>> snapshot;
+        snapshot.reserve(entities.size());
+        for (const auto& [id, entity] : entities)
+        {
+            snapshot.emplace_back(entity);
+        }
+
+        return snapshot;
+    }
+
     const string World::GetName()
     {
         return name;
@@ -46,6 +46,7 @@ namespace spartan
         static std::vector<std::shared_ptr<Entity>> GetRootEntities();
         static const std::shared_ptr<Entity>& GetEntityById(uint64_t id);
         static const std::unordered_map<uint64_t, std::shared_ptr<Entity>>& GetAllEntities();
+        static std::vector<std::shared_ptr<Entity>> GetEntities(); // a snapshot taken under the entity lock, safe while entities are created on other threads
 
         // misc
         static void Clear();